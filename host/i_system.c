@@ -0,0 +1,611 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//	System interface for the headless host build. Time comes
+//	from the monotonic clock, there is no console to show errors
+//	on, and the IWAD is given on the command line.
+//
+//-----------------------------------------------------------------------------
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <pthread.h>
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "m_prof.h"
+#include "i_video.h"
+#include "i_sound.h"
+
+#include "d_main.h"
+#include "d_net.h"
+#include "g_game.h"
+#include "i_system.h"
+
+
+int	mb_used = 32;
+
+
+void
+I_Tactile
+( int	on,
+  int	off,
+  int	total )
+{
+  // UNUSED.
+  on = off = total = 0;
+}
+
+ticcmd_t	emptycmd;
+ticcmd_t*	I_BaseTiccmd(void)
+{
+    return &emptycmd;
+}
+
+
+int  I_GetHeapSize (void)
+{
+    return mb_used*1024*1024;
+}
+
+byte* I_ZoneBase (int*	size)
+{
+    *size = mb_used*1024*1024;
+    return (byte *) malloc (*size);
+}
+
+
+
+int64_t I_GetTimeUS (void)
+{
+    struct timespec	now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+
+//
+// I_GetTime
+// returns time in 1/35th second tics,
+// counted from the first call
+//
+static int64_t	basetime;
+
+int  I_GetTime (void)
+{
+    if (!basetime)
+	basetime = I_GetTimeUS ();
+
+    return (int)((I_GetTimeUS () - basetime) * TICRATE / 1000000);
+}
+
+
+//
+// I_WaitForTic
+// Sleeps until I_GetTime reaches tic.
+//
+void I_WaitForTic (int tic)
+{
+    int64_t	target;
+    int64_t	now;
+
+    if (!basetime)
+	basetime = I_GetTimeUS ();
+
+    target = basetime + ((int64_t)tic * 1000000 + TICRATE-1) / TICRATE;
+    now = I_GetTimeUS ();
+
+    if (target > now)
+	usleep (target - now);
+}
+
+
+
+//
+// I_Init
+//
+void I_Init (void)
+{
+    I_InitSound();
+    I_InitMusic();
+}
+
+//
+// I_Quit
+//
+void I_Quit (void)
+{
+    G_CheckSave (true);
+    M_FinishWrites ();
+    M_ProfShutdown ();
+    D_QuitNetGame ();
+    I_ShutdownSound();
+    I_ShutdownMusic();
+    M_SaveDefaults ();
+    I_ShutdownGraphics();
+    exit(0);
+}
+
+void I_WaitVBL(int count)
+{
+    usleep (count * (1000000/70) );
+}
+
+void I_BeginRead(void)
+{
+}
+
+void I_EndRead(void)
+{
+}
+
+byte*	I_AllocLow(int length)
+{
+    byte*	mem;
+
+    mem = (byte *)malloc (length);
+    memset (mem,0,length);
+    return mem;
+}
+
+
+//
+// I_ListFiles
+//
+static int I_ComparePaths (const void* a, const void* b)
+{
+    return strcmp (*(char* const*)a, *(char* const*)b);
+}
+
+int I_ListFiles (char* dir, char* ext, char*** paths)
+{
+    DIR*		d;
+    struct dirent*	ent;
+    char**		list;
+    int			count;
+    int			max;
+    int			len;
+
+    d = opendir (dir);
+    if (!d)
+	return -1;
+
+    list = NULL;
+    count = max = 0;
+
+    while ((ent = readdir (d)) != NULL)
+    {
+	len = strlen (ent->d_name);
+	if (len < strlen (ext) || strcasecmp (ent->d_name + len - strlen (ext), ext))
+	    continue;
+
+	if (count == max)
+	{
+	    max = max ? max*2 : 64;
+	    list = realloc (list, max * sizeof(*list));
+	    if (!list)
+		I_Error ("I_ListFiles: out of memory");
+	}
+
+	list[count] = malloc (strlen (dir) + len + 2);
+	if (!list[count])
+	    I_Error ("I_ListFiles: out of memory");
+	sprintf (list[count++], "%s/%s", dir, ent->d_name);
+    }
+
+    closedir (d);
+
+    qsort (list, count, sizeof(*list), I_ComparePaths);
+    *paths = list;
+    return count;
+}
+
+
+//
+// I_ForkJobs
+//
+int I_ForkJobs (int* jobs)
+{
+    pid_t	pid;
+    int		status;
+    int		failed;
+    int		i;
+
+    if (*jobs <= 1)
+    {
+	*jobs = 1;
+	return 0;
+    }
+
+    fflush (stdout);
+    fflush (stderr);
+
+    for (i=0 ; i<*jobs ; i++)
+    {
+	pid = fork ();
+	if (pid == -1)
+	    I_Error ("I_ForkJobs: fork failed");
+	if (pid == 0)
+	    return i;
+    }
+
+    failed = 0;
+    while (wait (&status) > 0)
+	if (!WIFEXITED (status) || WEXITSTATUS (status))
+	    failed++;
+
+    if (failed)
+	printf ("I_ForkJobs: %i of %i jobs failed.\n", failed, *jobs);
+
+    exit (failed ? 1 : 0);
+}
+
+
+//
+// I_StartWrite
+// Each write gets its own thread, joined by I_WaitWrite.
+//
+static pthread_t	writethread;
+static boolean		writing;
+
+static int		writehandle;
+static void*		writebuf;
+static int		writelength;
+static writedone_t	writedone;
+static boolean		writeok = true;
+static volatile boolean	writefinished;
+
+//
+// I_WriteAll
+// write() may take less than it was given, or be interrupted
+// before taking anything, so go on until all of it is written.
+//
+static boolean I_WriteAll (int handle, byte* buf, int length)
+{
+    int		count;
+
+    while (length > 0)
+    {
+	count = write (handle, buf, length);
+	if (count < 0 && errno == EINTR)
+	    continue;
+	if (count <= 0)
+	    return false;
+
+	buf += count;
+	length -= count;
+    }
+
+    return true;
+}
+
+static void* I_WriteThread (void* arg)
+{
+    boolean	ok;
+
+    ok = I_WriteAll (writehandle, writebuf, writelength);
+    if (writedone)
+	ok = writedone (ok);
+    writeok = ok;
+    __sync_synchronize ();
+    writefinished = true;
+    return NULL;
+}
+
+void I_StartWrite (int handle, void* buf, int length, writedone_t done)
+{
+    if (writing)
+	I_Error ("I_StartWrite: a write is already running");
+
+    writehandle = handle;
+    writebuf = buf;
+    writelength = length;
+    writedone = done;
+    writefinished = false;
+
+    if (pthread_create (&writethread, NULL, I_WriteThread, NULL))
+    {
+	// no thread, write it here
+	I_WriteThread (NULL);
+	return;
+    }
+
+    writing = true;
+}
+
+boolean I_WaitWrite (void)
+{
+    if (writing)
+    {
+	pthread_join (writethread, NULL);
+	writing = false;
+    }
+
+    return writeok;
+}
+
+boolean I_WriteDone (void)
+{
+    return !writing || writefinished;
+}
+
+
+//
+// I_StartWork
+// Each job gets its own thread, joined by I_WaitWork.
+//
+static pthread_t	workthread;
+static boolean		working;
+
+static void		(*workfunc) (void* arg);
+static void*		workarg;
+static volatile boolean	workfinished;
+
+static void* I_WorkThread (void* arg)
+{
+    workfunc (workarg);
+    __sync_synchronize ();
+    workfinished = true;
+    return NULL;
+}
+
+void I_StartWork (void (*func) (void* arg), void* arg)
+{
+    if (working)
+	I_Error ("I_StartWork: a job is already running");
+
+    workfunc = func;
+    workarg = arg;
+    workfinished = false;
+
+    if (pthread_create (&workthread, NULL, I_WorkThread, NULL))
+    {
+	// no thread, do it here
+	I_WorkThread (NULL);
+	return;
+    }
+
+    working = true;
+}
+
+void I_WaitWork (void)
+{
+    if (working)
+    {
+	pthread_join (workthread, NULL);
+	working = false;
+    }
+}
+
+boolean I_WorkDone (void)
+{
+    return !working || workfinished;
+}
+
+
+//
+// I_RunParallel
+// A thread for each processor, up to MAXPARALLEL. The workers
+// are started once and wait between calls, so even a call with
+// little to do is worth spreading. The indexes are handed out
+// one at a time to whichever thread asks first.
+//
+#define MAXPARALLEL	8
+
+static void		(*parallelfunc) (int index, int thread);
+static int		parallelcount;
+static volatile int	parallelnext;	// next index to hand out
+static unsigned		parallelcall;	// bumped for each call
+static int		parallelbusy;	// workers inside a call
+static boolean		parallelstarted;
+
+static pthread_mutex_t	parallellock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	parallelstart = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	paralleldone = PTHREAD_COND_INITIALIZER;
+
+static void I_ParallelWork (int thread)
+{
+    int		i;
+
+    while ((i = __sync_fetch_and_add (&parallelnext, 1)) < parallelcount)
+	parallelfunc (i, thread);
+}
+
+static void* I_ParallelThread (void* arg)
+{
+    unsigned	call;
+
+    // started in the first call, before it is counted
+    call = 0;
+    pthread_mutex_lock (&parallellock);
+
+    for (;;)
+    {
+	while (parallelcall == call)
+	    pthread_cond_wait (&parallelstart, &parallellock);
+	call = parallelcall;
+
+	// counted in, so the call can't be changed under it
+	parallelbusy++;
+	pthread_mutex_unlock (&parallellock);
+
+	I_ParallelWork ((intptr_t)arg);
+
+	pthread_mutex_lock (&parallellock);
+	if (!--parallelbusy)
+	    pthread_cond_signal (&paralleldone);
+    }
+
+    return NULL;
+}
+
+int I_ParallelThreads (void)
+{
+    static int	threads;
+    long	count;
+
+    // sysconf reads the system's files, too slow for every tic
+    if (threads)
+	return threads;
+
+    count = sysconf (_SC_NPROCESSORS_ONLN);
+    if (count < 1)
+	threads = 1;
+    else if (count > MAXPARALLEL)
+	threads = MAXPARALLEL;
+    else
+	threads = count;
+
+    return threads;
+}
+
+void I_RunParallel (void (*func) (int index, int thread), int count)
+{
+    pthread_t	thread;
+    int		i;
+
+    pthread_mutex_lock (&parallellock);
+
+    // a worker that doesn't start leaves more for the others
+    if (!parallelstarted)
+    {
+	parallelstarted = true;
+	for (i=1 ; i<I_ParallelThreads () ; i++)
+	    if (!pthread_create (&thread, NULL, I_ParallelThread,
+				 (void *)(intptr_t)i))
+		pthread_detach (thread);
+    }
+
+    // one that woke too late for the last call may still be in it
+    while (parallelbusy)
+	pthread_cond_wait (&paralleldone, &parallellock);
+
+    parallelfunc = func;
+    parallelcount = count;
+    parallelnext = 0;
+    parallelcall++;
+    pthread_cond_broadcast (&parallelstart);
+    pthread_mutex_unlock (&parallellock);
+
+    I_ParallelWork (0);
+
+    // every index is taken, wait for those being done
+    pthread_mutex_lock (&parallellock);
+    while (parallelbusy)
+	pthread_cond_wait (&paralleldone, &parallellock);
+    pthread_mutex_unlock (&parallellock);
+}
+
+
+//
+// PS3_LaunchScreen
+// The host build has no launcher. The IWAD is named with
+// -iwad <file>, and the game mode follows from its name.
+//
+typedef struct
+{
+   char *name;
+   GameMode_t mode;
+   GameMission_t mission;
+} iwad_t;
+
+#define NUM_SUPPORTED_IWADS 5
+static const iwad_t supported_iwads[NUM_SUPPORTED_IWADS] =
+{
+    { "doom2.wad",    commercial, doom2     },
+    { "plutonia.wad", commercial, pack_plut },
+    { "tnt.wad",      commercial, pack_tnt  },
+    { "doom.wad",     retail,     doom      },
+    { "doom1.wad",    shareware,  doom      }
+};
+
+void PS3_LaunchScreen (void)
+{
+    int		p;
+    int		i;
+    char*	name;
+
+    p = M_CheckParm ("-iwad");
+    if (!p || p >= myargc-1)
+	I_Error ("No IWAD given, use -iwad <file>.");
+
+    name = strrchr (myargv[p+1], '/');
+    name = name ? name+1 : myargv[p+1];
+
+    for (i=0 ; i<NUM_SUPPORTED_IWADS ; i++)
+	if (!strcasecmp (name, supported_iwads[i].name))
+	    break;
+
+    if (i == NUM_SUPPORTED_IWADS)
+	I_Error ("Unknown IWAD %s.", name);
+
+    D_AddFile (myargv[p+1]);
+    gamemode = supported_iwads[i].mode;
+    gamemission = supported_iwads[i].mission;
+}
+
+
+//
+// I_Error
+//
+extern boolean demorecording;
+
+void I_Error (char *error, ...)
+{
+    va_list	argptr;
+
+    // Message first.
+    va_start (argptr,error);
+    fprintf (stderr, "Error: ");
+    vfprintf (stderr,error,argptr);
+    fprintf (stderr, "\n");
+    va_end (argptr);
+
+    fflush( stderr );
+
+    // Shutdown. Here might be other errors.
+    if (demorecording)
+	G_CheckDemoStatus();
+
+    M_FinishWrites ();
+    M_ProfShutdown ();
+    D_QuitNetGame ();
+    I_ShutdownSound ();
+    I_ShutdownMusic ();
+    I_ShutdownGraphics();
+
+    exit(-1);
+}
@@ -0,0 +1,333 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//	DOOM graphics and input for the headless host build.
+//
+//	Frames are converted to 32 bit xRGB in memory, the same work
+//	the PS3 scalers do per pixel, but nothing is displayed.
+//
+//	Input comes from a script given with -input <file>, one event
+//	per line:
+//
+//	    <gametic> down|up <key>
+//	    <gametic> pad <control> <value>
+//
+//	where <key> is a single character, a decimal key code, or one
+//	of the names in keynames[] below, and <control> one of the
+//	pad controls in padnames[] (sticks are 0-255, 128 is centred;
+//	buttons are 0 or 1). Lines starting with # are ignored. Events
+//	take effect once gametic reaches their tic.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <io/pad.h>
+
+#include "i_system.h"
+#include "d_main.h"
+#include "doomtype.h"
+#include "doomdef.h"
+#include "doomstat.h"
+#include "d_event.h"
+#include "v_video.h"
+#include "gammatab.h"
+#include "m_argv.h"
+
+// INPUT
+// g_game.c reads the analog sticks from here. They stay centred
+// unless the input script moves them.
+PadInfo padinfo;
+PadData paddata, lastpaddata;
+
+static FILE*	inputfile;
+
+typedef struct
+{
+    int		tic;
+    event_t	event;
+
+    // Pad events set a control instead of posting the event.
+    int		padcontrol;	// -1 for key events
+    int		padvalue;
+} scriptevent_t;
+
+static scriptevent_t	nextevent;
+static boolean		havenextevent;
+
+typedef struct
+{
+    char*	name;
+    int		key;
+} keyname_t;
+
+static const keyname_t keynames[] =
+{
+    { "right",		KEY_RIGHTARROW },
+    { "left",		KEY_LEFTARROW },
+    { "up",		KEY_UPARROW },
+    { "down",		KEY_DOWNARROW },
+    { "escape",		KEY_ESCAPE },
+    { "enter",		KEY_ENTER },
+    { "tab",		KEY_TAB },
+    { "backspace",	KEY_BACKSPACE },
+    { "pause",		KEY_PAUSE },
+    { "shift",		KEY_RSHIFT },
+    { "ctrl",		KEY_RCTRL },
+    { "alt",		KEY_RALT },
+    { "space",		' ' },
+    { "f1",		KEY_F1 },
+    { "f2",		KEY_F2 },
+    { "f3",		KEY_F3 },
+    { "f4",		KEY_F4 },
+    { "f5",		KEY_F5 },
+    { "f6",		KEY_F6 },
+    { "f7",		KEY_F7 },
+    { "f8",		KEY_F8 },
+    { "f9",		KEY_F9 },
+    { "f10",		KEY_F10 },
+    { "f11",		KEY_F11 },
+    { "f12",		KEY_F12 },
+    { NULL,		0 }
+};
+
+enum
+{
+    pad_lh,
+    pad_lv,
+    pad_rh,
+    pad_rv,
+    pad_triangle,
+    pad_square,
+    NUMPADCONTROLS
+};
+
+static char* padnames[NUMPADCONTROLS] =
+{
+    "lh", "lv", "rh", "rv", "triangle", "square"
+};
+
+// GRAPHICS
+int usegamma;
+int graphics_initialized = 0;
+
+static uint32_t		current_palette[256];
+
+// The finished frame, as it would be handed to the display.
+uint32_t*		host_framebuffer;
+
+
+//
+// I_ParseKey
+//
+static int I_ParseKey (char* name)
+{
+    int		i;
+
+    if (strlen (name) == 1)
+	return name[0];
+
+    for (i=0 ; keynames[i].name ; i++)
+	if (!strcasecmp (name, keynames[i].name))
+	    return keynames[i].key;
+
+    return atoi (name);
+}
+
+
+//
+// I_ReadInputEvent
+// Reads the next event from the input script, if any.
+//
+static void I_ReadInputEvent (void)
+{
+    char	line[256];
+    char	action[16];
+    char	key[32];
+    int		tic;
+    int		i;
+
+    havenextevent = false;
+
+    while (fgets (line, sizeof(line), inputfile))
+    {
+	if (line[0] == '#')
+	    continue;
+
+	if (sscanf (line, "%d %15s %31s", &tic, action, key) != 3)
+	    continue;
+
+	memset (&nextevent, 0, sizeof(nextevent));
+	nextevent.tic = tic;
+	nextevent.padcontrol = -1;
+
+	if (!strcasecmp (action, "pad"))
+	{
+	    for (i=0 ; i<NUMPADCONTROLS ; i++)
+		if (!strcasecmp (key, padnames[i]))
+		    break;
+
+	    if (i == NUMPADCONTROLS
+		|| sscanf (line, "%*d %*s %*s %d", &nextevent.padvalue) != 1)
+		continue;
+
+	    nextevent.padcontrol = i;
+	}
+	else
+	{
+	    nextevent.event.type = strcasecmp (action, "up") ? ev_keydown : ev_keyup;
+	    nextevent.event.data1 = I_ParseKey (key);
+	}
+
+	havenextevent = true;
+	return;
+    }
+}
+
+
+static void I_SetPadControl (int control, int value)
+{
+    switch (control)
+    {
+      case pad_lh:	paddata.ANA_L_H = value; break;
+      case pad_lv:	paddata.ANA_L_V = value; break;
+      case pad_rh:	paddata.ANA_R_H = value; break;
+      case pad_rv:	paddata.ANA_R_V = value; break;
+      case pad_triangle:	paddata.BTN_TRIANGLE = value != 0; break;
+      case pad_square:	paddata.BTN_SQUARE = value != 0; break;
+    }
+}
+
+
+static void I_GetEvent(void)
+{
+    lastpaddata = paddata;
+
+    while (havenextevent && nextevent.tic <= gametic)
+    {
+	if (nextevent.padcontrol != -1)
+	    I_SetPadControl (nextevent.padcontrol, nextevent.padvalue);
+	else
+	    D_PostEvent (&nextevent.event);
+
+	I_ReadInputEvent ();
+    }
+}
+
+void I_StartFrame (void)
+{
+    I_GetEvent();
+    return;
+}
+
+void I_StartTic (void)
+{
+    I_GetEvent();
+    return;
+}
+
+void I_UpdateNoBlit (void)
+{
+    return;
+}
+
+void I_FinishUpdate (void)
+{
+    int		i;
+    byte*	src;
+
+    src = screens[0];
+    for (i=0 ; i<SCREENWIDTH*SCREENHEIGHT ; i++)
+	host_framebuffer[i] = current_palette[src[i]];
+
+    return;
+}
+
+void I_ReadScreen (byte* scr)
+{
+    memcpy (scr, screens[0], SCREENWIDTH*SCREENHEIGHT);
+    return;
+}
+
+void I_SetPalette (byte* palette)
+{
+    int i;
+    uint8_t r, g, b;
+
+    for (i=0; i<256; i++)
+    {
+        r = gammatable[usegamma][*palette++];
+        g = gammatable[usegamma][*palette++];
+        b = gammatable[usegamma][*palette++];
+
+        current_palette[i] = (b | (g<<8) | (r<<16));
+    }
+
+    return;
+}
+
+void I_ShutdownGraphics (void)
+{
+    if (inputfile)
+    {
+	fclose (inputfile);
+	inputfile = NULL;
+    }
+
+    return;
+}
+
+static void I_InitInput (void)
+{
+    int		p;
+
+    memset (&padinfo, 0, sizeof(padinfo));
+    memset (&paddata, 0, sizeof(paddata));
+
+    paddata.ANA_L_H = paddata.ANA_L_V = 128;
+    paddata.ANA_R_H = paddata.ANA_R_V = 128;
+    lastpaddata = paddata;
+
+    p = M_CheckParm ("-input");
+    if (p && p < myargc-1)
+    {
+	inputfile = fopen (myargv[p+1], "r");
+	if (!inputfile)
+	    I_Error ("I_InitInput: can't open %s", myargv[p+1]);
+
+	I_ReadInputEvent ();
+    }
+}
+
+void I_InitGraphics(void)
+{
+    screens[0] = (byte *)malloc(SCREENWIDTH*SCREENHEIGHT);
+    host_framebuffer = (uint32_t *)malloc(SCREENWIDTH*SCREENHEIGHT*4);
+
+    I_InitInput();
+
+    graphics_initialized = 1;
+
+    return;
+}
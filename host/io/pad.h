@@ -0,0 +1,55 @@
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//	Stand-in for PSL1GHT's <io/pad.h> in the headless host build.
+//	Only the pad state layout is provided; g_game.c reads the
+//	analog sticks and face buttons from it. The host input code
+//	in i_video.c fills it in.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __HOST_IO_PAD_H__
+#define __HOST_IO_PAD_H__
+
+#include <stdint.h>
+
+#define MAX_PADS	7
+
+typedef struct
+{
+    uint32_t	max;
+    uint32_t	connected;
+    uint32_t	info;
+    uint8_t	status[MAX_PADS];
+} PadInfo;
+
+typedef struct
+{
+    int32_t	len;
+
+    unsigned	BTN_LEFT:1;
+    unsigned	BTN_DOWN:1;
+    unsigned	BTN_RIGHT:1;
+    unsigned	BTN_UP:1;
+    unsigned	BTN_START:1;
+    unsigned	BTN_R3:1;
+    unsigned	BTN_L3:1;
+    unsigned	BTN_SELECT:1;
+
+    unsigned	BTN_SQUARE:1;
+    unsigned	BTN_CROSS:1;
+    unsigned	BTN_CIRCLE:1;
+    unsigned	BTN_TRIANGLE:1;
+    unsigned	BTN_R1:1;
+    unsigned	BTN_L1:1;
+    unsigned	BTN_R2:1;
+    unsigned	BTN_L2:1;
+
+    // 0-255, 128 is centred.
+    uint16_t	ANA_R_H;
+    uint16_t	ANA_R_V;
+    uint16_t	ANA_L_H;
+    uint16_t	ANA_L_V;
+} PadData;
+
+#endif
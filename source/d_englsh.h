@@ -137,6 +137,7 @@
 //	G_game.C
 //
 #define GGSAVED	"game saved."
+#define GGNOTSAVED	"game not saved."
 
 //
 //	HU_stuff.C
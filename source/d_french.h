@@ -129,6 +129,7 @@
 //	G_game.C
 //
 #define GGSAVED		"JEU SAUVEGARDE."
+#define GGNOTSAVED	"JEU NON SAUVEGARDE."
 
 //
 //	HU_stuff.C
@@ -49,10 +49,14 @@
 #include "m_argv.h"
 #include "m_misc.h"
 #include "m_menu.h"
+#include "m_bench.h"
+#include "m_prof.h"
 #include "i_system.h"
 #include "i_sound.h"
 #include "i_video.h"
 #include "g_game.h"
+#include "g_verify.h"
+#include "g_snap.h"
 #include "hu_stuff.h"
 #include "wi_stuff.h"
 #include "st_stuff.h"
@@ -254,7 +258,11 @@ void D_Display (void)
     
     // draw the view directly
     if (gamestate == GS_LEVEL && !automapactive && gametic)
+    {
+	PROF_BEGIN (pz_render);
         R_RenderPlayerView (&players[displayplayer]);
+	PROF_END (pz_render);
+    }
 
     if (gamestate == GS_LEVEL && gametic)
         HU_Drawer ();
@@ -301,6 +309,7 @@ void D_Display (void)
 
 
     // menus go directly to the screen
+    M_ProfDrawer ();      // profiler overlay, if -profile
     M_Drawer ();          // menu is drawn even on top of everything
     NetUpdate ();         // send out any new accumulation
 
@@ -308,7 +317,11 @@ void D_Display (void)
     // normal update
     if (!wipe)
     {
+	M_BenchBeginPhase (bp_blit);
+	PROF_BEGIN (pz_blit);
 	I_FinishUpdate ();              // page flip or blit buffer
+	PROF_END (pz_blit);
+	M_BenchEndPhase (bp_blit);
 	return;
     }
     
@@ -321,6 +334,7 @@ void D_Display (void)
     {
 	do
 	{
+	    I_WaitForTic (wipestart + 1);
 	    nowtime = I_GetTime ();
 	    tics = nowtime - wipestart;
 	} while (!tics);
@@ -330,7 +344,9 @@ void D_Display (void)
 			       , 0, 0, SCREENWIDTH, SCREENHEIGHT, tics);
 	I_UpdateNoBlit ();
         M_Drawer ();                            // menu is drawn even on top of wipes
+	PROF_BEGIN (pz_blit);
 	I_FinishUpdate ();                      // page flip or blit buffer
+	PROF_END (pz_blit);
     } while (!done);
     
     
@@ -380,6 +396,9 @@ void D_DoomLoop (void)
 
     while (1)
     {
+	M_BenchStartFrame ();
+	M_ProfStartFrame ();
+
 	// frame syncronous IO operations
 	I_StartFrame ();                
 	
@@ -392,7 +411,11 @@ void D_DoomLoop (void)
 	    if (advancedemo)
 		D_DoAdvanceDemo ();
 	    M_Ticker ();
+	    M_BenchBeginPhase (bp_sim);
+	    PROF_BEGIN (pz_sim);
 	    G_Ticker ();
+	    PROF_END (pz_sim);
+	    M_BenchEndPhase (bp_sim);
 	    gametic++;
 	    maketic++;
 	}
@@ -400,11 +423,21 @@ void D_DoomLoop (void)
 	{
 	    TryRunTics (); // will run at least one tic
 	}
+
+	// a demo seek runs its tics here, between frames
+	G_SnapUpdate ();
 	
 	S_UpdateSounds (players[consoleplayer].mo);// move positional sounds
+	I_SubmitSound ();	// feed clocked sound outputs
 
-	// Update display, next frame, with current state.
+	// Update display, next frame, with current state,
+	// the console player moved on if predicting.
+	D_StartPrediction ();
 	D_Display ();
+	D_EndPrediction ();
+
+	M_ProfEndFrame ();
+	M_BenchEndFrame ();
     }
 }
 
@@ -717,6 +750,18 @@ void D_DoomMain (void)
 	    D_AddFile (myargv[p]);
     }
 
+    p = M_CheckParm ("-benchmark");
+    if (p)
+    {
+	// the parms after p are demo names,
+	// until end of parms or another - preceded parm
+	while (++p != myargc && myargv[p][0] != '-')
+	{
+	    sprintf (file,"%s.lmp", myargv[p]);
+	    D_AddFile (file);
+	}
+    }
+
     p = M_CheckParm ("-playdemo");
 
     if (!p)
@@ -883,6 +928,7 @@ void D_DoomMain (void)
 
     printf ("M_Init: Init miscellaneous info.\n");
     M_Init ();
+    M_ProfInit ();
 
     printf ("R_Init: Init DOOM refresh daemon\n");
     R_Init ();
@@ -926,6 +972,8 @@ void D_DoomMain (void)
 	autostart = true;
     }
 	
+    G_VerifyDemos ();	// exits if -verifydemos
+
     p = M_CheckParm ("-playdemo");
     if (p && p < myargc-1)
     {
@@ -940,6 +988,9 @@ void D_DoomMain (void)
 	G_TimeDemo (myargv[p+1]);
 	D_DoomLoop ();  // never returns
     }
+
+    if (M_BenchInit ())
+	D_DoomLoop ();  // never returns
 	
     p = M_CheckParm ("-loadgame");
     if (p && p < myargc-1)
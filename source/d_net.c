@@ -25,10 +25,14 @@
 //-----------------------------------------------------------------------------
 
 #include "m_menu.h"
+#include "m_bench.h"
+#include "m_prof.h"
 #include "i_system.h"
 #include "i_video.h"
 #include "i_net.h"
 #include "g_game.h"
+#include "m_argv.h"
+#include "p_local.h"
 #include "doomdef.h"
 #include "doomstat.h"
 
@@ -72,6 +76,8 @@ int		skiptics;
 int		ticdup;		
 int		maxsend;	// BACKUPTICS/(2*ticdup)-1
 
+boolean		netpredict;	// draw the console player ahead
+
 
 void D_ProcessEvents (void); 
 void G_BuildTiccmd (ticcmd_t *cmd); 
@@ -585,6 +591,8 @@ void D_CheckNetGame (void)
 	playeringame[i] = true;
     for (i=0 ; i<doomcom->numnodes ; i++)
 	nodeingame[i] = true;
+
+    netpredict = netgame && M_CheckParm ("-predict");
 	
     printf ("player %i of %i (%i nodes)\n",
 	    consoleplayer+1, doomcom->numplayers, doomcom->numnodes);
@@ -621,6 +629,54 @@ void D_QuitNetGame (void)
 
 
 
+//
+// D_SyncTics
+//
+void D_SyncTics (void)
+{
+    if (maketic < gametic)
+	maketic = gametic;
+
+    // the commands in between are never used in a demo
+    nettics[0] = maketic;
+    resendto[0] = maketic;
+}
+
+
+//
+// D_StartPrediction
+// With -predict, moves the console player on through the commands
+// it has made that have not been run yet, for drawing the next
+// frame. D_EndPrediction puts it back.
+//
+void D_StartPrediction (void)
+{
+    player_t*	player;
+    int		tic;
+    int		i;
+
+    player = &players[consoleplayer];
+
+    if (!netpredict || demoplayback || paused
+	|| gamestate != GS_LEVEL
+	|| player->playerstate != PST_LIVE
+	|| !player->mo)
+	return;
+
+    P_StartPrediction (player);
+
+    for (tic = gametic/ticdup ; tic < maketic ; tic++)
+	for (i=0 ; i<ticdup ; i++)
+	    P_PredictPlayer (player, &localcmds[tic%BACKUPTICS]);
+}
+
+void D_EndPrediction (void)
+{
+    if (predicting)
+	P_EndPrediction (&players[consoleplayer]);
+}
+
+
 //
 // TryRunTics
 //
@@ -641,6 +697,7 @@ void TryRunTics (void)
     int		availabletics;
     int		counts;
     int		numplaying;
+    int		entermaketic;
     
     // get real tics		
     entertic = I_GetTime ()/ticdup;
@@ -649,6 +706,7 @@ void TryRunTics (void)
     
     // get available tics
     NetUpdate ();
+    entermaketic = maketic;
 	
     lowtic = MAXINT;
     numplaying = 0;
@@ -721,6 +779,20 @@ void TryRunTics (void)
 	
 	if (lowtic < gametic/ticdup)
 	    I_Error ("TryRunTics: lowtic < gametic");
+
+	// when predicting, a new command of our own is drawn at
+	// once, running only the tics the other nodes have sent
+	if (netpredict && maketic != entermaketic)
+	{
+	    counts = lowtic - gametic/ticdup;
+	    break;
+	}
+
+	// If our own tics are missing, nothing can change before
+	// the clock reaches the next tic, so sleep until then.
+	// Tics from other nodes are still polled for.
+	if (nettics[0] < gametic/ticdup + counts)
+	    I_WaitForTic ((I_GetTime ()/ticdup + 1) * ticdup);
 				
 	// don't stay in here forever -- give the menu a chance to work
 	if (I_GetTime ()/ticdup - entertic >= 20)
@@ -740,7 +812,11 @@ void TryRunTics (void)
 	    if (advancedemo)
 		D_DoAdvanceDemo ();
 	    M_Ticker ();
+	    M_BenchBeginPhase (bp_sim);
+	    PROF_BEGIN (pz_sim);
 	    G_Ticker ();
+	    PROF_END (pz_sim);
+	    M_BenchEndPhase (bp_sim);
 	    gametic++;
 	    
 	    // modify command for duplicated tics
@@ -137,5 +137,14 @@ void D_QuitNetGame (void);
 //? how many ticks to run?
 void TryRunTics (void);
 
+// Moves the console player ahead for drawing with -predict,
+// and back again.
+void D_StartPrediction (void);
+void D_EndPrediction (void);
+
+// Catches the tic counters up after gametic was advanced
+// outside TryRunTics, as by a demo seek. Single node only.
+void D_SyncTics (void);
+
 
 #endif
@@ -56,12 +56,27 @@ typedef union
 typedef actionf_t  think_t;
 
 
+// How often P_RunThinkers runs a thinker.
+typedef enum
+{
+    ta_active,		// every tic
+    ta_sleeping,	// a monster waiting in its A_Look states
+    ta_static		// not until something wakes it
+    
+} thinkactivity_t;
+
+
 // Doubly linked list of actors.
 typedef struct thinker_s
 {
     struct thinker_s*	prev;
     struct thinker_s*	next;
     think_t		function;
+
+    // the list of those with the same activity
+    struct thinker_s*	aprev;
+    struct thinker_s*	anext;
+    thinkactivity_t	activity;
     
 } thinker_t;
 
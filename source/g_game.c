@@ -34,6 +34,10 @@
 #include "m_misc.h"
 #include "m_menu.h"
 #include "m_random.h"
+#include "m_bench.h"
+#include "g_verify.h"
+#include "g_tichash.h"
+#include "g_snap.h"
 #include "i_system.h"
 
 #include "p_setup.h"
@@ -69,14 +73,13 @@
 #include "g_game.h"
 
 
-#define SAVEGAMESIZE	0x2c000
 #define SAVESTRINGSIZE	24
 
 
 
 boolean	G_CheckDemoStatus (void); 
 void	G_ReadDemoTiccmd (ticcmd_t* cmd); 
-void	G_WriteDemoTiccmd (ticcmd_t* cmd); 
+void	G_WriteDemoTiccmd (ticcmd_t* cmd, int player); 
 void	G_PlayerReborn (int player); 
 void	G_InitNew (skill_t skill, int episode, int map); 
  
@@ -129,7 +132,6 @@ boolean		netdemo;
 
 byte*		demobuffer;
 byte*		demo_p;
-byte*		demoend; 
 
 boolean         singledemo;            	// quit after playing a demo from cmdline 
  
@@ -140,6 +142,7 @@ wbstartstruct_t wminfo;               	// parms for world map / intermission
 short		consistancy[MAXPLAYERS][BACKUPTICS]; 
  
 byte*		savebuffer;
+static boolean	savewriting;		// G_CheckSave has yet to report it
  
  
 // 
@@ -207,8 +210,6 @@ int		savegameslot;
 char		savedescription[32]; 
  
  
-#define	BODYQUESIZE	32
-
 mobj_t*		bodyque[BODYQUESIZE]; 
 int		bodyqueslot; 
  
@@ -654,6 +655,10 @@ boolean G_Responder (event_t* ev)
 	return true; 
     }
     
+    // seeking in demos, with -snapshots
+    if (demoplayback && G_SnapResponder (ev))
+	return true;
+
     // any other key pops up menu if in demos
     if (gameaction == ga_nothing && !singledemo && 
 	(demoplayback || gamestate == GS_DEMOSCREEN) 
@@ -743,6 +748,9 @@ void G_Ticker (void)
 	if (playeringame[i] && players[i].playerstate == PST_REBORN) 
 	    G_DoReborn (i);
     
+    // a save being written in the background may be done
+    G_CheckSave (false);
+
     // do things to change the game state
     while (gameaction != ga_nothing) 
     { 
@@ -796,7 +804,7 @@ void G_Ticker (void)
 	    if (demoplayback) 
 		G_ReadDemoTiccmd (cmd); 
 	    if (demorecording) 
-		G_WriteDemoTiccmd (cmd);
+		G_WriteDemoTiccmd (cmd, i);
 	    
 	    // check for turbo cheats
 	    if (cmd->forwardmove > TURBOTHRESHOLD 
@@ -875,6 +883,11 @@ void G_Ticker (void)
 	D_PageTicker (); 
 	break; 
     }        
+
+    if (demoplayback || demorecording)
+	G_TicHash ();
+    if (demoplayback)
+	G_SnapTic ();
 } 
  
  
@@ -1152,6 +1165,9 @@ void G_DoCompleted (void)
     int             i; 
 	 
     gameaction = ga_nothing; 
+
+    if (verifyingdemos)
+	G_VerifyLevelExit ();
  
     for (i=0 ; i<MAXPLAYERS ; i++) 
 	if (playeringame[i]) 
@@ -1327,26 +1343,19 @@ void G_LoadGame (char* name)
  
 #define VERSIONSIZE		16 
 
+// Follows the version in compact saves, see P_WriteGame.
+#define SAVEFORMAT		3
+
+
+//
+// G_DoLoadOldGame
+// The rest of a save from before the compact format.
+//
+static void G_DoLoadOldGame (void)
+{
+    int		i;
+    int		a,b,c;
 
-void G_DoLoadGame (void) 
-{ 
-    int		length; 
-    int		i; 
-    int		a,b,c; 
-    char	vcheck[VERSIONSIZE]; 
-	 
-    gameaction = ga_nothing; 
-	 
-    length = M_ReadFile (savename, &savebuffer); 
-    save_p = savebuffer + SAVESTRINGSIZE;
-    
-    // skip the description field 
-    memset (vcheck,0,sizeof(vcheck)); 
-    sprintf (vcheck,"version %i",VERSION); 
-    if (strcmp (save_p, vcheck)) 
-	return;				// bad version 
-    save_p += VERSIONSIZE; 
-			 
     gameskill = *save_p++; 
     gameepisode = *save_p++; 
     gamemap = *save_p++; 
@@ -1372,8 +1381,62 @@ void G_DoLoadGame (void)
 	I_Error ("Bad savegame");
     
     // done 
-    Z_Free (savebuffer); 
- 
+    Z_Free (savebuffer);
+}
+
+
+void G_DoLoadGame (void) 
+{ 
+    int		length; 
+    int		i; 
+    boolean	compact;
+    char	vcheck[VERSIONSIZE]; 
+	 
+    gameaction = ga_nothing; 
+
+    // it may be the save still being written
+    G_CheckSave (true);
+	 
+    M_RecoverFile (savename);
+    length = M_ReadFile (savename, &savebuffer); 
+    save_p = savebuffer + SAVESTRINGSIZE;
+    
+    // skip the description field 
+    // saves before the compact format have no format number
+    memset (vcheck,0,sizeof(vcheck)); 
+    sprintf (vcheck,"version %i/%i",VERSION,SAVEFORMAT); 
+    compact = length >= SAVESTRINGSIZE+VERSIONSIZE
+	&& !strncmp ((char *)save_p, vcheck, VERSIONSIZE);
+    sprintf (vcheck,"version %i",VERSION); 
+    if (!compact && strcmp ((char *)save_p, vcheck))
+    {
+	Z_Free (savebuffer);
+	return;				// bad version 
+    }
+    save_p += VERSIONSIZE; 
+
+    if (compact)
+    {
+	P_BeginLoad (save_p, length - (save_p - savebuffer));
+	gameskill = P_ReadByte (); 
+	gameepisode = P_ReadByte (); 
+	gamemap = P_ReadByte (); 
+	for (i=0 ; i<MAXPLAYERS ; i++) 
+	    playeringame[i] = P_ReadByte (); 
+
+	// load a base level 
+	G_InitNew (gameskill, gameepisode, gamemap); 
+
+	leveltime = P_ReadLong ();
+	P_ReadGame ();
+
+	if (P_ReadByte () != 0x1d)
+	    I_Error ("Bad savegame");
+	Z_Free (savebuffer);
+    }
+    else
+	G_DoLoadOldGame ();
+
     if (setsizeneeded)
 	R_ExecuteSetViewSize ();
     
@@ -1397,11 +1460,33 @@ G_SaveGame
     sendsave = true; 
 } 
  
+//
+// G_CheckSave
+// Tells the player once the save G_DoSaveGame started is on
+// disk, waiting for it with wait.
+//
+void G_CheckSave (boolean wait)
+{
+    int		result;
+
+    if (!savewriting)
+	return;
+
+    result = M_WriteFileResult (wait);
+    if (!result)
+	return;
+
+    savewriting = false;
+    players[consoleplayer].message = result > 0 ? GGSAVED : GGNOTSAVED;
+}
+
+
 void G_DoSaveGame (void) 
 { 
     char	name[100]; 
     char	name2[VERSIONSIZE]; 
     char*	description; 
+    byte*	buffer;
     int		length; 
     int		i; 
 	
@@ -1411,39 +1496,31 @@ void G_DoSaveGame (void)
 	sprintf (name,SAVEGAMENAME"%d.dsg",savegameslot); 
     description = savedescription; 
 	 
-    save_p = savebuffer = screens[1]+0x4000; 
-	 
-    memcpy (save_p, description, SAVESTRINGSIZE); 
-    save_p += SAVESTRINGSIZE; 
+    P_BeginSave ();
+    P_WriteBytes (description, SAVESTRINGSIZE);
     memset (name2,0,sizeof(name2)); 
-    sprintf (name2,"version %i",VERSION); 
-    memcpy (save_p, name2, VERSIONSIZE); 
-    save_p += VERSIONSIZE; 
+    sprintf (name2,"version %i/%i",VERSION,SAVEFORMAT); 
+    P_WriteBytes (name2, VERSIONSIZE);
 	 
-    *save_p++ = gameskill; 
-    *save_p++ = gameepisode; 
-    *save_p++ = gamemap; 
+    P_WriteByte (gameskill); 
+    P_WriteByte (gameepisode); 
+    P_WriteByte (gamemap); 
     for (i=0 ; i<MAXPLAYERS ; i++) 
-	*save_p++ = playeringame[i]; 
-    *save_p++ = leveltime>>16; 
-    *save_p++ = leveltime>>8; 
-    *save_p++ = leveltime; 
- 
-    P_ArchivePlayers (); 
-    P_ArchiveWorld (); 
-    P_ArchiveThinkers (); 
-    P_ArchiveSpecials (); 
+	P_WriteByte (playeringame[i]); 
+    P_WriteLong (leveltime);
+
+    P_WriteGame ();
 	 
-    *save_p++ = 0x1d;		// consistancy marker 
+    P_WriteByte (0x1d);		// consistancy marker 
 	 
-    length = save_p - savebuffer; 
-    if (length > SAVEGAMESIZE) 
-	I_Error ("Savegame buffer overrun"); 
-    M_WriteFile (name, savebuffer, length); 
+    // written out in the background, G_CheckSave tells when done
+    buffer = P_EndSave (&length);
+    savewriting = M_StartWriteFile (name, buffer, length);
     gameaction = ga_nothing; 
     savedescription[0] = 0;		 
 	 
-    players[consoleplayer].message = GGSAVED; 
+    if (!savewriting)
+	players[consoleplayer].message = GGNOTSAVED; 
 
     // draw the pattern into the back screen
     R_FillBackScreen ();	
@@ -1617,6 +1694,42 @@ G_InitNew
 // 
 #define DEMOMARKER		0x80
 
+// version, skill, episode, map, deathmatch, respawn, fast,
+// nomonsters, consoleplayer and the players in game
+#define DEMOHEADERSIZE		(9+MAXPLAYERS)
+
+
+//
+// Packed demos (-packdemo) start with DEMOPACKED, then the
+// usual header. Each ticcmd is a byte of bits saying which of
+// its four bytes differ from the same player's last one, then
+// those bytes, so a repeated ticcmd takes a single zero byte.
+// They are unpacked before playing.
+//
+#define DEMOPACKED		0x70
+
+// Recorded demos are flushed at least this often.
+#define DEMOFLUSHTICS		(5*TICRATE)
+
+// Size of each of the two buffers of the recording.
+#define DEMOBUFSIZE		0x4000
+
+static mstream_t*	demostream;
+static boolean		demopacked;
+static int		demoflushtic;
+static byte		demolastcmd[MAXPLAYERS][4];
+
+static byte*		demounpacked;
+
+
+static void G_UnpackTiccmd (byte* p, ticcmd_t* cmd)
+{
+    cmd->forwardmove = (int8_t)p[0];
+    cmd->sidemove = (int8_t)p[1];
+    cmd->angleturn = (int16_t)(p[2]<<8);
+    cmd->buttons = (int8_t)p[3];
+}
+
 
 void G_ReadDemoTiccmd (ticcmd_t* cmd) 
 { 
@@ -1627,64 +1740,96 @@ void G_ReadDemoTiccmd (ticcmd_t* cmd)
 	return; 
     } 
 
-    cmd->forwardmove = (int8_t)(*demo_p++);
-    cmd->sidemove = (int8_t)(*demo_p++);
-    cmd->angleturn = (int16_t)((*demo_p++)<<8);
-    cmd->buttons = (int8_t)(*demo_p++);
-    
-    return;
+    G_UnpackTiccmd (demo_p, cmd);
+    demo_p += 4;
 } 
 
 
-void G_WriteDemoTiccmd (ticcmd_t* cmd) 
+void G_WriteDemoTiccmd (ticcmd_t* cmd, int player) 
 { 
+    byte	raw[4];
+    byte	packed[5];
+    byte*	last;
+    byte*	p;
+    int		i;
+
     if (gamekeydown['q'])           // press q to end demo recording 
 	G_CheckDemoStatus (); 
-    *demo_p++ = cmd->forwardmove; 
-    *demo_p++ = cmd->sidemove; 
-    *demo_p++ = (cmd->angleturn+128)>>8; 
-    *demo_p++ = cmd->buttons; 
-    demo_p -= 4; 
-    if (demo_p > demoend - 16)
+
+    raw[0] = cmd->forwardmove; 
+    raw[1] = cmd->sidemove; 
+    raw[2] = (cmd->angleturn+128)>>8; 
+    raw[3] = cmd->buttons; 
+
+    G_UnpackTiccmd (raw, cmd);      // make SURE it is exactly the same 
+
+    if (!demopacked)
+	M_StreamWrite (demostream, raw, 4);
+    else
     {
-	// no more space 
-	G_CheckDemoStatus (); 
-	return; 
-    } 
-	
-    G_ReadDemoTiccmd (cmd);         // make SURE it is exactly the same 
+	last = demolastcmd[player];
+	p = packed+1;
+	packed[0] = 0;
+
+	for (i=0 ; i<4 ; i++)
+	{
+	    if (raw[i] == last[i])
+		continue;
+	    packed[0] |= 1<<i;
+	    *p++ = last[i] = raw[i];
+	}
+
+	M_StreamWrite (demostream, packed, p - packed);
+    }
+
+    if (gametic - demoflushtic >= DEMOFLUSHTICS)
+    {
+	M_FlushStream (demostream);
+	demoflushtic = gametic;
+    }
 } 
  
  
  
 //
 // G_RecordDemo 
+// The demo is streamed to the file as it is recorded,
+// so it can be as long as it needs to be.
 // 
 void G_RecordDemo (char* name) 
 { 
     int             i; 
-    int				maxsize;
+    int		    bufsize;
 	
     usergame = false; 
     strcpy (demoname, name); 
     strcat (demoname, ".lmp"); 
-    maxsize = 0x20000;
+    bufsize = DEMOBUFSIZE;
     i = M_CheckParm ("-maxdemo");
     if (i && i<myargc-1)
-	maxsize = atoi(myargv[i+1])*1024;
-    demobuffer = Z_Malloc (maxsize,PU_STATIC,NULL); 
-    demoend = demobuffer + maxsize;
-	
+	bufsize = atoi(myargv[i+1])*1024;
+    if (bufsize < 1024)
+	bufsize = 1024;
+
+    demostream = M_OpenStream (demoname, bufsize);
+    if (!demostream)
+	I_Error ("G_RecordDemo: can't write %s", demoname);
+
+    demopacked = M_CheckParm ("-packdemo");
     demorecording = true; 
 } 
  
  
 void G_BeginRecording (void) 
 { 
-    int             i; 
+    byte	header[1+DEMOHEADERSIZE];
+    int		i; 
 		
-    demo_p = demobuffer;
+    demo_p = header;
 	
+    if (demopacked)
+	*demo_p++ = DEMOPACKED;
+
     *demo_p++ = VERSION;
     *demo_p++ = gameskill; 
     *demo_p++ = gameepisode; 
@@ -1697,9 +1842,98 @@ void G_BeginRecording (void)
 	 
     for (i=0 ; i<MAXPLAYERS ; i++) 
 	*demo_p++ = playeringame[i]; 		 
+
+    M_StreamWrite (demostream, header, demo_p - header);
+    memset (demolastcmd, 0, sizeof(demolastcmd));
+    demoflushtic = gametic;
+
+    G_TicHashStart (demoname);
 } 
  
 
+//
+// G_UnpackDemo
+// Replaces a packed demo in buffer with the plain one, freeing
+// the packed copy. Returns the length of the demo in buffer.
+// A packed demo cut short by a crash ends at its last whole tic.
+//
+int G_UnpackDemo (byte** buffer, int length)
+{
+    byte*	in;
+    byte*	end;
+    byte*	out;
+    byte*	header;
+    byte	last[MAXPLAYERS][4];
+    int		flags;
+    int		n;
+    int		i;
+    int		j;
+
+    in = *buffer;
+    if (length < 1+DEMOHEADERSIZE || in[0] != DEMOPACKED)
+	return length;
+
+    end = in + length;
+    in++;
+
+    // the last demo unpacked has to go before its owner is reused
+    if (demounpacked)
+	Z_Free (demounpacked);
+
+    // each packed ticcmd takes at least one byte
+    out = Z_Malloc (DEMOHEADERSIZE + (length-1-DEMOHEADERSIZE)*4 + 1,
+		    PU_STATIC, &demounpacked);
+
+    memcpy (out, in, DEMOHEADERSIZE);
+    header = out;
+    in += DEMOHEADERSIZE;
+    out += DEMOHEADERSIZE;
+
+    memset (last, 0, sizeof(last));
+
+    while (in < end && *in != DEMOMARKER)
+    {
+	for (i=0 ; i<MAXPLAYERS ; i++)
+	{
+	    if (!header[9+i])
+		continue;
+
+	    if (in == end)
+		break;
+	    flags = *in;
+	    for (n=1, j=0 ; j<4 ; j++)
+		if (flags & (1<<j))
+		    n++;
+	    if (in + n > end)
+		break;
+	    in++;
+
+	    for (j=0 ; j<4 ; j++)
+		if (flags & (1<<j))
+		    last[i][j] = *in++;
+
+	    memcpy (out, last[i], 4);
+	    out += 4;
+	}
+
+	if (i < MAXPLAYERS)
+	{
+	    // drop the tic the demo was cut in
+	    while (i-- > 0)
+		if (header[i+9])
+		    out -= 4;
+	    break;
+	}
+    }
+
+    *out++ = DEMOMARKER;
+
+    Z_Free (*buffer);
+    *buffer = header;
+    return out - header;
+}
+
+
 //
 // G_PlayDemo 
 //
@@ -1713,12 +1947,29 @@ void G_DeferedPlayDemo (char* name)
 } 
  
 void G_DoPlayDemo (void) 
+{ 
+    byte*	buffer;
+    int		lump;
+
+    gameaction = ga_nothing; 
+    lump = W_GetNumForName (defdemoname);
+    buffer = W_CacheLumpNum (lump, PU_STATIC);
+    G_UnpackDemo (&buffer, W_LumpLength (lump));
+    G_PlayDemoBuffer (buffer);
+    G_TicHashStart (defdemoname);
+    G_SnapStart ();
+} 
+
+//
+// G_PlayDemoBuffer
+// Starts playing a demo already in memory.
+//
+void G_PlayDemoBuffer (byte* buffer) 
 { 
     skill_t skill; 
     int             i, episode, map; 
 	 
-    gameaction = ga_nothing; 
-    demobuffer = demo_p = W_CacheLumpName (defdemoname, PU_STATIC); 
+    demobuffer = demo_p = buffer; 
     if ( *demo_p++ != VERSION)
     {
       I_Error("Demo is from a different game version!\n");
@@ -1752,6 +2003,33 @@ void G_DoPlayDemo (void)
     demoplayback = true; 
 } 
 
+//
+// G_DemoTic
+// Tics read so far from the demo playing.
+//
+static int G_DemoTicSize (void)
+{
+    int		i;
+    int		size;
+
+    size = 0;
+    for (i=0 ; i<MAXPLAYERS ; i++)
+	if (playeringame[i])
+	    size += 4;
+
+    return size;
+}
+
+int G_DemoTic (void)
+{
+    return (demo_p - demobuffer - DEMOHEADERSIZE) / G_DemoTicSize ();
+}
+
+void G_SetDemoTic (int tic)
+{
+    demo_p = demobuffer + DEMOHEADERSIZE + tic * G_DemoTicSize ();
+}
+
 //
 // G_TimeDemo 
 //
@@ -1780,7 +2058,32 @@ void G_TimeDemo (char* name)
 boolean G_CheckDemoStatus (void) 
 { 
     int             endtime; 
+    byte	    marker;
 	 
+    G_TicHashStop ();
+    G_SnapStop ();
+
+    if (verifyingdemos)
+    {
+	// the verifier frees its own buffer
+	demoplayback = false;
+	netdemo = false;
+	netgame = false;
+	deathmatch = false;
+	return true;
+    }
+
+    if (benchmarking)
+    {
+	Z_ChangeTag (demobuffer, PU_CACHE);
+	demoplayback = false;
+	netdemo = false;
+	netgame = false;
+	deathmatch = false;
+	M_BenchDemoDone ();
+	return true;
+    }
+
     if (timingdemo) 
     { 
 	endtime = I_GetTime (); 
@@ -1809,10 +2112,11 @@ boolean G_CheckDemoStatus (void)
  
     if (demorecording) 
     { 
-	*demo_p++ = DEMOMARKER; 
-	M_WriteFile (demoname, demobuffer, demo_p - demobuffer); 
-	Z_Free (demobuffer); 
+	marker = DEMOMARKER;
+	M_StreamWrite (demostream, &marker, 1);
 	demorecording = false; 
+	if (!M_CloseStream (demostream))
+	    I_Error ("Demo %s could not be written", demoname);
 	I_Error ("Demo %s recorded",demoname); 
     } 
 	 
@@ -46,6 +46,17 @@ void G_DeferedInitNew (skill_t skill, int episode, int map);
 
 void G_DeferedPlayDemo (char* demo);
 
+// Starts playing a demo at once from memory.
+void G_PlayDemoBuffer (byte* buffer);
+
+// Replaces a -packdemo demo with the plain one,
+// returns the length of the demo in buffer.
+int G_UnpackDemo (byte** buffer, int length);
+
+// Position in the demo playing, in tics.
+int G_DemoTic (void);
+void G_SetDemoTic (int tic);
+
 // Can be called by the startup code or M_Responder,
 // calls P_SetupLevel or W_EnterWorld.
 void G_LoadGame (char* name);
@@ -55,6 +66,10 @@ void G_DoLoadGame (void);
 // Called by M_Responder.
 void G_SaveGame (int slot, char* description);
 
+// Shows "game saved." once the save is written, which goes
+// on in the background. With wait, waits for it.
+void G_CheckSave (boolean wait);
+
 // Only called by startup code.
 void G_RecordDemo (char* name);
 
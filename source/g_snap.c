@@ -0,0 +1,407 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//	Demo snapshots and seeking.
+//
+//	-snapshots [tics] takes a snapshot of the play state with
+//	P_ArchiveSnapshot every so many tics of a demo being played,
+//	350 by default, into an arena of -snapmem <MB> megabytes,
+//	32 by default. When the arena fills up every other snapshot
+//	is dropped and the interval doubles, so the snapshots always
+//	cover the whole demo played so far.
+//
+//	The left and right arrow keys then seek ten seconds back and
+//	forward, and -seek <tic> goes to a tic as soon as the demo
+//	starts. A seek restores the last snapshot at or before the
+//	tic and runs the tics after it without drawing. The time of
+//	each seek is reported, and the count, size and time of the
+//	snapshots when the demo ends.
+//
+//-----------------------------------------------------------------------------
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "d_net.h"
+#include "g_game.h"
+#include "g_tichash.h"
+#include "p_saveg.h"
+
+#include "g_snap.h"
+
+
+void G_DoLoadLevel (void);
+
+#define MAXSNAPSHOTS	1024
+
+// Snapshots start on this boundary in the arena, so moving
+// them keeps the padding in them right.
+#define SNAPALIGN	8
+
+#define SEEKSTEP	(10*TICRATE)
+
+typedef struct
+{
+    int		tic;		// demo tics run before it
+    int		gametic;	// A_Tracer acts on every fourth
+    int		episode;
+    int		map;
+    int		offset;		// in the arena
+    int		size;
+} snapshot_t;
+
+static boolean		snapshotting;
+static int		baseinterval = 350;
+static int		snapinterval;
+
+static byte*		arena;
+static int		arenasize;
+static int		arenaused;
+
+static snapshot_t	snapshots[MAXSNAPSHOTS];
+static int		numsnapshots;
+
+static int		startseek = -1;
+static int		seektarget = -1;
+static char		seekmessage[80];
+
+// Snapshots taken in the demo playing.
+static int		snapcount;
+static int64_t		snapbytes;
+static int		snapmaxbytes;
+static int64_t		snaptime;
+static int		snapmaxtime;
+
+
+
+//
+// G_SnapInit
+//
+static void G_SnapInit (void)
+{
+    static boolean	initialized;
+    int			megs;
+    int			p;
+
+    if (initialized)
+	return;
+    initialized = true;
+
+    p = M_CheckParm ("-snapshots");
+    if (p)
+    {
+	snapshotting = true;
+	if (p < myargc-1 && myargv[p+1][0] != '-')
+	    baseinterval = atoi (myargv[p+1]);
+    }
+
+    p = M_CheckParm ("-seek");
+    if (p && p < myargc-1)
+    {
+	snapshotting = true;
+	startseek = atoi (myargv[p+1]);
+    }
+
+    if (!snapshotting)
+	return;
+
+    if (baseinterval < 1)
+	baseinterval = 1;
+
+    megs = 32;
+    p = M_CheckParm ("-snapmem");
+    if (p && p < myargc-1)
+	megs = atoi (myargv[p+1]);
+
+    arenasize = megs << 20;
+    arena = malloc (arenasize);
+    if (!arena)
+	I_Error ("G_SnapInit: can't allocate %i MB for snapshots", megs);
+}
+
+
+//
+// G_ThinSnapshots
+// Doubles the interval, keeping the first snapshot
+// and those still on it.
+//
+static void G_ThinSnapshots (void)
+{
+    snapshot_t*	s;
+    int		kept;
+    int		i;
+
+    snapinterval *= 2;
+    arenaused = 0;
+    kept = 0;
+
+    for (i=0, s=snapshots ; i<numsnapshots ; i++, s++)
+    {
+	if (i && s->tic % snapinterval)
+	    continue;
+
+	memmove (arena + arenaused, arena + s->offset, s->size);
+	s->offset = arenaused;
+	snapshots[kept++] = *s;
+	arenaused += (s->size + SNAPALIGN-1) & ~(SNAPALIGN-1);
+    }
+
+    numsnapshots = kept;
+}
+
+
+//
+// G_TakeSnapshot
+//
+static void G_TakeSnapshot (int tic)
+{
+    snapshot_t*	s;
+    int64_t	start;
+    int		bound;
+    int		time;
+
+    bound = P_SnapshotSize ();
+    while (numsnapshots == MAXSNAPSHOTS || arenaused + bound > arenasize)
+    {
+	if (numsnapshots <= 1)
+	{
+	    printf ("G_TakeSnapshot: no room for the snapshot at tic %i\n", tic);
+	    return;
+	}
+	G_ThinSnapshots ();
+    }
+
+    // thinning may have moved the interval past this tic
+    if (tic % snapinterval)
+	return;
+
+    start = I_GetTimeUS ();
+    save_p = arena + arenaused;
+    P_ArchiveSnapshot ();
+    time = (int)(I_GetTimeUS () - start);
+
+    s = &snapshots[numsnapshots++];
+    s->tic = tic;
+    s->gametic = gametic;
+    s->episode = gameepisode;
+    s->map = gamemap;
+    s->offset = arenaused;
+    s->size = save_p - (arena + arenaused);
+    arenaused += (s->size + SNAPALIGN-1) & ~(SNAPALIGN-1);
+
+    snapcount++;
+    snapbytes += s->size;
+    snaptime += time;
+    if (s->size > snapmaxbytes)
+	snapmaxbytes = s->size;
+    if (time > snapmaxtime)
+	snapmaxtime = time;
+}
+
+
+//
+// G_SnapStart
+//
+void G_SnapStart (void)
+{
+    G_SnapInit ();
+    if (!snapshotting)
+	return;
+
+    snapinterval = baseinterval;
+    numsnapshots = 0;
+    arenaused = 0;
+
+    snapcount = 0;
+    snapbytes = snaptime = 0;
+    snapmaxbytes = snapmaxtime = 0;
+
+    G_TakeSnapshot (0);
+    seektarget = startseek;
+}
+
+
+//
+// G_SnapStop
+//
+void G_SnapStop (void)
+{
+    if (!snapshotting || !snapcount)
+	return;
+
+    printf ("G_SnapStop: %i snapshots taken, %i bytes and %.2f ms each"
+	    " (max %i bytes, %.2f ms), %i kept in %i KB, every %i tics\n",
+	    snapcount, (int)(snapbytes / snapcount),
+	    snaptime / 1000.0 / snapcount, snapmaxbytes, snapmaxtime / 1000.0,
+	    numsnapshots, arenaused >> 10, snapinterval);
+
+    snapcount = 0;
+}
+
+
+//
+// G_SnapTic
+//
+void G_SnapTic (void)
+{
+    int		tic;
+
+    if (!snapshotting || !demoplayback
+	|| gamestate != GS_LEVEL || gameaction != ga_nothing)
+	return;
+
+    tic = G_DemoTic ();
+    if (tic % snapinterval
+	|| (numsnapshots && tic <= snapshots[numsnapshots-1].tic))
+	return;
+
+    G_TakeSnapshot (tic);
+}
+
+
+//
+// G_SeekDemo
+//
+void G_SeekDemo (int tic)
+{
+    if (!snapshotting || !demoplayback)
+	return;
+
+    seektarget = tic < 0 ? 0 : tic;
+}
+
+
+//
+// G_SnapResponder
+//
+boolean G_SnapResponder (event_t* ev)
+{
+    int		from;
+
+    if (!snapshotting || !demoplayback || ev->type != ev_keydown)
+	return false;
+
+    // keys pressed again before the seek add up
+    from = seektarget >= 0 ? seektarget : G_DemoTic ();
+
+    switch (ev->data1)
+    {
+      case KEY_LEFTARROW:
+	G_SeekDemo (from - SEEKSTEP);
+	return true;
+
+      case KEY_RIGHTARROW:
+	G_SeekDemo (from + SEEKSTEP);
+	return true;
+    }
+
+    return false;
+}
+
+
+//
+// G_RestoreSnapshot
+//
+static void G_RestoreSnapshot (snapshot_t* s)
+{
+    if (gamestate != GS_LEVEL
+	|| gameepisode != s->episode || gamemap != s->map)
+    {
+	// load the level it was taken on; not with G_InitNew,
+	// which would halve -fast state tics again
+	gameepisode = s->episode;
+	gamemap = s->map;
+	precache = false;
+	G_DoLoadLevel ();
+	precache = true;
+    }
+
+    gameaction = ga_nothing;
+    save_p = arena + s->offset;
+    P_UnArchiveSnapshot ();
+    G_SetDemoTic (s->tic);
+
+    gametic += (s->gametic - gametic) & 3;
+}
+
+
+//
+// G_SnapUpdate
+// Does a seek asked for since the last frame.
+//
+void G_SnapUpdate (void)
+{
+    snapshot_t*	s;
+    int64_t	start;
+    int64_t	restored;
+    int		target;
+    int		from;
+    int		ran;
+    int		i;
+
+    if (seektarget < 0)
+	return;
+
+    target = seektarget;
+    seektarget = -1;
+    if (!demoplayback || !numsnapshots)
+	return;
+
+    // its tics no longer follow the file
+    G_TicHashStop ();
+
+    start = I_GetTimeUS ();
+
+    for (i=numsnapshots-1 ; i>0 && snapshots[i].tic > target ; i--)
+	;
+    s = &snapshots[i];
+
+    // going on from here is quicker if here is in between
+    from = G_DemoTic ();
+    if (gamestate != GS_LEVEL || from > target || from < s->tic)
+    {
+	G_RestoreSnapshot (s);
+    }
+    restored = I_GetTimeUS ();
+
+    ran = 0;
+    while (demoplayback && G_DemoTic () < target)
+    {
+	G_Ticker ();
+	gametic++;
+	ran++;
+    }
+    D_SyncTics ();
+
+    sprintf (seekmessage, "tic %i: restore %.1f ms, %i tics %.1f ms",
+	     G_DemoTic (), (restored - start) / 1000.0,
+	     ran, (I_GetTimeUS () - restored) / 1000.0);
+    printf ("G_SnapUpdate: seek to %s\n", seekmessage);
+
+    if (demoplayback)
+	players[consoleplayer].message = seekmessage;
+}
@@ -0,0 +1,49 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//	Demo snapshots and seeking.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __G_SNAP__
+#define __G_SNAP__
+
+#include "doomtype.h"
+#include "d_event.h"
+
+// Called when a demo starts and stops playing.
+void G_SnapStart (void);
+void G_SnapStop (void);
+
+// Called by G_Ticker after every tic of a demo.
+void G_SnapTic (void);
+
+// Seeks on the arrow keys while a demo plays.
+boolean G_SnapResponder (event_t* ev);
+
+// Asks for a seek to a demo tic, done by G_SnapUpdate.
+void G_SeekDemo (int tic);
+
+// Called by D_DoomLoop between frames.
+void G_SnapUpdate (void);
+
+#endif
@@ -0,0 +1,532 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//	Per tic world hashes of demos.
+//
+//	-hashrecord writes the world hash after every tic of a demo
+//	being recorded or played to a side file, <demo>.hsh. With
+//	-hashcheck a demo being played is checked against that file
+//	tic by tic, and play stops at the first tic that differs,
+//	listing the things and sectors that differ.
+//
+//	So the file can say what a thing looked like, each tic also
+//	carries the things and sectors that changed since the tic
+//	before, by index: things in thinker list order, sectors in
+//	map order. Things standing still and sectors at rest cost
+//	nothing. All words are little endian:
+//
+//	    "THSH" version
+//	    per tic: tic world rng players sectors things
+//	             numthings numsectors numchangedthings numchangedsectors
+//	             numchangedthings * (index type state x y z momx momy momz
+//	                                 health hash)
+//	             numchangedsectors * (index floor ceiling light special)
+//
+//-----------------------------------------------------------------------------
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "m_swap.h"
+#include "g_game.h"
+#include "g_verify.h"
+#include "p_hash.h"
+#include "r_state.h"
+
+#include "g_tichash.h"
+
+
+#define TICHASHVERSION	1
+
+// Differing things listed at a desync.
+#define MAXREPORTED	8
+
+boolean		tichashdesync;
+
+static FILE*	hashfile;
+static boolean	checking;
+static char	hashname[256];
+static int	hashtic;
+
+typedef struct
+{
+    fixed_t	floorheight;
+    fixed_t	ceilingheight;
+    int		lightlevel;
+    int		special;
+} sectorhash_t;
+
+// The world as last written, or as read from the file so far.
+static thinghash_t*	refthings;
+static int		numrefthings;
+static sectorhash_t*	refsectors;
+static int		numrefsectors;
+
+// The world now.
+static thinghash_t*	curthings;
+static int		numcurthings;
+static sectorhash_t*	cursectors;
+
+static int		maxthings;
+static int		maxsectors;
+
+
+
+//
+// G_DemoSideFile
+//
+void G_DemoSideFile (char* name, char* ext, char* dest, int size)
+{
+    int		len;
+
+    len = strlen (name);
+    if (len > 4 && !strcasecmp (name+len-4, ".lmp"))
+	len -= 4;
+
+    snprintf (dest, size, "%.*s.%s", len, name, ext);
+}
+
+
+//
+// G_TicHashStart
+//
+void G_TicHashStart (char* name)
+{
+    byte	header[8];
+
+    G_TicHashStop ();
+
+    tichashdesync = false;
+    hashtic = 0;
+    numrefthings = 0;
+    numrefsectors = 0;
+
+    checking = M_CheckParm ("-hashcheck") && demoplayback;
+    if (!checking && !M_CheckParm ("-hashrecord"))
+	return;
+
+    G_DemoSideFile (name, "hsh", hashname, sizeof(hashname));
+
+    if (!checking)
+    {
+	hashfile = fopen (hashname, "wb");
+	if (!hashfile)
+	    I_Error ("G_TicHashStart: can't write %s", hashname);
+
+	memcpy (header, "THSH", 4);
+	*(uint32_t*)(header+4) = LONG(TICHASHVERSION);
+	fwrite (header, 1, 8, hashfile);
+	return;
+    }
+
+    hashfile = fopen (hashname, "rb");
+    if (!hashfile)
+    {
+	printf ("G_TicHashStart: no %s to check against\n", hashname);
+	return;
+    }
+
+    if (fread (header, 1, 8, hashfile) != 8
+	|| memcmp (header, "THSH", 4)
+	|| LONG(*(uint32_t*)(header+4)) != TICHASHVERSION)
+    {
+	fclose (hashfile);
+	hashfile = NULL;
+	I_Error ("G_TicHashStart: %s is not a version %i hash file",
+		 hashname, TICHASHVERSION);
+    }
+}
+
+
+//
+// G_TicHashStop
+//
+void G_TicHashStop (void)
+{
+    if (!hashfile)
+	return;
+
+    fclose (hashfile);
+    hashfile = NULL;
+}
+
+
+static void G_WriteWords (uint32_t* words, int count)
+{
+    int		i;
+
+    for (i=0 ; i<count ; i++)
+	words[i] = LONG(words[i]);
+
+    fwrite (words, 4, count, hashfile);
+}
+
+
+static boolean G_ReadWords (uint32_t* words, int count)
+{
+    int		i;
+
+    if (fread (words, 4, count, hashfile) != (size_t)count)
+	return false;
+
+    for (i=0 ; i<count ; i++)
+	words[i] = LONG(words[i]);
+
+    return true;
+}
+
+
+//
+// G_GrowTables
+// Makes room for count things and numsectors sectors.
+//
+static void G_GrowTables (int count)
+{
+    if (count > maxthings)
+    {
+	maxthings = count*2;
+	refthings = realloc (refthings, maxthings * sizeof(*refthings));
+	curthings = realloc (curthings, maxthings * sizeof(*curthings));
+	if (!refthings || !curthings)
+	    I_Error ("G_GrowTables: out of memory");
+    }
+
+    if (numsectors > maxsectors)
+    {
+	maxsectors = numsectors;
+	refsectors = realloc (refsectors, maxsectors * sizeof(*refsectors));
+	cursectors = realloc (cursectors, maxsectors * sizeof(*cursectors));
+	if (!refsectors || !cursectors)
+	    I_Error ("G_GrowTables: out of memory");
+    }
+}
+
+
+static void G_GetSectors (void)
+{
+    sector_t*		sec;
+    sectorhash_t*	s;
+    int			i;
+
+    for (i=0, sec=sectors, s=cursectors ; i<numsectors ; i++, sec++, s++)
+    {
+	s->floorheight = sec->floorheight;
+	s->ceilingheight = sec->ceilingheight;
+	s->lightlevel = sec->lightlevel;
+	s->special = sec->special;
+    }
+}
+
+
+static boolean G_SectorChanged (int i)
+{
+    return i >= numrefsectors
+	|| memcmp (&cursectors[i], &refsectors[i], sizeof(sectorhash_t));
+}
+
+
+//
+// G_WriteTic
+//
+static void G_WriteTic (worldhash_t* wh)
+{
+    uint32_t	words[10];
+    uint32_t	thing[11];
+    uint32_t	sector[5];
+    thinghash_t* t;
+    sectorhash_t* s;
+    thinghash_t* swap;
+    int		changedthings;
+    int		changedsectors;
+    int		i;
+
+    changedthings = 0;
+    for (i=0 ; i<numcurthings ; i++)
+	if (i >= numrefthings || curthings[i].hash != refthings[i].hash)
+	    changedthings++;
+
+    changedsectors = 0;
+    for (i=0 ; i<numsectors ; i++)
+	if (G_SectorChanged (i))
+	    changedsectors++;
+
+    words[0] = hashtic;
+    words[1] = wh->world;
+    words[2] = wh->rng;
+    words[3] = wh->players;
+    words[4] = wh->sectors;
+    words[5] = wh->things;
+    words[6] = numcurthings;
+    words[7] = numsectors;
+    words[8] = changedthings;
+    words[9] = changedsectors;
+    G_WriteWords (words, 10);
+
+    for (i=0 ; i<numcurthings ; i++)
+    {
+	t = &curthings[i];
+	if (i < numrefthings && t->hash == refthings[i].hash)
+	    continue;
+
+	thing[0] = i;
+	thing[1] = t->type;
+	thing[2] = t->state;
+	thing[3] = t->x;
+	thing[4] = t->y;
+	thing[5] = t->z;
+	thing[6] = t->momx;
+	thing[7] = t->momy;
+	thing[8] = t->momz;
+	thing[9] = t->health;
+	thing[10] = t->hash;
+	G_WriteWords (thing, 11);
+    }
+
+    for (i=0 ; i<numsectors ; i++)
+    {
+	if (!G_SectorChanged (i))
+	    continue;
+
+	s = &cursectors[i];
+	sector[0] = i;
+	sector[1] = s->floorheight;
+	sector[2] = s->ceilingheight;
+	sector[3] = s->lightlevel;
+	sector[4] = s->special;
+	G_WriteWords (sector, 5);
+    }
+
+    // what was just written is what the next tic is compared to
+    swap = refthings;
+    refthings = curthings;
+    curthings = swap;
+    numrefthings = numcurthings;
+
+    s = refsectors;
+    refsectors = cursectors;
+    cursectors = s;
+    numrefsectors = numsectors;
+}
+
+
+//
+// G_ReadTic
+// Reads the next tic into wh and the reference tables.
+//
+static boolean G_ReadTic (worldhash_t* wh)
+{
+    uint32_t	words[10];
+    uint32_t	thing[11];
+    uint32_t	sector[5];
+    thinghash_t* t;
+    sectorhash_t* s;
+    int		i;
+
+    if (!G_ReadWords (words, 10))
+	return false;
+
+    if ((int)words[0] != hashtic)
+	I_Error ("G_ReadTic: %s has tic %i where %i was expected",
+		 hashname, words[0], hashtic);
+
+    wh->world = words[1];
+    wh->rng = words[2];
+    wh->players = words[3];
+    wh->sectors = words[4];
+    wh->things = words[5];
+    numrefthings = words[6];
+    numrefsectors = words[7];
+
+    G_GrowTables (numrefthings);
+
+    for (i=0 ; i<(int)words[8] ; i++)
+    {
+	if (!G_ReadWords (thing, 11) || thing[0] >= (uint32_t)maxthings)
+	    I_Error ("G_ReadTic: %s is damaged", hashname);
+
+	t = &refthings[thing[0]];
+	t->type = thing[1];
+	t->state = thing[2];
+	t->x = thing[3];
+	t->y = thing[4];
+	t->z = thing[5];
+	t->momx = thing[6];
+	t->momy = thing[7];
+	t->momz = thing[8];
+	t->health = thing[9];
+	t->hash = thing[10];
+    }
+
+    for (i=0 ; i<(int)words[9] ; i++)
+    {
+	if (!G_ReadWords (sector, 5) || sector[0] >= (uint32_t)maxsectors)
+	    I_Error ("G_ReadTic: %s is damaged", hashname);
+
+	s = &refsectors[sector[0]];
+	s->floorheight = sector[1];
+	s->ceilingheight = sector[2];
+	s->lightlevel = sector[3];
+	s->special = sector[4];
+    }
+
+    return true;
+}
+
+
+static void G_PrintThing (char* label, int i, thinghash_t* t)
+{
+    printf ("  thing %i %s: type %i state %i at (%.3f, %.3f, %.3f)"
+	    " mom (%.3f, %.3f, %.3f) health %i hash %08x\n",
+	    i, label, t->type, t->state,
+	    t->x / (double)FRACUNIT, t->y / (double)FRACUNIT,
+	    t->z / (double)FRACUNIT, t->momx / (double)FRACUNIT,
+	    t->momy / (double)FRACUNIT, t->momz / (double)FRACUNIT,
+	    t->health, t->hash);
+}
+
+
+static void G_PrintSector (char* label, int i, sectorhash_t* s)
+{
+    printf ("  sector %i %s: floor %.3f ceiling %.3f light %i special %i\n",
+	    i, label,
+	    s->floorheight / (double)FRACUNIT,
+	    s->ceilingheight / (double)FRACUNIT,
+	    s->lightlevel, s->special);
+}
+
+
+//
+// G_ReportDesync
+// Lists what differs between the file and the world.
+//
+static void G_ReportDesync (worldhash_t* ref, worldhash_t* cur)
+{
+    int		count;
+    int		reported;
+    int		i;
+
+    printf ("%s: DESYNC at tic %i, leveltime %i\n",
+	    hashname, hashtic, leveltime);
+
+    if (ref->rng != cur->rng)
+	printf ("  rng index: expected %i got %i\n", ref->rng, cur->rng);
+    if (ref->players != cur->players)
+	printf ("  player state differs\n");
+
+    if (numrefthings != numcurthings)
+	printf ("  things: expected %i got %i\n", numrefthings, numcurthings);
+
+    count = numrefthings > numcurthings ? numrefthings : numcurthings;
+    reported = 0;
+    for (i=0 ; i<count ; i++)
+    {
+	if (i < numrefthings && i < numcurthings
+	    && refthings[i].hash == curthings[i].hash)
+	    continue;
+
+	if (reported++ == MAXREPORTED)
+	{
+	    printf ("  ...\n");
+	    break;
+	}
+
+	if (i < numrefthings)
+	    G_PrintThing ("expected", i, &refthings[i]);
+	else
+	    printf ("  thing %i expected: none\n", i);
+
+	if (i < numcurthings)
+	    G_PrintThing ("     got", i, &curthings[i]);
+	else
+	    printf ("  thing %i      got: none\n", i);
+    }
+
+    for (i=0 ; i<numsectors && i<numrefsectors ; i++)
+    {
+	if (!G_SectorChanged (i))
+	    continue;
+
+	G_PrintSector ("expected", i, &refsectors[i]);
+	G_PrintSector ("     got", i, &cursectors[i]);
+    }
+}
+
+
+//
+// G_TicHash
+//
+void G_TicHash (void)
+{
+    worldhash_t	cur;
+    worldhash_t	ref;
+
+    if (!hashfile)
+	return;
+
+    numcurthings = P_HashWorldParts (&cur, curthings, maxthings);
+    if (numcurthings > maxthings)
+    {
+	G_GrowTables (numcurthings);
+	P_HashWorldParts (&cur, curthings, maxthings);
+    }
+    G_GrowTables (0);
+    G_GetSectors ();
+
+    if (!checking)
+    {
+	G_WriteTic (&cur);
+	hashtic++;
+	return;
+    }
+
+    if (!G_ReadTic (&ref))
+    {
+	printf ("%s: ends at tic %i, not checking further\n",
+		hashname, hashtic);
+	G_TicHashStop ();
+	return;
+    }
+
+    if (ref.world == cur.world)
+    {
+	hashtic++;
+	return;
+    }
+
+    G_ReportDesync (&ref, &cur);
+    G_TicHashStop ();
+    tichashdesync = true;
+
+    if (verifyingdemos)
+    {
+	// the verifier reports it
+	G_CheckDemoStatus ();
+	return;
+    }
+
+    I_Error ("G_TicHash: demo desynced at tic %i", hashtic);
+}
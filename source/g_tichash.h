@@ -0,0 +1,46 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//	Per tic world hashes of demos.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __G_TICHASH__
+#define __G_TICHASH__
+
+#include "doomtype.h"
+
+// Set when the demo being checked has desynced.
+extern boolean	tichashdesync;
+
+// Called when a demo starts recording or playing, with the name
+// of the demo; the side file is the name with .hsh for .lmp.
+void G_TicHashStart (char* name);
+void G_TicHashStop (void);
+
+// Called by G_Ticker after every tic of a demo.
+void G_TicHash (void);
+
+// The side file name of a demo, <name>.<ext> without any .lmp.
+void G_DemoSideFile (char* name, char* ext, char* dest, int size);
+
+#endif
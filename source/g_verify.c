@@ -0,0 +1,345 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//	Batch demo verification.
+//
+//	-verifydemos <dir or demo> ... runs each demo through G_Ticker
+//	alone, as fast as it goes: nothing is drawn, mixed or sent.
+//	Directories are searched for .lmp files. At every level exit
+//	and at the end of the demo the world is hashed with
+//	P_HashWorld, giving lines like
+//
+//	    exit E1M1 3171 1a2b3c4d
+//	    end 5040 5e6f7a8b
+//
+//	-verifyrecord writes them next to each demo as <demo>.chk.
+//	Without it they are compared against that file, and the
+//	first line that differs is reported as a desync. The per
+//	tic side files of -hashrecord and -hashcheck work here too,
+//	and stop a demo at the first tic that differs.
+//
+//	-jobs <n> splits the demos over n processes where the
+//	platform can fork. The exit status is nonzero if any demo
+//	failed.
+//
+//-----------------------------------------------------------------------------
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "z_zone.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "g_game.h"
+#include "p_hash.h"
+#include "g_tichash.h"
+
+#include "g_verify.h"
+
+
+boolean		verifyingdemos;
+
+static boolean	verifyrecord;
+
+// Checksum lines of the demo being verified.
+#define MAXVERIFYTEXT	8192
+
+static char	verifytext[MAXVERIFYTEXT];
+static int	verifylen;
+
+
+static void G_AddVerifyLine (char* fmt, ...)
+{
+    va_list	argptr;
+
+    va_start (argptr, fmt);
+    verifylen += vsnprintf (verifytext + verifylen,
+			    MAXVERIFYTEXT - verifylen, fmt, argptr);
+    va_end (argptr);
+
+    if (verifylen >= MAXVERIFYTEXT)
+	verifylen = MAXVERIFYTEXT-1;
+}
+
+
+//
+// G_VerifyLevelExit
+//
+void G_VerifyLevelExit (void)
+{
+    if (gamemode == commercial)
+	G_AddVerifyLine ("exit MAP%02i %i %08x\n",
+			 gamemap, leveltime, P_HashWorld ());
+    else
+	G_AddVerifyLine ("exit E%iM%i %i %08x\n",
+			 gameepisode, gamemap, leveltime, P_HashWorld ());
+}
+
+
+//
+// G_CompareVerifyText
+// Returns the first line of the reference that differs
+// from verifytext, NULL if they match.
+//
+static char* G_CompareVerifyText (char* ref, char* got, int gotsize)
+{
+    char*	line;
+    char*	end;
+    int		len;
+
+    line = ref;
+    while (*line)
+    {
+	end = strchr (line, '\n');
+	len = end ? end - line + 1 : strlen (line);
+
+	if (len > gotsize || strncmp (line, got, len))
+	    return line;
+
+	got += len;
+	gotsize -= len;
+	line += len;
+    }
+
+    return gotsize ? got : NULL;
+}
+
+
+//
+// G_CheckVerifyText
+// Records or checks the lines of one demo.
+//
+static boolean G_CheckVerifyText (char* path)
+{
+    char	chkname[256];
+    byte*	buf;
+    char*	ref;
+    char*	diff;
+    char*	end;
+    int		length;
+    FILE*	f;
+
+    G_DemoSideFile (path, "chk", chkname, sizeof(chkname));
+
+    if (verifyrecord)
+    {
+	if (!M_WriteFile (chkname, verifytext, verifylen))
+	{
+	    printf ("%s: can't write %s\n", path, chkname);
+	    return false;
+	}
+	printf ("%s: recorded\n", path);
+	return true;
+    }
+
+    f = fopen (chkname, "rb");
+    if (!f)
+    {
+	printf ("%s: no reference\n", path);
+	return true;
+    }
+    fclose (f);
+
+    length = M_ReadFile (chkname, &buf);
+    ref = Z_Malloc (length+1, PU_STATIC, NULL);
+    memcpy (ref, buf, length);
+    ref[length] = 0;
+    Z_Free (buf);
+
+    diff = G_CompareVerifyText (ref, verifytext, verifylen);
+    if (!diff)
+    {
+	Z_Free (ref);
+	printf ("%s: ok\n", path);
+	return true;
+    }
+
+    // report the line that differs, or the extra one we got
+    if (diff >= ref && diff < ref+length)
+    {
+	end = strchr (diff, '\n');
+	printf ("%s: DESYNC, expected %.*s\n", path,
+		end ? (int)(end - diff) : (int)strlen (diff), diff);
+
+	// what we got in its place
+	if (diff - ref < verifylen)
+	    diff = verifytext + (diff - ref);
+	else
+	    diff = "nothing\n";
+    }
+    else
+	printf ("%s: DESYNC, nothing expected\n", path);
+
+    printf ("%*s  got %s", (int)strlen (path), "", diff);
+
+    Z_Free (ref);
+    return false;
+}
+
+
+//
+// G_VerifyDemo
+// Plays one demo through G_Ticker alone.
+//
+static boolean G_VerifyDemo (char* path, int* tics)
+{
+    byte*	buffer;
+    int		length;
+    int		starttic;
+
+    *tics = 0;
+    length = M_ReadFile (path, &buffer);
+    length = G_UnpackDemo (&buffer, length);
+    if (length < 14 || buffer[0] != VERSION)
+    {
+	printf ("%s: not a version %i demo\n", path, VERSION);
+	Z_Free (buffer);
+	return false;
+    }
+
+    verifylen = 0;
+    verifytext[0] = 0;
+
+    gameaction = ga_nothing;
+    paused = false;
+    starttic = gametic;
+
+    G_PlayDemoBuffer (buffer);
+    G_TicHashStart (path);
+
+    // every tic uses at least four bytes of the demo,
+    // so this only stops demos with no end marker
+    while (demoplayback && gametic - starttic < length)
+    {
+	G_Ticker ();
+	gametic++;
+    }
+
+    Z_Free (buffer);
+    *tics = gametic - starttic;
+
+    if (tichashdesync)
+	return false;
+
+    if (demoplayback)
+    {
+	demoplayback = false;
+	printf ("%s: no end of demo marker\n", path);
+	return false;
+    }
+
+    G_AddVerifyLine ("end %i %08x\n", *tics, P_HashWorld ());
+
+    return G_CheckVerifyText (path);
+}
+
+
+//
+// G_VerifyDemos
+//
+void G_VerifyDemos (void)
+{
+    char**	paths;
+    char**	list;
+    int		numpaths;
+    int		maxpaths;
+    int		count;
+    int		jobs;
+    int		job;
+    int		failed;
+    int		verified;
+    int		tics;
+    int		totaltics;
+    int64_t	starttime;
+    double	seconds;
+    int		p;
+    int		i;
+
+    p = M_CheckParm ("-verifydemos");
+    if (!p)
+	return;
+
+    // the parms after p are demos or directories of them,
+    // until end of parms or another - preceded parm
+    paths = NULL;
+    numpaths = maxpaths = 0;
+    while (++p != myargc && myargv[p][0] != '-')
+    {
+	count = I_ListFiles (myargv[p], ".lmp", &list);
+	if (count < 0)
+	{
+	    count = 1;
+	    list = &myargv[p];
+	}
+
+	if (numpaths + count > maxpaths)
+	{
+	    maxpaths = (numpaths + count) * 2;
+	    paths = realloc (paths, maxpaths * sizeof(*paths));
+	    if (!paths)
+		I_Error ("G_VerifyDemos: out of memory");
+	}
+
+	memcpy (paths + numpaths, list, count * sizeof(*paths));
+	numpaths += count;
+    }
+
+    if (!numpaths)
+	I_Error ("G_VerifyDemos: no demos given to -verifydemos");
+
+    jobs = 1;
+    p = M_CheckParm ("-jobs");
+    if (p && p < myargc-1)
+	jobs = atoi (myargv[p+1]);
+    if (jobs > numpaths)
+	jobs = numpaths;
+
+    verifyrecord = M_CheckParm ("-verifyrecord");
+    verifyingdemos = true;
+
+    job = I_ForkJobs (&jobs);
+
+    failed = verified = totaltics = 0;
+    starttime = I_GetTimeUS ();
+
+    for (i=job ; i<numpaths ; i+=jobs)
+    {
+	if (!G_VerifyDemo (paths[i], &tics))
+	    failed++;
+	verified++;
+	totaltics += tics;
+	fflush (stdout);
+    }
+
+    seconds = (I_GetTimeUS () - starttime) / 1000000.0;
+
+    printf ("G_VerifyDemos: %i demos, %i failed, %i tics in %.2f s (%.0f tics/s)\n",
+	    verified, failed, totaltics, seconds,
+	    seconds > 0 ? totaltics / seconds : 0.0);
+
+    exit (failed ? 1 : 0);
+}
@@ -0,0 +1,42 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//	Batch demo verification.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __G_VERIFY__
+#define __G_VERIFY__
+
+#include "doomtype.h"
+
+// True while -verifydemos is running.
+extern boolean	verifyingdemos;
+
+// Checks for -verifydemos and, if given, verifies the demos
+// and exits. Returns if not given.
+void G_VerifyDemos (void);
+
+// Called by G_DoCompleted.
+void G_VerifyLevelExit (void);
+
+#endif
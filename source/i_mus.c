@@ -0,0 +1,597 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//	MUS song renderer, for the music cache.
+//
+//	A small two operator FM synthesiser, one voice per note. It is
+//	not an OPL emulation and does not read GENMIDI: each General
+//	MIDI family gets a fixed modulator ratio, depth and envelope,
+//	and percussion is made of swept tones and noise. It only runs
+//	when a song is first played, so it favours being short over
+//	being fast.
+//
+//-----------------------------------------------------------------------------
+
+#include <math.h>
+#include <string.h>
+
+#include "doomtype.h"
+#include "i_mus.h"
+
+
+#define MUSTICRATE	140		// MUS delays are in 1/140 s
+#define MUSCHANNELS	16
+#define PERCUSSION	15		// the MUS percussion channel
+#define MAXVOICES	32
+#define OUTFRAMES	512
+
+#define MAXSONGSECONDS	(20*60)		// stops a song that never ends
+#define TAILSECONDS	2		// for the last notes to die away
+
+#ifndef M_PI
+#define M_PI		3.14159265358979323846
+#endif
+
+#define SINEBITS	10
+#define SINESIZE	(1<<SINEBITS)
+#define SINESHIFT	(32-SINEBITS)
+
+// Phase units for one radian of modulation per full scale sine.
+#define MODRADIAN	(4294967296.0 / (2*M_PI) / 32768)
+
+typedef struct
+{
+    int		ratio;		// modulator frequency, in half carriers
+    int		depth;		// modulation, in eighths of a radian
+    int		attack;		// ms to full level
+    int		decay;		// ms to fall 60dB towards sustain
+    int		sustain;	// in sixteenths of full level
+    int		release;	// ms to fall 60dB after note off
+} timbre_t;
+
+// One for each General MIDI family of eight programs.
+static const timbre_t timbres[16] =
+{
+    { 2, 12,   2, 600,  4, 200 },	// piano
+    { 7, 10,   1, 400,  0, 200 },	// chromatic percussion
+    { 2,  6,  10, 100, 14,  60 },	// organ
+    { 2, 14,   2, 500,  3, 150 },	// guitar
+    { 2, 10,   3, 300,  8,  80 },	// bass
+    { 2,  5,  60, 300, 12, 250 },	// strings
+    { 2,  5,  50, 300, 12, 250 },	// ensemble
+    { 2, 16,  30, 200, 11, 120 },	// brass
+    { 4, 10,  20, 200, 12, 100 },	// reed
+    { 2,  3,  30, 200, 13, 120 },	// pipe
+    { 2, 18,   5, 200, 11, 100 },	// synth lead
+    { 2,  6, 120, 500, 12, 400 },	// synth pad
+    { 3, 12,  40, 500,  8, 300 },	// synth effects
+    { 6, 10,   2, 400,  4, 200 },	// ethnic
+    { 5, 12,   1, 250,  0, 150 },	// percussive
+    { 9, 20,   5, 300,  6, 200 }	// sound effects
+};
+
+typedef struct
+{
+    int		program;
+    int		volume;		// 0-127
+    int		pan;		// 0 left, 64 centre, 127 right
+    int		bend;		// 0-255, 128 centre
+    int		velocity;	// of the last note with one
+} muschannel_t;
+
+typedef struct
+{
+    boolean	active;
+    boolean	released;
+    int		channel;
+    int		note;
+    int		velocity;
+    int		age;
+
+    unsigned	phase;
+    unsigned	step;
+    unsigned	modphase;
+    unsigned	modstep;
+    int		modindex;
+
+    boolean	noise;
+    unsigned	seed;
+    float	sweep;		// step multiplier a frame, drums only
+    float	fstep;
+
+    float	env;
+    float	attackstep;
+    float	decaymul;
+    float	sustain;
+    float	releasemul;
+
+    float	left;
+    float	right;
+} musvoice_t;
+
+static int16_t		sinetable[SINESIZE];
+
+static int		musrate;
+static muschannel_t	channels[MUSCHANNELS];
+static musvoice_t	voices[MAXVOICES];
+static int		voiceage;
+
+static int16_t		outbuf[OUTFRAMES*2];
+static int		outcount;
+static musout_t		outfunc;
+static void*		outarg;
+static boolean		outstopped;
+
+
+//
+// I_DecayFactor
+// Per frame factor that falls 60dB over ms.
+//
+static float I_DecayFactor (int ms)
+{
+    if (ms <= 0)
+	return 0;
+
+    return exp (log (0.001) / (ms * musrate / 1000.0));
+}
+
+
+static unsigned I_NoteStep (int note, int bend)
+{
+    double	freq;
+
+    freq = 440.0 * pow (2.0, (note - 69 + (bend-128)/64.0) / 12.0);
+    return (unsigned)(freq * 4294967296.0 / musrate);
+}
+
+
+//
+// I_VoiceGains
+// Channel volume and pan, with the note velocity.
+//
+static void I_VoiceGains (musvoice_t* v)
+{
+    muschannel_t*	ch;
+    float		vol;
+
+    ch = &channels[v->channel];
+    vol = v->velocity * ch->volume / (127.0f*127.0f);
+    v->left = vol * (ch->pan < 64 ? 64 : 127-ch->pan) / 64.0f;
+    v->right = vol * (ch->pan > 64 ? 64 : ch->pan) / 64.0f;
+}
+
+
+//
+// I_AllocVoice
+// A free voice, or the quietest released one, or the oldest.
+//
+static musvoice_t* I_AllocVoice (void)
+{
+    musvoice_t*	v;
+    musvoice_t*	best;
+    int		i;
+
+    best = NULL;
+    for (i=0, v=voices ; i<MAXVOICES ; i++, v++)
+    {
+	if (!v->active)
+	    return v;
+
+	if (v->released)
+	{
+	    if (!best || !best->released || v->env < best->env)
+		best = v;
+	}
+	else if (!best || (!best->released && v->age < best->age))
+	    best = v;
+    }
+
+    return best;
+}
+
+
+//
+// I_StartDrum
+// Percussion notes are tones swept down or noise bursts.
+//
+static void I_StartDrum (musvoice_t* v, int note)
+{
+    int		decay;
+
+    v->noise = true;
+    v->sweep = 1;
+
+    switch (note)
+    {
+      case 35: case 36:			// bass drums
+	v->noise = false;
+	v->fstep = 150.0f * 4294967296.0f / musrate;
+	v->sweep = I_DecayFactor (900);
+	decay = 200;
+	break;
+
+      case 41: case 43: case 45:	// toms
+      case 47: case 48: case 50:
+	v->noise = false;
+	v->fstep = (80 + (note-41)*15) * 4294967296.0f / musrate;
+	v->sweep = I_DecayFactor (2000);
+	decay = 300;
+	break;
+
+      case 42: case 44:			// closed hi-hats
+	decay = 50;
+	break;
+
+      case 46:				// open hi-hat
+	decay = 250;
+	break;
+
+      case 49: case 52: case 55: case 57:	// crashes
+	decay = 900;
+	break;
+
+      case 51: case 53: case 59:	// rides
+	decay = 450;
+	break;
+
+      default:
+	decay = 150;
+	break;
+    }
+
+    v->step = (unsigned)v->fstep;
+    v->modindex = 0;
+    v->env = 1;
+    v->attackstep = 0;
+    v->sustain = 0;
+    v->decaymul = I_DecayFactor (decay);
+    v->releasemul = v->decaymul;
+}
+
+
+static void I_NoteOn (int channel, int note, int velocity)
+{
+    musvoice_t*		v;
+    const timbre_t*	t;
+    muschannel_t*	ch;
+
+    ch = &channels[channel];
+    v = I_AllocVoice ();
+    memset (v, 0, sizeof(*v));
+
+    v->active = true;
+    v->channel = channel;
+    v->note = note;
+    v->velocity = velocity;
+    v->age = voiceage++;
+    v->seed = 0x1234567 + note;
+
+    if (channel == PERCUSSION)
+	I_StartDrum (v, note);
+    else
+    {
+	t = &timbres[(ch->program >> 3) & 15];
+	v->step = I_NoteStep (note, ch->bend);
+	v->modstep = v->step / 2 * t->ratio;
+	v->modindex = t->depth * MODRADIAN / 8;
+	v->sweep = 1;
+	v->attackstep = t->attack > 0 ? 1000.0f / (t->attack * musrate) : 1;
+	v->decaymul = I_DecayFactor (t->decay);
+	v->sustain = t->sustain / 16.0f;
+	v->releasemul = I_DecayFactor (t->release);
+    }
+
+    I_VoiceGains (v);
+}
+
+
+static void I_NoteOff (int channel, int note)
+{
+    musvoice_t*	v;
+    int		i;
+
+    // drums die away by themselves
+    if (channel == PERCUSSION)
+	return;
+
+    for (i=0, v=voices ; i<MAXVOICES ; i++, v++)
+	if (v->active && !v->released && v->channel == channel
+	    && v->note == note)
+	    v->released = true;
+}
+
+
+//
+// I_UpdateChannel
+// Volume, pan and pitch bend apply to the notes already playing.
+//
+static void I_UpdateChannel (int channel)
+{
+    musvoice_t*	v;
+    int		i;
+
+    for (i=0, v=voices ; i<MAXVOICES ; i++, v++)
+    {
+	if (!v->active || v->channel != channel)
+	    continue;
+
+	I_VoiceGains (v);
+	if (channel != PERCUSSION)
+	{
+	    v->step = I_NoteStep (v->note, channels[channel].bend);
+	    v->modstep = v->step / 2 * timbres[(channels[channel].program>>3)
+					       & 15].ratio;
+	}
+    }
+}
+
+
+//
+// I_RenderFrames
+//
+static void I_RenderFrames (int count)
+{
+    musvoice_t*	v;
+    float	left;
+    float	right;
+    float	s;
+    int		mod;
+    int		i;
+    int		out;
+
+    while (count-- && !outstopped)
+    {
+	left = right = 0;
+
+	for (i=0, v=voices ; i<MAXVOICES ; i++, v++)
+	{
+	    if (!v->active)
+		continue;
+
+	    if (v->noise)
+	    {
+		v->seed = v->seed*1103515245 + 12345;
+		s = (int16_t)(v->seed >> 16);
+	    }
+	    else
+	    {
+		mod = sinetable[v->modphase >> SINESHIFT] * v->modindex;
+		s = sinetable[(v->phase + mod) >> SINESHIFT];
+		v->phase += v->step;
+		v->modphase += v->modstep;
+		if (v->sweep != 1)
+		{
+		    v->fstep *= v->sweep;
+		    v->step = (unsigned)v->fstep;
+		}
+	    }
+
+	    s *= v->env;
+	    left += s * v->left;
+	    right += s * v->right;
+
+	    // envelope
+	    if (v->released)
+		v->env *= v->releasemul;
+	    else if (v->attackstep)
+	    {
+		v->env += v->attackstep;
+		if (v->env >= 1)
+		{
+		    v->env = 1;
+		    v->attackstep = 0;
+		}
+	    }
+	    else
+		v->env = v->sustain + (v->env - v->sustain) * v->decaymul;
+
+	    if (v->env < 0.0005f && !v->attackstep
+		&& (v->released || v->sustain == 0))
+		v->active = false;
+	}
+
+	// a few loud voices at once before it clips
+	for (i=0 ; i<2 ; i++)
+	{
+	    out = (i ? right : left) * 0.3f;
+	    if (out > 32767)
+		out = 32767;
+	    else if (out < -32768)
+		out = -32768;
+	    outbuf[outcount*2+i] = out;
+	}
+
+	if (++outcount == OUTFRAMES)
+	{
+	    if (!outfunc (outbuf, outcount, outarg))
+		outstopped = true;
+	    outcount = 0;
+	}
+    }
+}
+
+
+static boolean I_VoicesActive (void)
+{
+    int		i;
+
+    for (i=0 ; i<MAXVOICES ; i++)
+	if (voices[i].active)
+	    return true;
+
+    return false;
+}
+
+
+//
+// I_RenderMus
+//
+int I_RenderMus (byte* data, int rate, musout_t out, void* arg)
+{
+    byte*	p;
+    byte*	end;
+    int		scorelen;
+    int		scorestart;
+    int		event;
+    int		channel;
+    int		b;
+    int		delay;
+    int		frames;
+    int		tics;
+    int		maxtics;
+    long long	remainder;
+    int		i;
+    boolean	done;
+
+    if (memcmp (data, "MUS\x1a", 4))
+	return 0;
+
+    scorelen = data[4] | (data[5]<<8);
+    scorestart = data[6] | (data[7]<<8);
+
+    musrate = rate;
+    outfunc = out;
+    outarg = arg;
+    outcount = 0;
+    outstopped = false;
+    voiceage = 0;
+    memset (voices, 0, sizeof(voices));
+
+    for (i=0 ; i<SINESIZE ; i++)
+	sinetable[i] = 32767 * sin (2*M_PI*i/SINESIZE);
+
+    for (i=0 ; i<MUSCHANNELS ; i++)
+    {
+	channels[i].program = 0;
+	channels[i].volume = 100;
+	channels[i].pan = 64;
+	channels[i].bend = 128;
+	channels[i].velocity = 127;
+    }
+
+    p = data + scorestart;
+    end = p + scorelen;
+    frames = 0;
+    tics = 0;
+    maxtics = MAXSONGSECONDS * MUSTICRATE;
+    remainder = 0;
+    done = false;
+
+    // each byte read is checked against the end of the score
+#define NEXTBYTE(b)	if (p >= end) { done = true; break; } b = *p++
+
+    while (!done && !outstopped && tics < maxtics)
+    {
+	NEXTBYTE (event);
+	channel = event & 15;
+
+	switch ((event >> 4) & 7)
+	{
+	  case 0:	// release note
+	    NEXTBYTE (b);
+	    I_NoteOff (channel, b & 127);
+	    break;
+
+	  case 1:	// play note
+	    NEXTBYTE (b);
+	    if (b & 128)
+	    {
+		NEXTBYTE (channels[channel].velocity);
+		channels[channel].velocity &= 127;
+	    }
+	    I_NoteOn (channel, b & 127, channels[channel].velocity);
+	    break;
+
+	  case 2:	// pitch bend
+	    NEXTBYTE (channels[channel].bend);
+	    I_UpdateChannel (channel);
+	    break;
+
+	  case 3:	// system event
+	    NEXTBYTE (b);
+	    if (b == 10 || b == 11)	// all sounds / notes off
+		for (i=0 ; i<MAXVOICES ; i++)
+		    if (voices[i].channel == channel)
+		    {
+			voices[i].released = true;
+			if (b == 10)
+			    voices[i].active = false;
+		    }
+	    break;
+
+	  case 4:	// controller
+	    NEXTBYTE (b);
+	    NEXTBYTE (i);
+	    if (b == 0)
+		channels[channel].program = i & 127;
+	    else if (b == 3)
+		channels[channel].volume = i & 127;
+	    else if (b == 4)
+		channels[channel].pan = i & 127;
+	    I_UpdateChannel (channel);
+	    break;
+
+	  case 5:	// end of measure
+	    break;
+
+	  case 6:	// score end
+	    done = true;
+	    break;
+
+	  default:
+	    break;
+	}
+
+	if (done || !(event & 128))
+	    continue;
+
+	delay = 0;
+	do
+	{
+	    NEXTBYTE (b);
+	    delay = (delay << 7) | (b & 127);
+	} while (b & 128 && delay < maxtics);
+
+	// frames for the delay, keeping the fractions
+	tics += delay;
+	remainder += (long long)delay * rate;
+	I_RenderFrames (remainder / MUSTICRATE);
+	frames += remainder / MUSTICRATE;
+	remainder %= MUSTICRATE;
+    }
+#undef NEXTBYTE
+
+    // let the last notes ring out, but not forever
+    for (i=0 ; i<MAXVOICES ; i++)
+	voices[i].released = true;
+    for (i=0 ; i<TAILSECONDS*rate/OUTFRAMES && I_VoicesActive ()
+	     && !outstopped ; i++)
+    {
+	I_RenderFrames (OUTFRAMES);
+	frames += OUTFRAMES;
+    }
+
+    if (outcount && !outstopped && !outfunc (outbuf, outcount, outarg))
+	outstopped = true;
+    outcount = 0;
+
+    return outstopped ? 0 : frames;
+}
@@ -0,0 +1,42 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//	MUS song renderer, for the music cache.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __I_MUS__
+#define __I_MUS__
+
+#include "doomtype.h"
+
+// Takes count interleaved 16 bit stereo frames of the song.
+// Returns false to stop the rendering there.
+typedef boolean (*musout_t) (int16_t* frames, int count, void* arg);
+
+// Renders one pass of the MUS lump at data at rate frames a
+// second, handing the frames to out as they are made. Returns
+// the number of frames, 0 if data is not a MUS lump or out
+// stopped the rendering.
+int I_RenderMus (byte* data, int rate, musout_t out, void* arg);
+
+#endif
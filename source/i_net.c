@@ -1,4 +1,4 @@
-// Emacs style mode select   -*- C++ -*- 
+// Emacs style mode select   -*- C++ -*-
 //-----------------------------------------------------------------------------
 //
 // Copyright (C) 1993-1996 by id Software, Inc.
@@ -19,12 +19,45 @@
 // 02111-1307, USA.
 //
 // DESCRIPTION:
+//	UDP network driver for d_net.c.
+//
+//	-net <player> <node> ... joins a game of the nodes given plus
+//	this one. Player is 1-4, one per node, and nodes are
+//	host[:port]. -port sets the port this node listens and sends
+//	on, DOOMPORT by default, so several nodes can run on one
+//	machine:
+//
+//	    ps3doom -net 1 127.0.0.1:5030 -port 5029
+//	    ps3doom -net 2 127.0.0.1:5029 -port 5030
+//
+//	-dup and -extratic set ticdup and extratics as in the original
+//	drivers. -netdrop <percent> throws away that share of the
+//	packets sent, to exercise the retransmits.
+//
+//	The socket never blocks. Where recvmmsg is available, packets
+//	are read a batch at a time and handed out one per CMD_GET.
 //
 //-----------------------------------------------------------------------------
 
+#ifdef __linux__
+#define _GNU_SOURCE		// recvmmsg
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+
+#ifndef HEADLESS
+#include <net/net.h>
+#endif
 
 #include "i_system.h"
 #include "d_event.h"
@@ -33,38 +66,340 @@
 #include "doomstat.h"
 #include "i_net.h"
 
-void NetSend (void);
-boolean NetListen (void);
+
+#define DOOMPORT	5029
+
+// Packets read at once.
+#define NETBATCH	16
+
+static int			netsocket = -1;
+static struct sockaddr_in	sendaddress[MAXNETNODES];
+
+static int			droppercent;
+
+// Packets read but not yet handed to d_net.c.
+static doomdata_t		recvbuf[NETBATCH];
+static struct sockaddr_in	recvaddress[NETBATCH];
+static int			recvlength[NETBATCH];
+static int			recvcount;
+static int			recvnext;
 
 
 //
 // NETWORKING
 //
 
+//
+// I_SwapPacket
+// Packets go out in network byte order.
+//
+static void I_SwapPacket (doomdata_t* dest, doomdata_t* src, int tosend)
+{
+    int		numtics;
+    int		c;
+
+    // the tic count is only in host order on one side
+    numtics = tosend ? src->numtics : dest->numtics;
+
+    for (c=0 ; c<numtics ; c++)
+    {
+	dest->cmds[c].forwardmove = src->cmds[c].forwardmove;
+	dest->cmds[c].sidemove = src->cmds[c].sidemove;
+	dest->cmds[c].angleturn = tosend ? htons (src->cmds[c].angleturn)
+	    : ntohs (src->cmds[c].angleturn);
+	dest->cmds[c].consistancy = tosend ? htons (src->cmds[c].consistancy)
+	    : ntohs (src->cmds[c].consistancy);
+	dest->cmds[c].chatchar = src->cmds[c].chatchar;
+	dest->cmds[c].buttons = src->cmds[c].buttons;
+    }
+}
+
+
+//
+// PacketSend
+//
+static void PacketSend (void)
+{
+    doomdata_t	sw;
+    int		node;
+
+    node = doomcom->remotenode;
+    if (node < 1 || node >= doomcom->numnodes)
+	I_Error ("PacketSend: bad node %i", node);
+
+    if (droppercent && rand () % 100 < droppercent)
+	return;
+
+    sw.checksum = htonl (netbuffer->checksum);
+    sw.retransmitfrom = netbuffer->retransmitfrom;
+    sw.starttic = netbuffer->starttic;
+    sw.player = netbuffer->player;
+    sw.numtics = netbuffer->numtics;
+    I_SwapPacket (&sw, netbuffer, true);
+
+    // a full socket buffer loses the packet,
+    // which the retransmits recover from
+    sendto (netsocket, &sw, doomcom->datalength, MSG_DONTWAIT,
+	    (struct sockaddr *)&sendaddress[node], sizeof(sendaddress[node]));
+}
+
+
+//
+// I_ReceiveBatch
+// Reads the packets waiting, up to NETBATCH of them.
+//
+#ifdef __linux__
+static void I_ReceiveBatch (void)
+{
+    struct mmsghdr	msgs[NETBATCH];
+    struct iovec	iov[NETBATCH];
+    int			count;
+    int			i;
+
+    memset (msgs, 0, sizeof(msgs));
+    for (i=0 ; i<NETBATCH ; i++)
+    {
+	iov[i].iov_base = &recvbuf[i];
+	iov[i].iov_len = sizeof(recvbuf[i]);
+	msgs[i].msg_hdr.msg_iov = &iov[i];
+	msgs[i].msg_hdr.msg_iovlen = 1;
+	msgs[i].msg_hdr.msg_name = &recvaddress[i];
+	msgs[i].msg_hdr.msg_namelen = sizeof(recvaddress[i]);
+    }
+
+    count = recvmmsg (netsocket, msgs, NETBATCH, MSG_DONTWAIT, NULL);
+    if (count < 0)
+	count = 0;
+
+    for (i=0 ; i<count ; i++)
+	recvlength[i] = msgs[i].msg_len;
+
+    recvcount = count;
+    recvnext = 0;
+}
+#else
+static void I_ReceiveBatch (void)
+{
+    socklen_t	fromlen;
+    int		c;
+
+    recvcount = recvnext = 0;
+
+    while (recvcount < NETBATCH)
+    {
+	fromlen = sizeof(recvaddress[recvcount]);
+	c = recvfrom (netsocket, &recvbuf[recvcount], sizeof(recvbuf[0]),
+		      MSG_DONTWAIT,
+		      (struct sockaddr *)&recvaddress[recvcount], &fromlen);
+	if (c < 0)
+	    break;
+	recvlength[recvcount++] = c;
+    }
+}
+#endif
+
+
+//
+// PacketGet
+//
+static void PacketGet (void)
+{
+    doomdata_t*		sw;
+    struct sockaddr_in*	from;
+    int			i;
+
+    if (recvnext == recvcount)
+	I_ReceiveBatch ();
+
+    if (recvnext == recvcount)
+    {
+	doomcom->remotenode = -1;		// no packet
+	return;
+    }
+
+    sw = &recvbuf[recvnext];
+    from = &recvaddress[recvnext];
+    doomcom->datalength = recvlength[recvnext];
+    recvnext++;
+
+    // find the remote node number
+    for (i=1 ; i<doomcom->numnodes ; i++)
+	if (from->sin_addr.s_addr == sendaddress[i].sin_addr.s_addr
+	    && from->sin_port == sendaddress[i].sin_port)
+	    break;
+
+    if (i == doomcom->numnodes)
+    {
+	// packet is not from one of the players
+	doomcom->remotenode = -1;
+	return;
+    }
+
+    // too short to hold its tics
+    if (doomcom->datalength < (int)((byte *)&sw->cmds[0] - (byte *)sw)
+	|| sw->numtics > BACKUPTICS)
+    {
+	doomcom->remotenode = -1;
+	return;
+    }
+
+    doomcom->remotenode = i;
+
+    netbuffer->checksum = ntohl (sw->checksum);
+    netbuffer->retransmitfrom = sw->retransmitfrom;
+    netbuffer->starttic = sw->starttic;
+    netbuffer->player = sw->player;
+    netbuffer->numtics = sw->numtics;
+    I_SwapPacket (netbuffer, sw, false);
+}
+
+
+//
+// I_NodeAddress
+// Fills in the address of a host[:port] node.
+//
+static void I_NodeAddress (struct sockaddr_in* address, char* name)
+{
+    char		host[256];
+    char*		colon;
+    struct hostent*	hostentry;
+    int			port;
+
+    strncpy (host, name, sizeof(host)-1);
+    host[sizeof(host)-1] = 0;
+
+    port = DOOMPORT;
+    colon = strchr (host, ':');
+    if (colon)
+    {
+	*colon = 0;
+	port = atoi (colon+1);
+    }
+
+    memset (address, 0, sizeof(*address));
+    address->sin_family = AF_INET;
+    address->sin_port = htons (port);
+    address->sin_addr.s_addr = inet_addr (host);
+
+    if (address->sin_addr.s_addr == INADDR_NONE)
+    {
+	hostentry = gethostbyname (host);
+	if (!hostentry)
+	    I_Error ("I_NodeAddress: couldn't find %s", host);
+	memcpy (&address->sin_addr, hostentry->h_addr_list[0],
+		sizeof(address->sin_addr));
+    }
+}
+
+
 //
 // I_InitNetwork
 //
 void I_InitNetwork (void)
 {
+    struct sockaddr_in	address;
+    int			port;
+    int			i;
+    int			p;
+
     doomcom = malloc (sizeof (*doomcom) );
     memset (doomcom, 0, sizeof(*doomcom) );
-    
-	// make it a regular single player game
 
-	doomcom->ticdup = 1;
+    // set up for network
+    i = M_CheckParm ("-dup");
+    if (i && i< myargc-1)
+    {
+	doomcom->ticdup = myargv[i+1][0]-'0';
+	if (doomcom->ticdup < 1)
+	    doomcom->ticdup = 1;
+	if (doomcom->ticdup > 9)
+	    doomcom->ticdup = 9;
+    }
+    else
+	doomcom-> ticdup = 1;
+
+    if (M_CheckParm ("-extratic"))
+	doomcom-> extratics = 1;
+    else
 	doomcom-> extratics = 0;
 
+    p = M_CheckParm ("-port");
+    if (p && p<myargc-1)
+	port = atoi (myargv[p+1]);
+    else
+	port = DOOMPORT;
+
+    p = M_CheckParm ("-netdrop");
+    if (p && p<myargc-1)
+	droppercent = atoi (myargv[p+1]);
+
+    doomcom->id = DOOMCOM_ID;
+
+    // parse network game options,
+    //  -net <consoleplayer> <host> <host> ...
+    i = M_CheckParm ("-net");
+    if (!i || i >= myargc-1)
+    {
+	// single player game
 	netgame = false;
-	doomcom->id = DOOMCOM_ID;
 	doomcom->numplayers = doomcom->numnodes = 1;
 	doomcom->deathmatch = false;
 	doomcom->consoleplayer = 0;
-
 	return;
+    }
+
+    netgame = true;
+
+    // parse player number and host list
+    doomcom->consoleplayer = myargv[i+1][0]-'1';
+    if (doomcom->consoleplayer < 0 || doomcom->consoleplayer >= MAXPLAYERS)
+	I_Error ("I_InitNetwork: player must be 1-%i", MAXPLAYERS);
+
+    doomcom->numnodes = 1;	// this node for sure
+
+    i++;
+    while (++i < myargc && myargv[i][0] != '-')
+    {
+	if (doomcom->numnodes == MAXPLAYERS)
+	    I_Error ("I_InitNetwork: more than %i nodes", MAXPLAYERS);
+	I_NodeAddress (&sendaddress[doomcom->numnodes], myargv[i]);
+	doomcom->numnodes++;
+    }
+
+    doomcom->numplayers = doomcom->numnodes;
+
+#ifndef HEADLESS
+    if (netInitialize () < 0)
+	I_Error ("I_InitNetwork: netInitialize failed");
+#endif
+
+    // build message socket
+    netsocket = socket (AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (netsocket < 0)
+	I_Error ("I_InitNetwork: can't create socket: %s", strerror (errno));
+
+    memset (&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons (port);
+    if (bind (netsocket, (struct sockaddr *)&address, sizeof(address)) == -1)
+	I_Error ("I_InitNetwork: can't bind port %i: %s", port, strerror (errno));
+
+    printf ("I_InitNetwork: player %i, %i nodes, port %i\n",
+	    doomcom->consoleplayer+1, doomcom->numnodes, port);
 }
 
 
 void I_NetCmd (void)
 {
-    return;
+    if (doomcom->command == CMD_SEND)
+    {
+	PacketSend ();
+    }
+    else if (doomcom->command == CMD_GET)
+    {
+	PacketGet ();
+    }
+    else
+	I_Error ("Bad net cmd: %i\n",doomcom->command);
 }
@@ -0,0 +1,214 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//	Offline sound outputs: null and WAV file.
+//
+//	Neither runs in real time. Audio is clocked by gametic, so
+//	each tic accounts for exactly SAMPLERATE/TICRATE frames and
+//	the same demo always mixes the same blocks at the same tics.
+//	With -timedemo (one tic per frame) the WAV output of a demo
+//	is byte for byte reproducible.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "m_argv.h"
+#include "m_swap.h"
+#include "i_system.h"
+#include "i_sound.h"
+
+
+// Frames mixed so far, and the tic the clock started at.
+static long long	clockframes;
+static int		clockbase;
+static int		clockblocks;
+
+static FILE*		wavfile;
+
+
+static void I_StartSoundClock (void)
+{
+    clockframes = 0;
+    clockbase = gametic;
+    clockblocks = 0;
+}
+
+
+//
+// I_ClockedBlocksDue
+// Whole blocks the tics since the clock started account for.
+//
+static int I_ClockedBlocksDue (void)
+{
+    long long	due;
+
+    due = ((long long)(gametic - clockbase) * SAMPLERATE) / TICRATE;
+
+    return (int)((due - clockframes) / SAMPLECOUNT);
+}
+
+
+//
+// NULL OUTPUT
+// Mixes and throws the result away, for timing the mixer.
+//
+static boolean I_InitNullSound (void)
+{
+    I_StartSoundClock ();
+    return true;
+}
+
+static void I_ShutdownNullSound (void)
+{
+    printf ("I_ShutdownSound: mixed %i blocks.\n", clockblocks);
+}
+
+static void I_SubmitNullSound (void)
+{
+    int		blocks;
+
+    for (blocks = I_ClockedBlocksDue () ; blocks > 0 ; blocks--)
+    {
+	I_UpdateSound ();
+	clockframes += SAMPLECOUNT;
+	clockblocks++;
+    }
+}
+
+sndsink_t null_sndsink =
+{
+    "null",
+    I_InitNullSound,
+    I_ShutdownNullSound,
+    I_SubmitNullSound,
+    NULL,
+    NULL
+};
+
+
+//
+// WAV OUTPUT
+// 16 bit stereo PCM. The RIFF sizes are patched in on shutdown.
+//
+static void I_WriteWAVLong (int value)
+{
+    byte	b[4];
+
+    b[0] = value;
+    b[1] = value >> 8;
+    b[2] = value >> 16;
+    b[3] = value >> 24;
+    fwrite (b, 1, 4, wavfile);
+}
+
+static void I_WriteWAVShort (int value)
+{
+    byte	b[2];
+
+    b[0] = value;
+    b[1] = value >> 8;
+    fwrite (b, 1, 2, wavfile);
+}
+
+static boolean I_InitWAVSound (void)
+{
+    int		p;
+
+    p = M_CheckParm ("-wavout");
+    if (!p || p >= myargc-1)
+	return false;
+
+    wavfile = fopen (myargv[p+1], "wb");
+    if (!wavfile)
+	return false;
+
+    fwrite ("RIFF", 1, 4, wavfile);
+    I_WriteWAVLong (0);			// patched on shutdown
+    fwrite ("WAVEfmt ", 1, 8, wavfile);
+    I_WriteWAVLong (16);
+    I_WriteWAVShort (1);		// PCM
+    I_WriteWAVShort (2);		// stereo
+    I_WriteWAVLong (SAMPLERATE);
+    I_WriteWAVLong (SAMPLERATE*4);	// bytes per second
+    I_WriteWAVShort (4);		// bytes per frame
+    I_WriteWAVShort (16);		// bits per sample
+    fwrite ("data", 1, 4, wavfile);
+    I_WriteWAVLong (0);			// patched on shutdown
+
+    printf ("I_InitSound: recording sound to %s\n", myargv[p+1]);
+
+    I_StartSoundClock ();
+    return true;
+}
+
+static void I_ShutdownWAVSound (void)
+{
+    int		datasize;
+
+    if (!wavfile)
+	return;
+
+    datasize = (int)(clockframes * 4);
+
+    fseek (wavfile, 4, SEEK_SET);
+    I_WriteWAVLong (datasize + 36);
+    fseek (wavfile, 40, SEEK_SET);
+    I_WriteWAVLong (datasize);
+
+    fclose (wavfile);
+    wavfile = NULL;
+
+    printf ("I_ShutdownSound: wrote %i blocks.\n", clockblocks);
+}
+
+static void I_SubmitWAVSound (void)
+{
+    int16_t	out[SAMPLECOUNT*2];
+    int		blocks;
+    int		i;
+
+    for (blocks = I_ClockedBlocksDue () ; blocks > 0 ; blocks--)
+    {
+	I_UpdateSound ();
+
+	for (i=0 ; i<SAMPLECOUNT*2 ; i++)
+	    out[i] = SHORT(mixbuffer[i]);
+
+	fwrite (out, sizeof(int16_t), SAMPLECOUNT*2, wavfile);
+	clockframes += SAMPLECOUNT;
+	clockblocks++;
+    }
+}
+
+sndsink_t wav_sndsink =
+{
+    "WAV file",
+    I_InitWAVSound,
+    I_ShutdownWAVSound,
+    I_SubmitWAVSound,
+    NULL,
+    NULL
+};
@@ -20,41 +20,40 @@
 // 02111-1307, USA.
 //
 // DESCRIPTION:
-//       PS3 interface for sound.
+//       Sound effect mixer and music streaming. The mixed blocks
+//       are handed to one of the sinks in i_sndout.c/ps3_audio.c.
 //
 //-----------------------------------------------------------------------------
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
 #include <math.h>
-#include <assert.h>
-#include <malloc.h>
-
-#include <audio/audio.h>
-#include <psl1ght/lv2/timer.h>
-#include <sys/thread.h>
-#include <psl1ght/lv2/thread.h>
 
 #include "z_zone.h"
 #include "i_system.h"
 #include "i_sound.h"
 #include "m_argv.h"
 #include "m_misc.h"
+#include "m_prof.h"
 #include "w_wad.h"
 #include "doomdef.h"
 #include "m_swap.h"
+#include "i_mus.h"
 
 
-#define SAMPLECOUNT		256
+// Voices tracked at once, and how many of those are mixed. The
+// least audible voices beyond NUM_CHANNELS are virtual: they keep
+// their play position but cost nothing until they become audible
+// enough to be mixed again.
+#define NUM_VOICES		64
 #define NUM_CHANNELS		32
 #define BUFMUL                  4
 #define MIXBUFFERSIZE		(SAMPLECOUNT*BUFMUL)
 
-static sys_lwmutex_t chanmutex;
-static sys_lwmutex_attribute_t MutexAttrs;
-
-static sys_ppu_thread_t mixthread;
-static char *mixthread_name = "PS3DOOM Sound FX mixer";
+// Where the mixed blocks go.
+static sndsink_t*	sndsink;
 
 // The actual lengths of all sound effects.
 int 		lengths[NUMSFX];
@@ -70,15 +69,44 @@ typedef struct
     byte *snd_start_ptr, *snd_end_ptr;
     unsigned int starttic;
     int sfxid;
-    int *leftvol, *rightvol;
     int handle;
+    int priority;
+
+    // Volumes (0-127) in effect at the start of the next block,
+    // and the ones to reach by its end. The mixer fades between
+    // the two, so parameter updates never step mid-sound.
+    int leftvol, rightvol;
+    int lefttarget, righttarget;
+
+    boolean virtual;
+
+    // Lost its channel: mixed for one more block, fading to
+    // silence, and virtual after that.
+    boolean fading;
 } channel_t;
 
-static channel_t channels[NUM_CHANNELS];
+static channel_t channels[NUM_VOICES];
 
 int		vol_lookup[128*256];
 
-static AudioPortConfig ps3_audio_port_cfg;
+static void I_MixMusic (int* left, int* right, int count);
+
+
+//
+// The channels are shared with the sink's mixing thread, if it
+// has one. Clocked sinks mix on the game thread and need no lock.
+//
+static void I_LockSound (void)
+{
+    if (sndsink && sndsink->lock)
+	sndsink->lock ();
+}
+
+static void I_UnlockSound (void)
+{
+    if (sndsink && sndsink->unlock)
+	sndsink->unlock ();
+}
 
 
 static void I_SndMixResetChannel (int channum)
@@ -128,7 +156,7 @@ static void* I_SndLoadSample (char* sfxname, int* len)
     memcpy (&orig_rate, sfxlump_data+2, 2);
     orig_rate = SHORT (orig_rate);
     
-    times = 48000.0f / (float)orig_rate;
+    times = (float)SAMPLERATE / (float)orig_rate;
     
     padded_sfx_len = ((sfxlump_len*ceil(times) + (SAMPLECOUNT-1)) / SAMPLECOUNT) * SAMPLECOUNT;
     padded_sfx_data = (byte*)malloc(padded_sfx_len);
@@ -169,7 +197,7 @@ void I_SetChannels()
     int i, j;
   
     // Okay, reset internal mixing channels to zero.
-    for (i=0; i<NUM_CHANNELS; i++)
+    for (i=0; i<NUM_VOICES; i++)
         I_SndMixResetChannel(i);
 
     // Generates volume lookup tables which also turn the unsigned
@@ -212,22 +240,123 @@ void I_StopSound (int handle)
 {
     int i;
     
-    sys_lwmutex_lock (&chanmutex, 0);
+    I_LockSound ();
 
-    for (i=0; i<NUM_CHANNELS; i++)
+    for (i=0; i<NUM_VOICES; i++)
     {
         if (channels[i].handle==handle)
         {
             I_SndMixResetChannel(i);
-            sys_lwmutex_unlock (&chanmutex);
+            I_UnlockSound ();
             return;
         }
     }
     
-    sys_lwmutex_unlock (&chanmutex);
+    I_UnlockSound ();
     return;
 }
 
+//
+// I_SndSeparation
+// Per left/right channel, x^2 separation, adjust volume properly.
+//
+static void I_SndSeparation (int vol, int sep, int* leftvol, int* rightvol)
+{
+    sep += 1;
+
+    *leftvol = vol - ((vol*sep*sep) >> 16); ///(256*256);
+    sep -= 257;
+    *rightvol = vol - ((vol*sep*sep) >> 16);	
+
+    // Sanity check, clamp volume.
+    if (*rightvol < 0 || *rightvol > 127)
+	I_Error("I_SndSeparation: rightvol out of bounds");
+    
+    if (*leftvol < 0 || *leftvol > 127)
+	I_Error("I_SndSeparation: leftvol out of bounds");
+}
+
+
+//
+// I_SndAudibility
+// How much a voice deserves to be mixed: its loudness, weighted by
+//  the sfx priority (lower priority numbers are more important).
+//
+static int I_SndAudibility (channel_t* c)
+{
+    return (c->lefttarget + c->righttarget) * (256 - c->priority);
+}
+
+
+//
+// I_SndOutranks
+// True if voice a should be mixed before voice b. Ties go to the
+//  newer sound, then to the lower slot.
+//
+static boolean I_SndOutranks (int a, int b, int* audibility)
+{
+    if (audibility[a] != audibility[b])
+	return audibility[a] > audibility[b];
+
+    if (channels[a].starttic != channels[b].starttic)
+	return channels[a].starttic > channels[b].starttic;
+
+    return a < b;
+}
+
+
+//
+// I_SndAssignVoices
+// Called at the start of every block with the channels locked.
+// The NUM_CHANNELS most audible voices are mixed, the rest are
+//  virtual. Silent voices are never mixed. A voice that was being
+//  mixed fades out over the block before it goes virtual.
+//
+static void I_SndAssignVoices (void)
+{
+    int		i, j;
+    int		audibility[NUM_VOICES];
+    int		louder;
+    channel_t*	c;
+
+    for (i=0 ; i<NUM_VOICES ; i++)
+    {
+	c = &channels[i];
+	audibility[i] = c->snd_start_ptr ? I_SndAudibility (c) : 0;
+    }
+
+    for (i=0 ; i<NUM_VOICES ; i++)
+    {
+	c = &channels[i];
+
+	louder = NUM_CHANNELS;
+	if (audibility[i])
+	{
+	    louder = 0;
+	    for (j=0 ; j<NUM_VOICES && louder < NUM_CHANNELS ; j++)
+	    {
+		if (j != i && audibility[j]
+		    && I_SndOutranks (j, i, audibility))
+		    louder++;
+	    }
+	}
+
+	if (louder < NUM_CHANNELS)
+	{
+	    // Coming back from virtual: fade in from silence.
+	    if (c->virtual)
+		c->leftvol = c->rightvol = 0;
+	    c->virtual = false;
+	    c->fading = false;
+	}
+	else if (c->snd_start_ptr && !c->virtual)
+	    c->fading = true;
+	else
+	    c->virtual = true;
+    }
+}
+
+
 //
 // Starting a sound means adding it
 //  to the current list of active sounds
@@ -235,8 +364,8 @@ void I_StopSound (int handle)
 // As the SFX info struct contains
 //  e.g. a pointer to the raw data,
 //  it is ignored.
-// As our sound handling does not handle
-//  priority, it is ignored.
+// When all voices are in use, the least audible one is replaced,
+//  unless the new sound would be the least audible itself.
 // Pitching (that is, increased speed of playback)
 //  is set, but currently not used by mixing.
 //
@@ -245,24 +374,48 @@ int I_StartSound (int id, int vol, int sep, int pitch, int priority)
 {
     int	i;
     
-    int	oldestslot, oldesttics;
+    int	weakestslot, weakest;
     int	slot;
+    int	audibility;
 
-    int	rightvol;
-    int	leftvol;
+    channel_t	newchan;
 
     // this effect was not loaded.
     if (!S_sfx[id].data)
         return -1;
 
-    sys_lwmutex_lock (&chanmutex, 0);
+    memset (&newchan, 0, sizeof(newchan));
+
+    newchan.handle = ++currenthandle;
+    
+    // Set pointers to raw sound data start & end.
+    newchan.snd_start_ptr = (byte *)S_sfx[id].data;
+    newchan.snd_end_ptr = newchan.snd_start_ptr + lengths[id];
+
+    // Save starting gametic.
+    newchan.starttic = gametic;
+
+    I_SndSeparation (vol, sep, &newchan.lefttarget, &newchan.righttarget);
+
+    // A new sound starts at its volume right away.
+    newchan.leftvol = newchan.lefttarget;
+    newchan.rightvol = newchan.righttarget;
+    newchan.priority = priority;
+
+    // Preserve sound SFX id,
+    //  e.g. for avoiding duplicates of chainsaw.
+    newchan.sfxid = id;
+
+    audibility = I_SndAudibility (&newchan);
+
+    I_LockSound ();
 
     // Loop all channels to find a free slot.
     slot = -1;
-    oldesttics = gametic;
-    oldestslot = 0;
+    weakest = audibility;
+    weakestslot = -1;
 
-    for (i=0; i<NUM_CHANNELS; i++)
+    for (i=0; i<NUM_VOICES; i++)
     {
 	if (!channels[i].snd_start_ptr)  // not playing
         {
@@ -270,54 +423,23 @@ int I_StartSound (int id, int vol, int sep, int pitch, int priority)
             break;
         }
         
-        if (channels[i].starttic < oldesttics)
+        if (I_SndAudibility (&channels[i]) <= weakest)
         {
-            oldesttics = channels[i].starttic;
-            oldestslot = i;
+            weakest = I_SndAudibility (&channels[i]);
+            weakestslot = i;
         }
     }
     
-    // No free slots, so replace the oldest sound still playing.
+    // No free slots, so replace the least audible sound.
     if (slot == -1)
-        slot = oldestslot;
-    
-    channels[slot].handle = ++currenthandle;
-    
-    // Set pointers to raw sound data start & end.
-    channels[slot].snd_start_ptr = (byte *)S_sfx[id].data;
-    channels[slot].snd_end_ptr = channels[slot].snd_start_ptr + lengths[id];
-
-    // Save starting gametic.
-    channels[slot].starttic = gametic;
-
-    sep += 1;
-
-    // Per left/right channel.
-    //  x^2 seperation,
-    //  adjust volume properly.
-    leftvol = vol - ((vol*sep*sep) >> 16); ///(256*256);
-    sep -= 257;
-    rightvol = vol - ((vol*sep*sep) >> 16);	
-
-    // Sanity check, clamp volume.
-    if (rightvol < 0 || rightvol > 127)
-	I_Error("addsfx: rightvol out of bounds");
-    
-    if (leftvol < 0 || leftvol > 127)
-	I_Error("addsfx: leftvol out of bounds");
-    
-    // Get the proper lookup table piece
-    //  for this volume level???
-    channels[slot].leftvol = &vol_lookup[leftvol*256];
-    channels[slot].rightvol = &vol_lookup[rightvol*256];
+        slot = weakestslot;
 
-    // Preserve sound SFX id,
-    //  e.g. for avoiding duplicates of chainsaw.
-    channels[slot].sfxid = id;
+    if (slot != -1)
+        channels[slot] = newchan;
 
-    sys_lwmutex_unlock (&chanmutex);
+    I_UnlockSound ();
 
-    return currenthandle;
+    return slot != -1 ? newchan.handle : -1;
 }
 
 
@@ -325,18 +447,18 @@ int I_SoundIsPlaying (int handle)
 {
     int i;
     
-    sys_lwmutex_lock (&chanmutex, 0);
+    I_LockSound ();
 
-    for (i=0; i<NUM_CHANNELS; i++)
+    for (i=0; i<NUM_VOICES; i++)
     {
         if (channels[i].handle==handle)
         {
-            sys_lwmutex_unlock (&chanmutex);
+            I_UnlockSound ();
             return 1;
         }
     }
 
-    sys_lwmutex_unlock (&chanmutex);
+    I_UnlockSound ();
     return 0;
 }
 
@@ -358,211 +480,225 @@ int I_SoundIsPlaying (int handle)
 
 void I_UpdateSound(void)
 {
-    // Mix current sound data. Data, from raw sound, for right and left.
-    byte sample;
-    int dl, dr;
-
-    // Pointers in global mixbuffer, left, right, end.
-    int16_t *leftout, *rightout, *leftend;
-
-    // Step in mixbuffer, left and right, thus two.
-    int step;
-
-    // Mixing channel index.
-    int chan;
-
-    // Left and right channel are in global mixbuffer, alternating.
-    leftout = mixbuffer;
-    rightout = mixbuffer+1;
-    step = 2;
-
-    // Determine end, for left channel only (right channel is implicit).
-    leftend = mixbuffer + SAMPLECOUNT*step;
+    // Left and right accumulators, interleaved.
+    static int	mixacc[SAMPLECOUNT*2];
+    static int	musleft[SAMPLECOUNT];
+    static int	musright[SAMPLECOUNT];
+
+    channel_t*	c;
+    int*	lcur;
+    int*	rcur;
+    int*	ltgt;
+    int*	rtgt;
+    byte	sample;
+    int		count;
+    int		chan;
+    int		i;
+    int		d;
+    int64_t	mixstart = 0;
+
+    // May run on the mixer thread, so only the total is reported.
+    if (profiling)
+	mixstart = I_GetTimeUS ();
+
+    // Music for this block, already scaled by the music volume.
+    memset (musleft, 0, sizeof(musleft));
+    memset (musright, 0, sizeof(musright));
+    I_MixMusic (musleft, musright, SAMPLECOUNT);
+
+    for (i=0 ; i<SAMPLECOUNT ; i++)
+    {
+	mixacc[i*2] = musleft[i];
+	mixacc[i*2+1] = musright[i];
+    }
 
-    // Mix sounds into the mixing buffer.
-    // Loop over step*SAMPLECOUNT, that is 512 values for two channels.
+    I_SndAssignVoices ();
 
-    while (leftout <= leftend)
+    for (chan=0; chan<NUM_VOICES; chan++)
     {
-        // Reset left/right value.
-	dl = 0;
-	dr = 0;
+	c = &channels[chan];
+
+	// Check channel, if active.
+	if (!c->snd_start_ptr)
+	    continue;
 
+	count = c->snd_end_ptr - c->snd_start_ptr;
+	if (count > SAMPLECOUNT)
+	    count = SAMPLECOUNT;
 
-	for (chan=0; chan<NUM_CHANNELS; chan++)
+	if (c->virtual)
 	{
-            // Check channel, if active.
-            if (channels[chan].snd_start_ptr)
-            {
-                // Get the raw data from the channel. 
-                sample = *channels[chan].snd_start_ptr;
-                
-                // Add left and right part for this channel (sound) to the
-                // current data. Adjust volume accordingly.
-                dl += channels[chan].leftvol[sample];
-                dr += channels[chan].rightvol[sample];
-
-                channels[chan].snd_start_ptr++;
-
-                if (!(channels[chan].snd_start_ptr < channels[chan].snd_end_ptr))
-                    I_SndMixResetChannel (chan);
+	    // Keep time, but don't mix.
+	    c->snd_start_ptr += count;
+	}
+	else if (!c->fading
+		 && c->leftvol == c->lefttarget
+		 && c->rightvol == c->righttarget)
+	{
+	    lcur = &vol_lookup[c->leftvol*256];
+	    rcur = &vol_lookup[c->rightvol*256];
+
+	    for (i=0 ; i<count ; i++)
+	    {
+		// Get the raw data from the channel. 
+		sample = *c->snd_start_ptr++;
+
+		// Add left and right part for this channel (sound) to the
+		// current data. Adjust volume accordingly.
+		mixacc[i*2] += lcur[sample];
+		mixacc[i*2+1] += rcur[sample];
 	    }
 	}
-	
-	// Clamp to range. Left hardware channel.
-	// Has been char instead of short.
-	// if (dl > 127) *leftout = 127;
-	// else if (dl < -128) *leftout = -128;
-	// else *leftout = dl;
-
-	if (dl > 0x7fff)
-	    *leftout = 0x7fff;
-	else if (dl < -0x8000)
-	    *leftout = -0x8000;
 	else
-	    *leftout = dl;
-
-	// Same for right hardware channel.
-	if (dr > 0x7fff)
-	    *rightout = 0x7fff;
-	else if (dr < -0x8000)
-	    *rightout = -0x8000;
-	else
-	    *rightout = dr;
-
-	// Increment current pointers in mixbuffer.
-	leftout += step;
-	rightout += step;
-    }
-
-    return;
-}
-
-static uint32_t playOneBlock(u64 *readIndex, float *audioDataStart)
-{
-    static uint64_t audio_block_index=1;
-    uint64_t current_block = *readIndex;
-    float *buf;
-
-    if (audio_block_index == current_block)
-        return 0;
+	{
+	    // Fade linearly from the current to the target volume
+	    // over the block.
+	    lcur = &vol_lookup[c->leftvol*256];
+	    rcur = &vol_lookup[c->rightvol*256];
+	    if (c->fading)
+		ltgt = rtgt = &vol_lookup[0];
+	    else
+	    {
+		ltgt = &vol_lookup[c->lefttarget*256];
+		rtgt = &vol_lookup[c->righttarget*256];
+	    }
 
-    buf = audioDataStart + 2 /*channelcount*/ * AUDIO_BLOCK_SAMPLES * audio_block_index;
+	    for (i=0 ; i<count ; i++)
+	    {
+		sample = *c->snd_start_ptr++;
 
-    I_UpdateSound();
+		d = lcur[sample];
+		mixacc[i*2] += d + (ltgt[sample] - d) * i / SAMPLECOUNT;
+		d = rcur[sample];
+		mixacc[i*2+1] += d + (rtgt[sample] - d) * i / SAMPLECOUNT;
+	    }
 
-    for (int i = 0; i < SAMPLECOUNT*2; i++)
-        buf[i] = (float)mixbuffer[i]/32767.0f;
+	    c->leftvol = c->lefttarget;
+	    c->rightvol = c->righttarget;
 
-    audio_block_index = (audio_block_index + 1) % AUDIO_BLOCK_8;
+	    if (c->fading)
+	    {
+		c->virtual = true;
+		c->fading = false;
+	    }
+	}
 
-    return 1;
-}
+	if (!(c->snd_start_ptr < c->snd_end_ptr))
+	    I_SndMixResetChannel (chan);
+    }
 
-static void mix_thread_func (uint64_t arg)
-{
-    for (;;)
+    // Clamp to range.
+    for (i=0 ; i<SAMPLECOUNT*2 ; i++)
     {
-        sys_ppu_thread_yield();
-        usleep (20);
+	d = mixacc[i];
 
-        sys_lwmutex_lock (&chanmutex, 0);
+	if (d > 0x7fff)
+	    mixbuffer[i] = 0x7fff;
+	else if (d < -0x8000)
+	    mixbuffer[i] = -0x8000;
+	else
+	    mixbuffer[i] = d;
+    }
 
-        playOneBlock((u64*)(u64)ps3_audio_port_cfg.readIndex,
-                     (float*)(u64)ps3_audio_port_cfg.audioDataStart);
+    if (profiling)
+	M_ProfAddTime (pz_mixer, (int)(I_GetTimeUS () - mixstart));
 
-        sys_lwmutex_unlock (&chanmutex);
-    }
- 
-    sys_ppu_thread_exit(0);
     return;
 }
 
+//
+// I_UpdateSoundParams
+// Only sets the volumes to aim for. The mixer fades to them over
+//  the next block and re-ranks the voice against the others.
+//
 void I_UpdateSoundParams (int handle, int vol, int sep, int pitch)
 {
     int rightvol;
     int	leftvol;
     int i;
 
-    // sys_lwmutex_lock (&chanmutex, 0);
+    I_SndSeparation (vol, sep, &leftvol, &rightvol);
+
+    I_LockSound ();
     
-    for (i=0; i<NUM_CHANNELS; i++)
+    for (i=0; i<NUM_VOICES; i++)
     {
         if (channels[i].handle==handle)
         {
-            sep += 1;
-
-            leftvol = vol - ((vol*sep*sep) >> 16); ///(256*256);
-            sep -= 257;
-            rightvol = vol - ((vol*sep*sep) >> 16);	
-
-            if (rightvol < 0 || rightvol > 127)
-        	I_Error("I_UpdateSoundParams: rightvol out of bounds.");
-    
-            if (leftvol < 0 || leftvol > 127)
-	        I_Error("I_UpdateSoundParams: leftvol out of bounds.");
-
-            channels[i].leftvol = &vol_lookup[leftvol*256];
-            channels[i].rightvol = &vol_lookup[rightvol*256];
-
-            //sys_lwmutex_unlock (&chanmutex);
-            return;
+            channels[i].lefttarget = leftvol;
+            channels[i].righttarget = rightvol;
+            break;
         }
     }
  
-    //sys_lwmutex_unlock (&chanmutex);
+    I_UnlockSound ();
     return;
 }
 
 
 void I_ShutdownSound(void)
 {    
+    if (sndsink)
+    {
+	sndsink->shutdown ();
+	sndsink = NULL;
+    }
+
     return;
 }
 
 
+//
+// I_SubmitSound
+// Called once per frame, after the tics of the frame have run.
+// Clocked sinks mix whatever audio the elapsed tics account for.
+//
+void I_SubmitSound(void)
+{
+    if (sndsink && sndsink->submit)
+	sndsink->submit ();
+}
+
+
+//
+// I_InitSoundSink
+// -wavout <file> records to a WAV file and -nullsound mixes and
+// discards; both are clocked by the game tics. Otherwise the PS3
+// audio port is used, or the null output in the headless build.
+//
+#ifdef HEADLESS
+#define DEFAULT_SNDSINK		null_sndsink
+#else
+#define DEFAULT_SNDSINK		ps3_sndsink
+#endif
+
+static void I_InitSoundSink (void)
+{
+    int		p;
+
+    p = M_CheckParm ("-wavout");
+    if (p && p < myargc-1)
+	sndsink = &wav_sndsink;
+    else if (M_CheckParm ("-nullsound"))
+	sndsink = &null_sndsink;
+    else
+	sndsink = &DEFAULT_SNDSINK;
+
+    if (!sndsink->init ())
+    {
+	printf ("I_InitSound: %s output failed, using null output.\n",
+		sndsink->name);
+	sndsink = &null_sndsink;
+	sndsink->init ();
+    }
+
+    printf ("I_InitSound: sound output is %s.\n", sndsink->name);
+}
+
+
 void I_InitSound(void)
 {
     int i;
-    u64 thread_arg = 0x666;
-    u64 priority = 1500;
-    size_t stack_size = 0x10000;
-
-    AudioPortParam params;
-    uint32_t portNum;
-    int ret;
-    
-    // init PSL1GHT audio
-    ret = audioInit();
-    printf ("I_InitSound: audioInit returns %d.\n", ret);
-    
-    params.numChannels = AUDIO_PORT_2CH;        // stereo
-    params.numBlocks = AUDIO_BLOCK_8;
-    params.attr = 0;
-    params.level = 1.0f;
-    
-    ret = audioPortOpen (&params, &portNum);
-    printf ("I_InitSound: audioPortOpen returns %d.\n"\
-            "             Port number is %d.\n", ret, portNum);
-    
-    ret = audioGetPortConfig (portNum, &ps3_audio_port_cfg);
-    printf ("I_InitSound: audioGetPortConfig returns %d.\n"\
-            "              readIndex     : 0x%08x\n"\
-            "              status        : %d\n"\
-            "              channelCount  : %d\n"\
-            "              numBlocks     : %d\n"\
-            "              portSize      : %d\n"\
-            "              audioDataStart: 0x%08x\n",
-        ret,
-        ps3_audio_port_cfg.readIndex,
-        ps3_audio_port_cfg.status,
-        ps3_audio_port_cfg.channelCount,
-        ps3_audio_port_cfg.numBlocks,
-        ps3_audio_port_cfg.portSize,
-        ps3_audio_port_cfg.audioDataStart);
-    
-    ret = audioPortStart (portNum);
-    printf ("I_InitSound: audioPortStart returns %d.\n", ret);
 
     memset (&lengths, 0, sizeof(int)*NUMSFX);
     for (i=1 ; i<NUMSFX ; i++)
@@ -582,17 +718,9 @@ void I_InitSound(void)
     }
 
     I_SetChannels();
-  
-    memset (&MutexAttrs, 0, sizeof(sys_lwmutex_attribute_t));
-    MutexAttrs.attr_protocol = 2;          // PRIORITY
-    MutexAttrs.attr_recursive = 0x20;      // NOT RECURSIVE
-    if (sys_lwmutex_create (&chanmutex, &MutexAttrs) != 0)
-        I_Error ("I_InitSound: sys_lwmutex_create failed.\n");
-
-    ret = sys_ppu_thread_create(&mixthread, mix_thread_func, thread_arg, priority,
-           stack_size, THREAD_JOINABLE, mixthread_name);
-    
-    printf ("I_InitSound: sys_ppu_thread_create returned %d.\n", ret);
+
+    // The sink may start mixing right away.
+    I_InitSoundSink();
 
     return;
 }
@@ -602,61 +730,731 @@ void I_InitSound(void)
 
 //
 // MUSIC API.
-// Still no music done.
-// Remains. Dummies.
 //
-void I_InitMusic(void)		{ }
-void I_ShutdownMusic(void)	{ }
+// Music is not synthesised while playing, but streamed from a
+// cache on disk. Each MUS lump is identified by a hash of its
+// contents, and its rendering is looked up as
+// <musiccache>/<hash>.dmc. The first time a song is played it
+// is rendered by I_RenderMus and stored there, on a thread of its
+// own, and the song starts once the file is in place; after that
+// it only streams. Where the platform has no threads, rendering
+// stalls the game for a moment at the change of song instead.
+//
+// A .dmc file is a 16 byte header followed by IMA ADPCM blocks,
+// the last of which may be short:
+//
+//   char   magic[4]        "DMC1"
+//   int32  samplerate      little endian, e.g. 48000 or 22050
+//   int32  numframes       total stereo frames in the song
+//   int32  blockframes     frames per ADPCM block
+//
+// Every block starts with a 4 byte header per channel (int16
+// predictor, byte step index, pad byte), left then right, and is
+// followed by one byte per frame: left nibble in the low four bits,
+// right nibble in the high four bits. Since every block carries its
+// own predictor state, looping and rewinding never need to decode
+// from the start of the file.
+//
+// Decoding is done on the game thread by I_UpdateMusic, which
+// keeps a small read-ahead ring of output rate frames filled. The mixer
+// only copies from that ring, so music costs next to nothing while
+// mixing.
+//
 
-static int	looping=0;
-static int	musicdies=-1;
+#define MUSCACHE_MAGIC		"DMC1"
+#define MUSCACHE_HEADERSIZE	16
+#define MUSCACHE_MAXBLOCK	4096
+
+// What I_RenderMus is asked for: half the output rate, so the
+// nearest neighbour resampling doubles each frame exactly.
+#define MUSCACHE_RATE		(SAMPLERATE/2)
+#define MUSCACHE_BLOCK		1024
+
+// Read-ahead, in output frames. Must be a power of two.
+#define MUSRINGFRAMES		16384
+
+typedef struct
+{
+    FILE*	file;
+    int		samplerate;
+    int		numframes;
+    int		blockframes;
+
+    // Decoded source block and position in it, 16.16.
+    int16_t	block[MUSCACHE_MAXBLOCK*2];
+    int		blockcount;
+    int		blockstart;	// frames decoded before this block
+    unsigned	srcpos;
+    unsigned	srcstep;
+
+    boolean	looping;
+    boolean	playing;
+    boolean	paused;
+    boolean	finished;	// no more data to decode
+} musstream_t;
+
+static char*		musiccachedir;
+static unsigned		musichash;
+static int		musiclength;
+static byte*		musicdata;
+static boolean		musiccached;
+
+// A song being rendered into the cache by I_RenderSong. It gets a
+// copy of the lump, since the zone is not to be touched from
+// another thread and the lump may be purged meanwhile.
+typedef struct
+{
+    byte*	data;
+    unsigned	hash;
+    boolean	ok;
+} musrender_t;
+
+static musrender_t	musrender;
+static boolean		musrendering;
+static volatile boolean	musrenderstop;
+
+// The song I_PlaySong last asked for, until it is in the cache.
+static boolean		muswaiting;
+static unsigned		muswaithash;
+static boolean		muswaitlooping;
+
+static musstream_t	musstream;
+
+static int16_t		musring[MUSRINGFRAMES*2];
+static unsigned		musring_read;	// advanced by the mixer
+static unsigned		musring_write;	// advanced by I_UpdateMusic
+
+static const int adpcm_index_table[16] =
+{
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const int adpcm_step_table[89] =
+{
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+
+//
+// I_HashSong
+// FNV-1a over the whole MUS lump. The lump length is taken from
+// the MUS header, since only the data pointer is handed over.
+// Returns the length, 0 if data is not a MUS lump.
+//
+static int I_HashSong (byte* data, unsigned* hash)
+{
+    int		length;
+    int		i;
+    unsigned	h;
+
+    if (memcmp (data, "MUS\x1a", 4))
+	return 0;
+
+    length = (data[4] | (data[5]<<8)) + (data[6] | (data[7]<<8));
+
+    h = 2166136261u;
+    for (i=0 ; i<length ; i++)
+    {
+	h ^= data[i];
+	h *= 16777619u;
+    }
+
+    *hash = h;
+    return length;
+}
+
+
+//
+// I_DecodeADPCM
+// One nibble of one channel.
+//
+static int16_t I_DecodeADPCM (int nibble, int* predictor, int* index)
+{
+    int		step;
+    int		diff;
+
+    step = adpcm_step_table[*index];
+
+    diff = step >> 3;
+    if (nibble & 4)
+	diff += step;
+    if (nibble & 2)
+	diff += step >> 1;
+    if (nibble & 1)
+	diff += step >> 2;
+
+    if (nibble & 8)
+	*predictor -= diff;
+    else
+	*predictor += diff;
+
+    if (*predictor > 32767)
+	*predictor = 32767;
+    else if (*predictor < -32768)
+	*predictor = -32768;
+
+    *index += adpcm_index_table[nibble];
+    if (*index < 0)
+	*index = 0;
+    else if (*index > 88)
+	*index = 88;
+
+    return *predictor;
+}
+
+
+//
+// I_ReadSongBlock
+// Decodes the next ADPCM block of the stream. Rewinds on end of
+// song if looping. Returns 0 when there is nothing left to play.
+//
+static int I_ReadSongBlock (musstream_t* s)
+{
+    byte	raw[MUSCACHE_MAXBLOCK + 8];
+    int		pred[2];
+    int		index[2];
+    int		frames;
+    int		i;
+    int		c;
+
+    if (s->blockstart >= s->numframes)
+    {
+	if (!s->looping)
+	    return 0;
+
+	fseek (s->file, MUSCACHE_HEADERSIZE, SEEK_SET);
+	s->blockstart = 0;
+    }
+
+    frames = s->numframes - s->blockstart;
+    if (frames > s->blockframes)
+	frames = s->blockframes;
+
+    if (fread (raw, 1, 8 + frames, s->file) != (size_t)(8 + frames))
+    {
+	fprintf (stderr, "I_ReadSongBlock: truncated music cache file\n");
+	return 0;
+    }
+
+    for (c=0 ; c<2 ; c++)
+    {
+	pred[c] = (int16_t)(raw[c*4] | (raw[c*4+1]<<8));
+	index[c] = raw[c*4+2];
+	if (index[c] > 88)
+	    index[c] = 88;
+    }
+
+    for (i=0 ; i<frames ; i++)
+    {
+	s->block[i*2] = I_DecodeADPCM (raw[8+i] & 15, &pred[0], &index[0]);
+	s->block[i*2+1] = I_DecodeADPCM (raw[8+i] >> 4, &pred[1], &index[1]);
+    }
+
+    s->blockstart += frames;
+    s->blockcount = frames;
+    return 1;
+}
+
+
+//
+// I_EncodeADPCM
+// The nibble for sample, stepping the state the way the decoder
+// will.
+//
+static int I_EncodeADPCM (int sample, int* predictor, int* index)
+{
+    int		step;
+    int		diff;
+    int		nibble;
+
+    step = adpcm_step_table[*index];
+    diff = sample - *predictor;
+    nibble = 0;
+
+    if (diff < 0)
+    {
+	nibble = 8;
+	diff = -diff;
+    }
+    if (diff >= step)
+    {
+	nibble |= 4;
+	diff -= step;
+    }
+    if (diff >= step>>1)
+    {
+	nibble |= 2;
+	diff -= step>>1;
+    }
+    if (diff >= step>>2)
+	nibble |= 1;
+
+    I_DecodeADPCM (nibble, predictor, index);
+    return nibble;
+}
+
+
+// A .dmc file being written by I_WriteSongCache.
+typedef struct
+{
+    FILE*	file;
+    int16_t	block[MUSCACHE_BLOCK*2];
+    int		count;
+    int		pred[2];
+    int		index[2];
+    boolean	failed;
+} muswriter_t;
+
+
+//
+// I_WriteSongBlock
+// Encodes the frames gathered so far as one block.
+//
+static void I_WriteSongBlock (muswriter_t* w)
+{
+    byte	raw[8 + MUSCACHE_BLOCK];
+    int		c;
+    int		i;
+
+    for (c=0 ; c<2 ; c++)
+    {
+	raw[c*4] = w->pred[c] & 255;
+	raw[c*4+1] = (w->pred[c] >> 8) & 255;
+	raw[c*4+2] = w->index[c];
+	raw[c*4+3] = 0;
+    }
+
+    for (i=0 ; i<w->count ; i++)
+	raw[8+i] = I_EncodeADPCM (w->block[i*2], &w->pred[0], &w->index[0])
+	    | I_EncodeADPCM (w->block[i*2+1], &w->pred[1], &w->index[1]) << 4;
+
+    if (fwrite (raw, 1, 8 + w->count, w->file) != (size_t)(8 + w->count))
+	w->failed = true;
+    w->count = 0;
+}
+
+
+static boolean I_GatherSongFrames (int16_t* frames, int count, void* arg)
+{
+    muswriter_t*	w = arg;
+    int			n;
+
+    if (musrenderstop || w->failed)
+	return false;
+
+    while (count > 0)
+    {
+	n = MUSCACHE_BLOCK - w->count;
+	if (n > count)
+	    n = count;
+
+	memcpy (&w->block[w->count*2], frames, n*2*sizeof(*frames));
+	w->count += n;
+	frames += n*2;
+	count -= n;
+
+	if (w->count == MUSCACHE_BLOCK)
+	    I_WriteSongBlock (w);
+    }
+
+    return true;
+}
+
+
+static void I_PutLong (byte* p, int value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+
+//
+// I_WriteSongCache
+// Renders the MUS lump at data into the .dmc for hash, through a
+// temporary file that is only renamed into place when complete.
+//
+static boolean I_WriteSongCache (byte* data, unsigned hash)
+{
+    char		name[1024];
+    char		temp[1040];
+    byte		header[MUSCACHE_HEADERSIZE];
+    muswriter_t*	w;
+    int			frames;
+    boolean		ok;
+
+    snprintf (name, sizeof(name), "%s/%08x.dmc", musiccachedir, hash);
+    snprintf (temp, sizeof(temp), "%s.tmp", name);
+
+    w = malloc (sizeof(*w));
+    if (!w)
+	return false;
+    memset (w, 0, sizeof(*w));
+
+    w->file = fopen (temp, "wb");
+    if (!w->file)
+    {
+	fprintf (stderr, "I_WriteSongCache: can't create %s\n", temp);
+	free (w);
+	return false;
+    }
+
+    // the frame count is filled in once the song is rendered
+    memset (header, 0, sizeof(header));
+    memcpy (header, MUSCACHE_MAGIC, 4);
+    I_PutLong (header+4, MUSCACHE_RATE);
+    I_PutLong (header+12, MUSCACHE_BLOCK);
+    fwrite (header, 1, MUSCACHE_HEADERSIZE, w->file);
+
+    frames = I_RenderMus (data, MUSCACHE_RATE, I_GatherSongFrames, w);
+    if (w->count)
+	I_WriteSongBlock (w);
+
+    I_PutLong (header+8, frames);
+    ok = frames > 0 && !w->failed
+	&& !fseek (w->file, 0, SEEK_SET)
+	&& fwrite (header, 1, MUSCACHE_HEADERSIZE, w->file)
+	    == MUSCACHE_HEADERSIZE;
+    if (fclose (w->file))
+	ok = false;
+    free (w);
+
+    if (ok)
+	ok = !rename (temp, name);
+    if (!ok)
+    {
+	// a song with no notes has nothing to store
+	if (frames > 0)
+	    fprintf (stderr, "I_WriteSongCache: couldn't write %s\n", name);
+	remove (temp);
+	return false;
+    }
+
+    printf ("I_WriteSongCache: rendered %s, %i frames\n", name, frames);
+    return true;
+}
+
+
+//
+// I_RenderSong
+// The background job started by I_StartSongRender.
+//
+static void I_RenderSong (void* arg)
+{
+    musrender_t*	r = arg;
+
+    r->ok = I_WriteSongCache (r->data, r->hash);
+    free (r->data);
+    r->data = NULL;
+}
+
+
+//
+// I_StartSongRender
+// Renders the registered song into the cache in the background.
+//
+static void I_StartSongRender (void)
+{
+    musrender.data = malloc (musiclength);
+    if (!musrender.data)
+    {
+	muswaiting = false;
+	return;
+    }
+    memcpy (musrender.data, musicdata, musiclength);
+    musrender.hash = musichash;
+    musrender.ok = false;
+
+    musrendering = true;
+    I_StartWork (I_RenderSong, &musrender);
+}
+
+
+//
+// I_OpenSongCache
+//
+static boolean I_OpenSongCache (musstream_t* s, unsigned hash)
+{
+    char	name[1024];
+    byte	header[MUSCACHE_HEADERSIZE];
+    int		blockframes;
+    FILE*	f;
+
+    snprintf (name, sizeof(name), "%s/%08x.dmc", musiccachedir, hash);
+
+    f = fopen (name, "rb");
+    if (!f)
+	return false;
+
+    blockframes = 0;
+    if (fread (header, 1, MUSCACHE_HEADERSIZE, f) == MUSCACHE_HEADERSIZE
+	&& !memcmp (header, MUSCACHE_MAGIC, 4))
+    {
+	s->samplerate = LONG(*(int32_t *)(header+4));
+	s->numframes = LONG(*(int32_t *)(header+8));
+	blockframes = LONG(*(int32_t *)(header+12));
+    }
+
+    if (blockframes <= 0 || blockframes > MUSCACHE_MAXBLOCK
+	|| s->samplerate < 8000 || s->samplerate > SAMPLERATE
+	|| s->numframes <= 0)
+    {
+	fprintf (stderr, "I_OpenSongCache: %s is not a music cache file\n",
+		 name);
+	fclose (f);
+	return false;
+    }
+
+    s->file = f;
+    s->blockframes = blockframes;
+    s->srcstep = ((unsigned)s->samplerate << 16) / SAMPLERATE;
+
+    return true;
+}
+
+
+static void I_CloseSongCache (musstream_t* s)
+{
+    if (s->file)
+	fclose (s->file);
+
+    memset (s, 0, sizeof(*s));
+}
+
+
+static void I_StartCachedSong (int looping)
+{
+    musstream_t* s = &musstream;
+
+    s->looping = looping;
+
+    // Prime the read-ahead before the mixer sees the song.
+    s->playing = true;
+    I_UpdateMusic ();
+}
+
+
+//
+// I_FinishSongRender
+// Starts the song waited for if the render just finished was it,
+// or renders that one next if it was not.
+//
+static void I_FinishSongRender (void)
+{
+    I_WaitWork ();
+    musrendering = false;
+
+    if (!muswaiting)
+	return;
+
+    if (muswaithash != musrender.hash)
+    {
+	if (musiccached && musichash == muswaithash)
+	    I_StartSongRender ();
+	else
+	    muswaiting = false;
+	return;
+    }
+
+    muswaiting = false;
+    if (musrender.ok && I_OpenSongCache (&musstream, musrender.hash))
+	I_StartCachedSong (muswaitlooping);
+}
+
+
+//
+// I_UpdateMusic
+// Called once per frame from S_UpdateSounds. Decodes ahead of the
+// mixer into the music ring. Resampling to the 48kHz output rate
+// is nearest neighbour, as for the sound effects.
+//
+void I_UpdateMusic (void)
+{
+    unsigned	read;
+    unsigned	write;
+    int		space;
+    int16_t*	out;
+    musstream_t* s = &musstream;
+
+    if (musrendering && I_WorkDone ())
+	I_FinishSongRender ();
+
+    if (!s->playing || s->finished)
+	return;
+
+    I_LockSound ();
+    read = musring_read;
+    I_UnlockSound ();
+
+    write = musring_write;
+    space = MUSRINGFRAMES - (write - read);
+
+    // Only the frames between read and write are visible to the
+    // mixer, so the rest of the ring can be filled without locking.
+    while (space > 0)
+    {
+	if (!s->blockcount || (s->srcpos>>16) >= s->blockcount)
+	{
+	    if (s->blockcount)
+		s->srcpos -= s->blockcount<<16;
+
+	    if (!I_ReadSongBlock (s))
+	    {
+		s->finished = true;
+		break;
+	    }
+	}
+
+	out = &musring[(write & (MUSRINGFRAMES-1))*2];
+	out[0] = s->block[(s->srcpos>>16)*2];
+	out[1] = s->block[(s->srcpos>>16)*2+1];
+
+	s->srcpos += s->srcstep;
+	write++;
+	space--;
+    }
+
+    I_LockSound ();
+    musring_write = write;
+    I_UnlockSound ();
+}
+
+
+//
+// I_MixMusic
+// Called by the mixer with the channels locked. Adds up to count frames
+// of music to the left/right accumulators.
+//
+static void I_MixMusic (int* left, int* right, int count)
+{
+    int		i;
+    int		avail;
+    int16_t*	in;
+
+    if (!musstream.playing || musstream.paused || !snd_MusicVolume)
+	return;
+
+    avail = musring_write - musring_read;
+    if (count > avail)
+	count = avail;
+
+    for (i=0 ; i<count ; i++)
+    {
+	in = &musring[(musring_read & (MUSRINGFRAMES-1))*2];
+	left[i] += (in[0] * snd_MusicVolume) / 15;
+	right[i] += (in[1] * snd_MusicVolume) / 15;
+	musring_read++;
+    }
+}
+
+
+void I_InitMusic(void)
+{
+    int		p;
+
+    p = M_CheckParm ("-musiccache");
+    if (p && p < myargc-1)
+    {
+	musiccachedir = myargv[p+1];
+	printf ("I_InitMusic: using music cache in %s\n", musiccachedir);
+    }
+}
+
+void I_ShutdownMusic(void)
+{
+    I_StopSong (1);
+
+    // a song cut short leaves no file behind
+    musrenderstop = true;
+    if (musrendering)
+    {
+	I_WaitWork ();
+	musrendering = false;
+    }
+}
 
 void I_PlaySong(int handle, int looping)
 {
-  // UNUSED.
-  handle = looping = 0;
-  musicdies = gametic + TICRATE*30;
+    I_StopSong (handle);
+
+    if (!musiccached)
+	return;
+
+    if (I_OpenSongCache (&musstream, musichash))
+    {
+	I_StartCachedSong (looping);
+	return;
+    }
+
+    // The first time, the song is rendered into the cache, and
+    // I_UpdateMusic starts it once it is there.
+    muswaiting = true;
+    muswaithash = musichash;
+    muswaitlooping = looping;
+
+    if (!musrendering)
+	I_StartSongRender ();
 }
 
 void I_PauseSong (int handle)
 {
-  // UNUSED.
-  handle = 0;
+    musstream.paused = true;
 }
 
 void I_ResumeSong (int handle)
 {
-  // UNUSED.
-  handle = 0;
+    musstream.paused = false;
 }
 
 void I_StopSong(int handle)
 {
-  // UNUSED.
-  handle = 0;
-  
-  looping = 0;
-  musicdies = 0;
+    I_LockSound ();
+    musstream.playing = false;
+    musring_read = musring_write = 0;
+    I_UnlockSound ();
+
+    I_CloseSongCache (&musstream);
+    muswaiting = false;
 }
 
 void I_UnRegisterSong(int handle)
 {
-  // UNUSED.
-  handle = 0;
+    musiccached = false;
 }
 
 int I_RegisterSong(void* data)
 {
-  // UNUSED.
-  data = NULL;
-  
-  return 1;
+    musiccached = false;
+
+    if (musiccachedir)
+    {
+	musiclength = I_HashSong (data, &musichash);
+	musiccached = musiclength > 0;
+	musicdata = data;
+    }
+
+    return 1;
 }
 
 // Is the song playing?
 int I_QrySongPlaying(int handle)
 {
-  // UNUSED.
-  handle = 0;
-  return looping || musicdies > gametic;
+    int		playing;
+
+    I_LockSound ();
+    playing = musstream.playing
+	&& !(musstream.finished && musring_read == musring_write);
+    I_UnlockSound ();
+
+    return playing;
 }
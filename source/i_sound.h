@@ -33,10 +33,48 @@
 #include "sounds.h"
 
 
+// Output format of the mixer: 16 bit stereo, interleaved,
+//  SAMPLECOUNT frames per block.
+#define SAMPLERATE		48000
+#define SAMPLECOUNT		256
+
+extern int16_t mixbuffer[];
+
+//
+// Sound output.
+// A sink takes the blocks the mixer renders into mixbuffer.
+// Realtime sinks run their own mixing thread and provide lock/unlock
+//  to guard the channels; clocked sinks are stepped by I_SubmitSound
+//  and mix as much audio as the elapsed game tics account for.
+//
+typedef struct
+{
+    char*	name;
+
+    // Returns false if the output could not be opened.
+    boolean	(*init) (void);
+    // Stops and joins any mixing thread before returning.
+    void	(*shutdown) (void);
+
+    // Once per frame, may be NULL.
+    void	(*submit) (void);
+
+    // May be NULL if mixing happens on the game thread.
+    void	(*lock) (void);
+    void	(*unlock) (void);
+} sndsink_t;
+
+extern sndsink_t	null_sndsink;
+extern sndsink_t	wav_sndsink;
+extern sndsink_t	ps3_sndsink;
+
+
 // Init at program start...
 void I_InitSound();
 
 // ... update sound buffer and audio device at runtime...
+// I_UpdateSound mixes one block into mixbuffer, I_SubmitSound
+//  is called once per frame to feed clocked outputs.
 void I_UpdateSound(void);
 void I_SubmitSound(void);
 
@@ -88,6 +126,8 @@ I_UpdateSoundParams
 //
 void I_InitMusic(void);
 void I_ShutdownMusic(void);
+// Keeps the music read-ahead filled, once per frame.
+void I_UpdateMusic(void);
 // Volume.
 void I_SetMusicVolume(int volume);
 // PAUSE game handling.
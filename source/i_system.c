@@ -26,19 +26,24 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 
 #include <stdarg.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <errno.h>
 
 #include <psl1ght/lv2/timer.h>
-#include <psl1ght/lv2.h>
+#include <sys/thread.h>
 #include <psl1ght/lv2/thread.h>
+#include <psl1ght/lv2/filesystem.h>
+#include <psl1ght/lv2.h>
 
 #include <io/pad.h>
 
 #include "doomdef.h"
 #include "m_misc.h"
+#include "m_prof.h"
 #include "v_video.h"
 #include "i_video.h"
 #include "i_sound.h"
@@ -85,59 +90,53 @@ byte* I_ZoneBase (int*	size)
 
 
 //
-// I_GetTime
-// returns time in 1/70th second tics
+// I_GetTimeUS
+// The PPU timebase runs at a fixed 79.8MHz and is readable
+// from user mode, so no syscall is needed.
 //
+int64_t I_GetTimeUS (void)
+{
+    uint64_t	tb;
 
-// PS3 DOOM TODO: PSL1GHT does not have any support the Cell OS Lv-2 timer
-// syscalls yet (except for usleep and sleep), so here's a little kludge
-// which implements a 35Hz using a usleeping loop running in another thread.
-// lol.
+    __asm__ volatile ("mftb %0" : "=r" (tb));
 
-static int ticker = 0;
-static sys_ppu_thread_t ticker_thread_id;
+    return (int64_t)(tb * 10 / 798);
+}
 
-static void ticker_thread_func (uint64_t arg)
-{
-    //sys_ppu_thread_t id;
-    //sys_ppu_thread_stack_t stackinfo;
-    //sys_ppu_thread_get_id(&id);
-    //sys_ppu_thread_get_stack_information(&stackinfo);
-    //printf("stack\naddr: %p\nsize: %08X\n", stackinfo.addr, stackinfo.size);
-    
-    for(;;)
-    {
-        sys_ppu_thread_yield();
-        usleep(1000000/TICRATE);
-        ticker++;
-    }
 
-    sys_ppu_thread_exit(0);
-}
+//
+// I_GetTime
+// returns time in 1/35th second tics,
+// counted from the first call
+//
+static int64_t	basetime;
 
-static void I_StartupTimer(void)
+int  I_GetTime (void)
 {
-    uint64_t thread_arg = 0;
-    uint64_t priority = 1500;
-    size_t stack_size = 0x1000;
-    char *thread_name = "PS3DOOM 35Hz timer";
-    int s;
-    
-    s = sys_ppu_thread_create (&ticker_thread_id,
-                               ticker_thread_func,
-                               thread_arg,
-                               priority,
-                               stack_size,
-                               THREAD_JOINABLE,
-                               thread_name);
-                               
-    printf ("I_StartupTimer: sys_ppu_thread_create returned %d.\n", s);
-    return;
+    if (!basetime)
+	basetime = I_GetTimeUS ();
+
+    return (int)((I_GetTimeUS () - basetime) * TICRATE / 1000000);
 }
 
-int  I_GetTime (void)
+
+//
+// I_WaitForTic
+// Sleeps until I_GetTime reaches tic.
+//
+void I_WaitForTic (int tic)
 {
-    return ticker;
+    int64_t	target;
+    int64_t	now;
+
+    if (!basetime)
+	basetime = I_GetTimeUS ();
+
+    target = basetime + ((int64_t)tic * 1000000 + TICRATE-1) / TICRATE;
+    now = I_GetTimeUS ();
+
+    if (target > now)
+	usleep (target - now);
 }
 
 
@@ -148,8 +147,8 @@ int  I_GetTime (void)
 void I_Init (void)
 {
     I_InitSound();
+    I_InitMusic();
     //  I_InitGraphics();
-    I_StartupTimer();
 }
 
 //
@@ -157,6 +156,9 @@ void I_Init (void)
 //
 void I_Quit (void)
 {
+    G_CheckSave (true);
+    M_FinishWrites ();
+    M_ProfShutdown ();
     D_QuitNetGame ();
     I_ShutdownSound();
     I_ShutdownMusic();
@@ -196,6 +198,337 @@ byte*	I_AllocLow(int length)
 }
 
 
+//
+// I_ListFiles
+// Goes through the LV2 filesystem calls, newlib has no readdir.
+//
+static int I_ComparePaths (const void* a, const void* b)
+{
+    return strcmp (*(char* const*)a, *(char* const*)b);
+}
+
+int I_ListFiles (char* dir, char* ext, char*** paths)
+{
+    Lv2FsFile		fd;
+    Lv2FsDirent		ent;
+    u64			read;
+    char**		list;
+    int			count;
+    int			max;
+    int			len;
+
+    if (lv2FsOpenDir (dir, &fd) != 0)
+	return -1;
+
+    list = NULL;
+    count = max = 0;
+
+    while (lv2FsReadDir (fd, &ent, &read) == 0 && read)
+    {
+	len = strlen (ent.d_name);
+	if (len < strlen (ext) || strcasecmp (ent.d_name + len - strlen (ext), ext))
+	    continue;
+
+	if (count == max)
+	{
+	    max = max ? max*2 : 64;
+	    list = realloc (list, max * sizeof(*list));
+	    if (!list)
+		I_Error ("I_ListFiles: out of memory");
+	}
+
+	list[count] = malloc (strlen (dir) + len + 2);
+	if (!list[count])
+	    I_Error ("I_ListFiles: out of memory");
+	sprintf (list[count++], "%s/%s", dir, ent.d_name);
+    }
+
+    lv2FsCloseDir (fd);
+
+    qsort (list, count, sizeof(*list), I_ComparePaths);
+    *paths = list;
+    return count;
+}
+
+
+//
+// I_ForkJobs
+// There are no processes to fork, everything runs here.
+//
+int I_ForkJobs (int* jobs)
+{
+    *jobs = 1;
+    return 0;
+}
+
+
+//
+// I_StartWrite
+// Each write gets its own PPU thread, joined by I_WaitWrite.
+//
+static sys_ppu_thread_t	writethread;
+static boolean		writing;
+
+static int		writehandle;
+static void*		writebuf;
+static int		writelength;
+static writedone_t	writedone;
+static boolean		writeok = true;
+static volatile boolean	writefinished;
+
+//
+// I_WriteAll
+// write() may take less than it was given, or be interrupted
+// before taking anything, so go on until all of it is written.
+//
+static boolean I_WriteAll (int handle, byte* buf, int length)
+{
+    int		count;
+
+    while (length > 0)
+    {
+	count = write (handle, buf, length);
+	if (count < 0 && errno == EINTR)
+	    continue;
+	if (count <= 0)
+	    return false;
+
+	buf += count;
+	length -= count;
+    }
+
+    return true;
+}
+
+static void I_WriteThread (u64 arg)
+{
+    boolean	ok;
+
+    ok = I_WriteAll (writehandle, writebuf, writelength);
+    if (writedone)
+	ok = writedone (ok);
+    writeok = ok;
+    __sync_synchronize ();
+    writefinished = true;
+    if (arg)
+	sys_ppu_thread_exit (0);
+}
+
+void I_StartWrite (int handle, void* buf, int length, writedone_t done)
+{
+    if (writing)
+	I_Error ("I_StartWrite: a write is already running");
+
+    writehandle = handle;
+    writebuf = buf;
+    writelength = length;
+    writedone = done;
+    writefinished = false;
+
+    if (sys_ppu_thread_create (&writethread, I_WriteThread, 1, 1500,
+			       0x4000, THREAD_JOINABLE, "PS3DOOM writer") != 0)
+    {
+	// no thread, write it here
+	I_WriteThread (0);
+	return;
+    }
+
+    writing = true;
+}
+
+boolean I_WaitWrite (void)
+{
+    u64		retval;
+
+    if (writing)
+    {
+	sys_ppu_thread_join (writethread, &retval);
+	writing = false;
+    }
+
+    return writeok;
+}
+
+boolean I_WriteDone (void)
+{
+    return !writing || writefinished;
+}
+
+
+//
+// I_StartWork
+// Each job gets its own PPU thread, joined by I_WaitWork.
+//
+static sys_ppu_thread_t	workthread;
+static boolean		working;
+
+static void		(*workfunc) (void* arg);
+static void*		workarg;
+static volatile boolean	workfinished;
+
+static void I_WorkThread (u64 arg)
+{
+    workfunc (workarg);
+    __sync_synchronize ();
+    workfinished = true;
+    if (arg)
+	sys_ppu_thread_exit (0);
+}
+
+void I_StartWork (void (*func) (void* arg), void* arg)
+{
+    if (working)
+	I_Error ("I_StartWork: a job is already running");
+
+    workfunc = func;
+    workarg = arg;
+    workfinished = false;
+
+    if (sys_ppu_thread_create (&workthread, I_WorkThread, 1, 1500,
+			       0x10000, THREAD_JOINABLE, "PS3DOOM work") != 0)
+    {
+	// no thread, do it here
+	I_WorkThread (0);
+	return;
+    }
+
+    working = true;
+}
+
+void I_WaitWork (void)
+{
+    u64		retval;
+
+    if (working)
+    {
+	sys_ppu_thread_join (workthread, &retval);
+	working = false;
+    }
+}
+
+boolean I_WorkDone (void)
+{
+    return !working || workfinished;
+}
+
+
+//
+// I_RunParallel
+// The PPU runs two threads at once. The worker is started once
+// and sleeps on a condition between calls, so even a call with
+// little to do is worth spreading. The indexes are handed out
+// one at a time to whichever thread asks first.
+//
+#define PARALLELTHREADS	2
+
+static void		(*parallelfunc) (int index, int thread);
+static int		parallelcount;
+static volatile int	parallelnext;	// next index to hand out
+static unsigned		parallelcall;	// bumped for each call
+static int		parallelbusy;	// workers inside a call
+static boolean		parallelstarted;
+
+static sys_lwmutex_t	parallellock;
+static sys_lwcond_t	parallelstart;
+static sys_lwcond_t	paralleldone;
+
+static void I_ParallelWork (int thread)
+{
+    int		i;
+
+    while ((i = __sync_fetch_and_add (&parallelnext, 1)) < parallelcount)
+	parallelfunc (i, thread);
+}
+
+static void I_ParallelThread (u64 thread)
+{
+    unsigned	call;
+
+    // started in the first call, before it is counted
+    call = 0;
+    sys_lwmutex_lock (&parallellock, 0);
+
+    for (;;)
+    {
+	while (parallelcall == call)
+	    sys_lwcond_wait (&parallelstart, 0);
+	call = parallelcall;
+
+	// counted in, so the call can't be changed under it
+	parallelbusy++;
+	sys_lwmutex_unlock (&parallellock);
+
+	I_ParallelWork (thread);
+
+	sys_lwmutex_lock (&parallellock, 0);
+	if (!--parallelbusy)
+	    sys_lwcond_signal (&paralleldone);
+    }
+}
+
+//
+// I_WaitParallel
+// Returns with the lock held and no worker inside a call.
+//
+static void I_WaitParallel (void)
+{
+    sys_lwmutex_lock (&parallellock, 0);
+    while (parallelbusy)
+	sys_lwcond_wait (&paralleldone, 0);
+}
+
+int I_ParallelThreads (void)
+{
+    return PARALLELTHREADS;
+}
+
+void I_RunParallel (void (*func) (int index, int thread), int count)
+{
+    sys_lwmutex_attribute_t	attr;
+    sys_lwcond_attribute_t	condattr;
+    sys_ppu_thread_t		thread;
+    int				i;
+
+    // a worker that doesn't start leaves more for the caller
+    if (!parallelstarted)
+    {
+	parallelstarted = true;
+
+	memset (&attr, 0, sizeof(attr));
+	attr.attr_protocol = 2;		// PRIORITY
+	attr.attr_recursive = 0x20;	// NOT RECURSIVE
+	if (sys_lwmutex_create (&parallellock, &attr) != 0)
+	    I_Error ("I_RunParallel: sys_lwmutex_create failed");
+
+	memset (&condattr, 0, sizeof(condattr));
+	if (sys_lwcond_create (&parallelstart, &parallellock, &condattr) != 0
+	    || sys_lwcond_create (&paralleldone, &parallellock,
+				  &condattr) != 0)
+	    I_Error ("I_RunParallel: sys_lwcond_create failed");
+
+	for (i=1 ; i<PARALLELTHREADS ; i++)
+	    sys_ppu_thread_create (&thread, I_ParallelThread, i, 1500,
+				   0x40000, 0, "PS3DOOM worker");
+    }
+
+    // one that woke too late for the last call may still be in it
+    I_WaitParallel ();
+
+    parallelfunc = func;
+    parallelcount = count;
+    parallelnext = 0;
+    parallelcall++;
+    sys_lwcond_signal_all (&parallelstart);
+    sys_lwmutex_unlock (&parallellock);
+
+    I_ParallelWork (0);
+
+    // every index is taken, wait for those being done
+    I_WaitParallel ();
+    sys_lwmutex_unlock (&parallellock);
+}
+
+
 //
 // I_Error
 //
@@ -223,7 +556,11 @@ void I_Error (char *error, ...)
     if (demorecording)
 	G_CheckDemoStatus();
 
+    M_FinishWrites ();
+    M_ProfShutdown ();
     D_QuitNetGame ();
+    I_ShutdownSound ();	// finish any WAV recording
+    I_ShutdownMusic ();	// drop a song being rendered
     
     if (graphics_initialized)
     {
@@ -42,6 +42,14 @@ byte* I_ZoneBase (int *size);
 // returns current time in tics.
 int I_GetTime (void);
 
+// Sleeps until I_GetTime returns at least tic,
+// instead of spinning on the clock.
+void I_WaitForTic (int tic);
+
+// Current time in microseconds, for timing frames and code.
+// Only differences between two calls are meaningful.
+int64_t I_GetTimeUS (void);
+
 
 //
 // Called by D_DoomLoop,
@@ -83,6 +91,45 @@ byte* I_AllocLow (int length);
 
 void I_Tactile (int on, int off, int total);
 
+// Lists the files in dir whose names end in ext, sorted, as
+// malloc'd paths. Returns -1 if dir can't be read as a directory.
+int I_ListFiles (char* dir, char* ext, char*** paths);
+
+// Splits the caller into up to jobs processes, where the
+// platform has them. Each returns its index and sets jobs to
+// the number running. The parent waits for all of them and
+// exits, failing if any of them did.
+int I_ForkJobs (int* jobs);
+
+// Writes length bytes of buf to the open file handle in the
+// background where the platform has threads, otherwise at once.
+// Only one write runs at a time: I_WaitWrite must be called
+// before the next one and before buf is touched again. It
+// returns false if the write failed. I_WriteDone returns true
+// once I_WaitWrite would not block. done, if not NULL, is
+// called by the writer once the write is over, with whether it
+// worked, and what it returns is what I_WaitWrite returns.
+typedef boolean (*writedone_t) (boolean ok);
+void I_StartWrite (int handle, void* buf, int length, writedone_t done);
+boolean I_WaitWrite (void);
+boolean I_WriteDone (void);
+
+// Runs func (arg) in the background where the platform has
+// threads, otherwise at once, for work too long to do between
+// two frames. Only one runs at a time, and I_WaitWork must be
+// called before the next. I_WorkDone returns true once
+// I_WaitWork would not block.
+void I_StartWork (void (*func) (void* arg), void* arg);
+void I_WaitWork (void);
+boolean I_WorkDone (void);
+
+// Calls func for each index below count, spread over the
+// threads the platform has, and returns when all are done.
+// thread is below I_ParallelThreads, and no two calls with the
+// same thread run at once.
+int I_ParallelThreads (void);
+void I_RunParallel (void (*func) (int index, int thread), int count);
+
 
 void I_Error (char *error, ...);
 
@@ -740,6 +740,34 @@ static void I_GetEvent(void)
             event.data1 = KEY_TAB;
             D_PostEvent (&event);
         }
+
+        // R3 = quicksave
+        if (paddata.BTN_R3 && !lastpaddata.BTN_R3)
+        {
+            event.type = ev_keydown;
+            event.data1 = KEY_F6;
+            D_PostEvent (&event);
+        }
+        else if (!paddata.BTN_R3 && lastpaddata.BTN_R3)
+        {
+            event.type = ev_keyup;
+            event.data1 = KEY_F6;
+            D_PostEvent (&event);
+        }
+
+        // L3 = quickload
+        if (paddata.BTN_L3 && !lastpaddata.BTN_L3)
+        {
+            event.type = ev_keydown;
+            event.data1 = KEY_F9;
+            D_PostEvent (&event);
+        }
+        else if (!paddata.BTN_L3 && lastpaddata.BTN_L3)
+        {
+            event.type = ev_keyup;
+            event.data1 = KEY_F9;
+            D_PostEvent (&event);
+        }
     }
 
     return;
@@ -0,0 +1,364 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//	Timedemo benchmark over a list of demos.
+//
+//	-benchmark demo1 demo2 ... plays each demo as with -timedemo,
+//	one tic per frame, and times every frame with I_GetTimeUS,
+//	split into the phases in benchphase_t. When the last demo
+//	ends, min/avg/p95/p99/max of the frame and phase times of
+//	each demo are written as JSON to -benchout <file>, by default
+//	benchmark.json, and the game quits.
+//
+//	Frames are only counted while a demo is playing, so the level
+//	load at the start of each demo is left out.
+//
+//-----------------------------------------------------------------------------
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "g_game.h"
+
+#include "m_bench.h"
+
+
+boolean		benchmarking;
+
+static char*	benchout = "benchmark.json";
+
+static char**	demonames;
+static int	numdemos;
+static int	curdemo;
+static boolean	demodone;
+
+static char*	phasenames[NUMBENCHPHASES] =
+{
+    "sim", "bsp", "planes", "masked", "blit"
+};
+
+// Times of one frame, in microseconds: each phase,
+// then the whole frame.
+#define BENCH_TOTAL	NUMBENCHPHASES
+
+typedef struct
+{
+    int		time[NUMBENCHPHASES+1];
+} benchframe_t;
+
+// Frames of the demo playing.
+static benchframe_t*	frames;
+static int		numframes;
+static int		maxframes;
+
+static benchframe_t	curframe;
+static boolean		framevalid;
+static int64_t		framestart;
+static int64_t		phasestart[NUMBENCHPHASES];
+
+static int		demostarttic;
+static int64_t		demostarttime;
+
+// Frame time statistics, in milliseconds.
+typedef struct
+{
+    double	min;
+    double	avg;
+    double	p95;
+    double	p99;
+    double	max;
+} benchstats_t;
+
+typedef struct
+{
+    char*		name;
+    int			gametics;
+    int			frames;
+    double		realtime;	// seconds
+    benchstats_t	total;
+    benchstats_t	phase[NUMBENCHPHASES];
+} benchresult_t;
+
+static benchresult_t*	results;
+
+
+
+//
+// M_BenchInit
+//
+boolean M_BenchInit (void)
+{
+    int		p;
+    int		i;
+
+    p = M_CheckParm ("-benchmark");
+    if (!p)
+	return false;
+
+    // the parms after p are demo names,
+    // until end of parms or another - preceded parm
+    demonames = &myargv[p+1];
+    for (numdemos = 0 ; p+1+numdemos < myargc ; numdemos++)
+	if (myargv[p+1+numdemos][0] == '-')
+	    break;
+
+    if (!numdemos)
+	I_Error ("M_BenchInit: no demos given to -benchmark");
+
+    i = M_CheckParm ("-benchout");
+    if (i && i < myargc-1)
+	benchout = myargv[i+1];
+
+    results = malloc (numdemos * sizeof(*results));
+    if (!results)
+	I_Error ("M_BenchInit: out of memory");
+    memset (results, 0, numdemos * sizeof(*results));
+
+    benchmarking = true;
+    curdemo = 0;
+    numframes = 0;
+
+    printf ("M_BenchInit: timing %i demos.\n", numdemos);
+
+    G_TimeDemo (demonames[0]);
+    return true;
+}
+
+
+//
+// M_BenchStartFrame
+//
+void M_BenchStartFrame (void)
+{
+    if (!benchmarking)
+	return;
+
+    memset (&curframe, 0, sizeof(curframe));
+    framevalid = demoplayback;
+    framestart = I_GetTimeUS ();
+}
+
+
+void M_BenchBeginPhase (benchphase_t phase)
+{
+    if (!benchmarking)
+	return;
+
+    phasestart[phase] = I_GetTimeUS ();
+}
+
+
+void M_BenchEndPhase (benchphase_t phase)
+{
+    if (!benchmarking)
+	return;
+
+    curframe.time[phase] += (int)(I_GetTimeUS () - phasestart[phase]);
+}
+
+
+void M_BenchDemoDone (void)
+{
+    demodone = true;
+}
+
+
+//
+// M_BenchStats
+// Nearest rank percentiles over one field of the frames.
+//
+static int	statfield;
+
+static int M_CompareFrames (const void* a, const void* b)
+{
+    return ((const benchframe_t*)a)->time[statfield]
+	- ((const benchframe_t*)b)->time[statfield];
+}
+
+static double M_Percentile (int pct)
+{
+    int		rank;
+
+    rank = (numframes*pct + 99) / 100 - 1;
+    if (rank < 0)
+	rank = 0;
+
+    return frames[rank].time[statfield] / 1000.0;
+}
+
+static void M_BenchStats (int field, benchstats_t* stats)
+{
+    int		i;
+    double	sum;
+
+    memset (stats, 0, sizeof(*stats));
+    if (!numframes)
+	return;
+
+    statfield = field;
+    qsort (frames, numframes, sizeof(benchframe_t), M_CompareFrames);
+
+    sum = 0;
+    for (i=0 ; i<numframes ; i++)
+	sum += frames[i].time[field];
+
+    stats->min = M_Percentile (0);
+    stats->avg = sum / numframes / 1000.0;
+    stats->p95 = M_Percentile (95);
+    stats->p99 = M_Percentile (99);
+    stats->max = M_Percentile (100);
+}
+
+
+//
+// M_BenchFinishDemo
+//
+static void M_BenchFinishDemo (void)
+{
+    benchresult_t*	r;
+    int			i;
+
+    r = &results[curdemo];
+    r->name = demonames[curdemo];
+    r->gametics = gametic - demostarttic;
+    r->frames = numframes;
+    r->realtime = (I_GetTimeUS () - demostarttime) / 1000000.0;
+
+    M_BenchStats (BENCH_TOTAL, &r->total);
+    for (i=0 ; i<NUMBENCHPHASES ; i++)
+	M_BenchStats (i, &r->phase[i]);
+
+    printf ("M_Bench: %s: %i frames in %.2f s, avg %.2f ms, p99 %.2f ms\n",
+	    r->name, r->frames, r->realtime, r->total.avg, r->total.p99);
+
+    numframes = 0;
+}
+
+
+static void M_WriteStats (FILE* f, char* name, benchstats_t* s, char* tail)
+{
+    fprintf (f, "\"%s\": { \"min\": %.3f, \"avg\": %.3f, \"p95\": %.3f,"
+	     " \"p99\": %.3f, \"max\": %.3f }%s\n",
+	     name, s->min, s->avg, s->p95, s->p99, s->max, tail);
+}
+
+
+//
+// M_BenchWriteReport
+//
+static void M_BenchWriteReport (void)
+{
+    FILE*		f;
+    benchresult_t*	r;
+    int			i;
+    int			j;
+
+    f = fopen (benchout, "w");
+    if (!f)
+	I_Error ("M_BenchWriteReport: can't write %s", benchout);
+
+    fprintf (f, "{\n  \"demos\": [\n");
+
+    for (i=0 ; i<numdemos ; i++)
+    {
+	r = &results[i];
+
+	fprintf (f, "    {\n");
+	fprintf (f, "      \"name\": \"%s\",\n", r->name);
+	fprintf (f, "      \"gametics\": %i,\n", r->gametics);
+	fprintf (f, "      \"frames\": %i,\n", r->frames);
+	fprintf (f, "      \"realtime\": %.3f,\n", r->realtime);
+	fprintf (f, "      \"fps\": %.2f,\n",
+		 r->realtime > 0 ? r->frames / r->realtime : 0.0);
+	fprintf (f, "      ");
+	M_WriteStats (f, "frametime", &r->total, ",");
+	fprintf (f, "      \"phases\": {\n");
+
+	for (j=0 ; j<NUMBENCHPHASES ; j++)
+	{
+	    fprintf (f, "        ");
+	    M_WriteStats (f, phasenames[j], &r->phase[j],
+			  j < NUMBENCHPHASES-1 ? "," : "");
+	}
+
+	fprintf (f, "      }\n");
+	fprintf (f, "    }%s\n", i < numdemos-1 ? "," : "");
+    }
+
+    fprintf (f, "  ]\n}\n");
+    fclose (f);
+
+    printf ("M_Bench: wrote %s\n", benchout);
+}
+
+
+//
+// M_BenchEndFrame
+// Keeps the frame if a demo played through all of it,
+// and moves on to the next demo when one has ended.
+//
+void M_BenchEndFrame (void)
+{
+    if (!benchmarking)
+	return;
+
+    if (framevalid && !demodone)
+    {
+	if (!numframes)
+	{
+	    demostarttic = gametic - 1;
+	    demostarttime = framestart;
+	}
+
+	if (numframes == maxframes)
+	{
+	    maxframes = maxframes ? maxframes*2 : 4096;
+	    frames = realloc (frames, maxframes * sizeof(*frames));
+	    if (!frames)
+		I_Error ("M_BenchEndFrame: out of memory");
+	}
+
+	curframe.time[BENCH_TOTAL] = (int)(I_GetTimeUS () - framestart);
+	frames[numframes++] = curframe;
+    }
+
+    if (!demodone)
+	return;
+
+    demodone = false;
+    M_BenchFinishDemo ();
+
+    if (++curdemo < numdemos)
+    {
+	G_DeferedPlayDemo (demonames[curdemo]);
+	return;
+    }
+
+    M_BenchWriteReport ();
+    benchmarking = false;
+    I_Quit ();
+}
@@ -0,0 +1,61 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//	Timedemo benchmark over a list of demos.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __M_BENCH__
+#define __M_BENCH__
+
+#include "doomtype.h"
+
+// Parts of a frame timed separately.
+typedef enum
+{
+    bp_sim,		// G_Ticker
+    bp_bsp,		// R_RenderBSPNode, walls and segs
+    bp_planes,		// R_DrawPlanes
+    bp_masked,		// R_DrawMasked, sprites and masked mids
+    bp_blit,		// I_FinishUpdate
+    NUMBENCHPHASES
+} benchphase_t;
+
+// True while -benchmark is running.
+extern boolean	benchmarking;
+
+// Checks for -benchmark <demo> ... and starts the first demo.
+// Returns false if not given.
+boolean M_BenchInit (void);
+
+// Called by D_DoomLoop around each frame.
+void M_BenchStartFrame (void);
+void M_BenchEndFrame (void);
+
+// Time a phase of the current frame.
+void M_BenchBeginPhase (benchphase_t phase);
+void M_BenchEndPhase (benchphase_t phase);
+
+// Called by G_CheckDemoStatus when a demo runs out.
+void M_BenchDemoDone (void);
+
+#endif
@@ -52,6 +52,7 @@
 #include "g_game.h"
 
 #include "m_argv.h"
+#include "m_misc.h"
 #include "m_swap.h"
 
 #include "s_sound.h"
@@ -522,6 +523,7 @@ void M_ReadSaveStrings(void)
 	else
 	    sprintf(name,SAVEGAMENAME"%d.dsg",i);
 
+	M_RecoverFile (name);
 	handle = open (name, O_RDONLY | 0, 0666);
 	if (handle == -1)
 	{
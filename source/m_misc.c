@@ -21,6 +21,8 @@
 // DESCRIPTION:
 //	Main loop menu stuff.
 //	Default Config File.
+//	Streamed files.
+//	Files written in the background.
 //	PCX Screenshots.
 //
 //-----------------------------------------------------------------------------
@@ -28,8 +30,11 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <fcntl.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <string.h>
+#include <errno.h>
 
 #include <ctype.h>
 
@@ -161,6 +166,282 @@ M_ReadFile
 }
 
 
+//
+// M_OpenStream
+// A file written through two buffers of size bytes: one fills
+// while the other is written out in the background. Returns
+// NULL if the file can't be created.
+//
+static mstream_t*	writingstream;
+
+mstream_t* M_OpenStream (char const* name, int size)
+{
+    mstream_t*	s;
+    int		handle;
+
+    handle = open (name, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+    if (handle == -1)
+	return NULL;
+
+    s = Z_Malloc (sizeof(*s) + size*2, PU_STATIC, NULL);
+    s->handle = handle;
+    s->buffers[0] = (byte *)(s+1);
+    s->buffers[1] = s->buffers[0] + size;
+    s->size = size;
+    s->cur = 0;
+    s->fill = 0;
+    s->failed = false;
+
+    return s;
+}
+
+
+// The file M_StartWriteFile is writing, see there.
+static boolean		writingfile;
+static int		filehandle;
+static void*		filesource;
+static char		filename[256];
+static char		filetemp[260];
+static char		filebackup[260];
+static int		fileresult;
+
+static void M_FinishWriteFile (void);
+
+
+//
+// M_WaitStreams
+// Waits for the write in the background, if any.
+//
+static void M_WaitStreams (void)
+{
+    if (writingstream && !I_WaitWrite ())
+	writingstream->failed = true;
+    writingstream = NULL;
+
+    if (writingfile)
+	M_FinishWriteFile ();
+}
+
+
+//
+// M_FinishWrites
+// Waits for the write in the background, if any, and puts its
+// file in place or removes what was written of it. Called on
+// the way out, so no .tmp file is left behind.
+//
+void M_FinishWrites (void)
+{
+    M_WaitStreams ();
+}
+
+
+//
+// M_FlushStream
+// Starts writing the filled buffer and switches to the other.
+//
+void M_FlushStream (mstream_t* s)
+{
+    if (!s->fill)
+	return;
+
+    M_WaitStreams ();
+
+    I_StartWrite (s->handle, s->buffers[s->cur], s->fill, NULL);
+    writingstream = s;
+
+    s->cur ^= 1;
+    s->fill = 0;
+}
+
+
+//
+// M_StreamWrite
+//
+void M_StreamWrite (mstream_t* s, void* data, int length)
+{
+    byte*	src;
+    int		count;
+
+    src = data;
+    while (length > 0)
+    {
+	count = s->size - s->fill;
+	if (count > length)
+	    count = length;
+
+	memcpy (s->buffers[s->cur] + s->fill, src, count);
+	s->fill += count;
+	src += count;
+	length -= count;
+
+	if (s->fill == s->size)
+	    M_FlushStream (s);
+    }
+}
+
+
+//
+// M_CloseStream
+// Writes out what is left and frees the stream.
+// Returns false if any of it could not be written.
+//
+boolean M_CloseStream (mstream_t* s)
+{
+    boolean	ok;
+
+    M_FlushStream (s);
+    M_WaitStreams ();
+
+    ok = !s->failed;
+    if (close (s->handle) == -1)
+	ok = false;
+
+    Z_Free (s);
+    return ok;
+}
+
+
+//
+// M_RecoverFile
+// A replace M_PlaceFile was cut short in can leave the old
+// file only as name with .bak added. If name is missing, the
+// .bak is put back.
+//
+void M_RecoverFile (char const* name)
+{
+    char	backup[260];
+
+    snprintf (backup, sizeof(backup), "%s.bak", name);
+    if (access (name, F_OK) == -1 && access (backup, F_OK) == 0)
+	rename (backup, name);
+}
+
+
+//
+// M_PlaceFile
+// Run by the writer once the .tmp file is written, so the game
+// never waits on the disk: syncs and closes it, then puts it in
+// place of the old file. If it can't be, the old file is kept.
+//
+static boolean M_PlaceFile (boolean ok)
+{
+    int		error;
+#ifdef PS3
+    boolean	backup;
+#endif
+
+    // on the disk before it can replace the old file
+    if (ok && fsync (filehandle) == -1)
+	ok = false;
+    if (close (filehandle) == -1)
+	ok = false;
+    if (!ok)
+    {
+	remove (filetemp);
+	return false;
+    }
+
+#ifdef PS3
+    // rename won't replace a file here, so the old one is moved
+    // to .bak and only removed once the new one is in place
+    M_RecoverFile (filename);
+    remove (filebackup);
+    backup = rename (filename, filebackup) != -1;
+    ok = rename (filetemp, filename) != -1;
+    error = errno;
+    if (backup)
+    {
+	if (ok)
+	    remove (filebackup);
+	else
+	    rename (filebackup, filename);
+    }
+#else
+    ok = rename (filetemp, filename) != -1;
+    error = errno;
+#endif
+
+    if (!ok)
+    {
+	printf ("M_PlaceFile: can't rename %s to %s: %s\n",
+		filetemp, filename, strerror (error));
+	remove (filetemp);
+    }
+
+    return ok;
+}
+
+
+//
+// M_StartWriteFile
+// Writes length bytes of source to name in the background.
+// They go to name with .tmp added, which is renamed over name
+// once all of it is written, so a failed write never leaves
+// name half written, see M_PlaceFile. source must come from malloc, and is freed
+// when the write is done. Returns false if the file can't be
+// created. A write already going is finished first.
+//
+boolean M_StartWriteFile (char const* name, void* source, int length)
+{
+    int		handle;
+
+    M_WaitStreams ();
+
+    snprintf (filename, sizeof(filename), "%s", name);
+    snprintf (filetemp, sizeof(filetemp), "%s.tmp", filename);
+    snprintf (filebackup, sizeof(filebackup), "%s.bak", filename);
+
+    handle = open (filetemp, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+    if (handle == -1)
+    {
+	free (source);
+	return false;
+    }
+
+    filehandle = handle;
+    filesource = source;
+    writingfile = true;
+    I_StartWrite (handle, source, length, M_PlaceFile);
+
+    return true;
+}
+
+
+//
+// M_FinishWriteFile
+// Waits for the write, which M_PlaceFile has finished.
+//
+static void M_FinishWriteFile (void)
+{
+    boolean	ok;
+
+    ok = I_WaitWrite ();
+    free (filesource);
+    writingfile = false;
+
+    fileresult = ok ? 1 : -1;
+}
+
+
+//
+// M_WriteFileResult
+// 1 once the write M_StartWriteFile began is done, -1 if it
+// failed, and 0 before that or if there was none. Each result
+// is given once. With wait, waits for the write to finish.
+//
+int M_WriteFileResult (boolean wait)
+{
+    int		result;
+
+    if (writingfile && (wait || I_WriteDone ()))
+	M_FinishWriteFile ();
+
+    result = fileresult;
+    fileresult = 0;
+    return result;
+}
+
+
 //
 // DEFAULTS
 //
@@ -278,7 +559,7 @@ default_t	defaults[] =
     {"screenblocks",&screenblocks, 10},
     {"detaillevel",&detailLevel, 0},
 
-    {"snd_channels",&numChannels, 32}, // was 3, original doom max is 8
+    {"snd_channels",&numChannels, 64}, // was 3, original doom max is 8
 
 
 
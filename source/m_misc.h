@@ -44,6 +44,30 @@ M_ReadFile
 ( char const*	name,
   byte**	buffer );
 
+// A file written through two buffers, see M_OpenStream.
+typedef struct
+{
+    int		handle;
+    byte*	buffers[2];
+    int		size;		// of each buffer
+    int		cur;		// the buffer being filled
+    int		fill;
+    boolean	failed;
+} mstream_t;
+
+mstream_t* M_OpenStream (char const* name, int size);
+void M_StreamWrite (mstream_t* s, void* data, int length);
+void M_FlushStream (mstream_t* s);
+boolean M_CloseStream (mstream_t* s);
+
+// A file written in the background, see M_StartWriteFile.
+boolean M_StartWriteFile (char const* name, void* source, int length);
+int M_WriteFileResult (boolean wait);
+void M_RecoverFile (char const* name);
+
+// Finishes any write in the background, for I_Quit and I_Error.
+void M_FinishWrites (void);
+
 void M_ScreenShot (void);
 
 void M_LoadDefaults (void);
@@ -0,0 +1,367 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//	Scoped zone profiler.
+//
+//	-profile times the zones in profzone_t on the game thread and
+//	shows their average time and calls per frame over the last
+//	PROFFRAMES frames on screen, and below them the counts in
+//	profcounter_t per game tic. -proftrace <file> also writes
+//	those frames, every zone entry included, as a Chrome trace
+//	(chrome://tracing) when the game exits.
+//
+//	Zones opened with PROF_BEGIN must be closed with PROF_END in
+//	the same frame. The mixer runs on its own thread on the PS3,
+//	so it only reports totals through M_ProfAddTime.
+//
+//-----------------------------------------------------------------------------
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomdef.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "hu_lib.h"
+#include "hu_stuff.h"
+
+#include "m_prof.h"
+
+
+boolean		profiling;
+
+extern patch_t*	hu_font[HU_FONTSIZE];
+
+static char*	tracename;
+
+// Frames kept for the overlay and the trace.
+#define PROFFRAMES	64
+
+// Zone entries kept per frame for the trace.
+#define MAXPROFEVENTS	2048
+
+#define MAXPROFDEPTH	16
+
+typedef struct
+{
+    char*	name;
+    int		depth;		// indent on the overlay
+} profzoneinfo_t;
+
+static char*		countername[NUMPROFCOUNTERS] =
+{
+    NULL,
+    "thinkers",
+    "dormant"
+};
+
+static profzoneinfo_t	zoneinfo[NUMPROFZONES] =
+{
+    { "frame",		0 },
+    { "sim",		1 },
+    { "thinkers",	2 },
+    { "trymove",	3 },
+    { "sight",		3 },
+    { "render",		1 },
+    { "bsp",		2 },
+    { "planes",		2 },
+    { "masked",		2 },
+    { "blit",		1 },
+    { "mixer",		1 }
+};
+
+typedef struct
+{
+    int64_t	start;
+    int		time;
+    int		zone;
+} profevent_t;
+
+typedef struct
+{
+    int64_t		start;
+    int			time[NUMPROFZONES];
+    int			calls[NUMPROFZONES];
+    int			counts[NUMPROFCOUNTERS];
+
+    profevent_t*	events;
+    int			numevents;
+} profframe_t;
+
+static profframe_t	profframes[PROFFRAMES];
+static profframe_t*	curframe;
+static int		framecount;
+
+// Completed frames still in the ring. The slot after the
+// newest is reused by the frame in progress.
+#define KEPTFRAMES	(framecount < PROFFRAMES-1 ? framecount : PROFFRAMES-1)
+
+// Open zones.
+static profevent_t	stack[MAXPROFDEPTH];
+static int		depth;
+
+// Written by the mixer thread, collected at the end of each frame.
+static volatile int	asynctime[NUMPROFZONES];
+static volatile int	asynccalls[NUMPROFZONES];
+
+
+
+//
+// M_ProfInit
+//
+void M_ProfInit (void)
+{
+    int		p;
+    int		i;
+
+    p = M_CheckParm ("-proftrace");
+    if (p && p < myargc-1)
+	tracename = myargv[p+1];
+
+    if (!tracename && !M_CheckParm ("-profile"))
+	return;
+
+    for (i=0 ; i<PROFFRAMES ; i++)
+    {
+	profframes[i].events = malloc (MAXPROFEVENTS * sizeof(profevent_t));
+	if (!profframes[i].events)
+	    I_Error ("M_ProfInit: out of memory");
+    }
+
+    curframe = &profframes[0];
+    profiling = true;
+}
+
+
+void M_ProfBegin (profzone_t zone)
+{
+    if (depth < MAXPROFDEPTH)
+    {
+	stack[depth].zone = zone;
+	stack[depth].start = I_GetTimeUS ();
+    }
+    depth++;
+}
+
+
+void M_ProfEnd (profzone_t zone)
+{
+    profevent_t*	ev;
+
+    if (--depth >= MAXPROFDEPTH || depth < 0)
+    {
+	if (depth < 0)
+	    depth = 0;
+	return;
+    }
+
+    ev = &stack[depth];
+    ev->time = (int)(I_GetTimeUS () - ev->start);
+
+    curframe->time[ev->zone] += ev->time;
+    curframe->calls[ev->zone]++;
+
+    if (curframe->numevents < MAXPROFEVENTS)
+	curframe->events[curframe->numevents++] = *ev;
+}
+
+
+void M_ProfCount (profcounter_t counter, int n)
+{
+    curframe->counts[counter] += n;
+}
+
+
+void M_ProfAddTime (profzone_t zone, int us)
+{
+    asynctime[zone] += us;
+    asynccalls[zone]++;
+}
+
+
+//
+// M_ProfStartFrame
+//
+void M_ProfStartFrame (void)
+{
+    if (!profiling)
+	return;
+
+    curframe = &profframes[framecount % PROFFRAMES];
+    memset (curframe->time, 0, sizeof(curframe->time));
+    memset (curframe->calls, 0, sizeof(curframe->calls));
+    memset (curframe->counts, 0, sizeof(curframe->counts));
+    curframe->numevents = 0;
+
+    depth = 0;
+    M_ProfBegin (pz_frame);
+    curframe->start = stack[0].start;
+}
+
+
+void M_ProfEndFrame (void)
+{
+    int		i;
+
+    if (!profiling)
+	return;
+
+    // close the frame and anything left open
+    while (depth > 1)
+	M_ProfEnd (stack[depth-1].zone);
+    M_ProfEnd (pz_frame);
+
+    for (i=0 ; i<NUMPROFZONES ; i++)
+    {
+	if (!asynccalls[i])
+	    continue;
+	curframe->time[i] += asynctime[i];
+	curframe->calls[i] += asynccalls[i];
+	asynctime[i] = 0;
+	asynccalls[i] = 0;
+    }
+
+    framecount++;
+}
+
+
+//
+// M_ProfDrawer
+// One line per zone: average ms and calls per frame,
+// then one per count: its average per tic.
+//
+void M_ProfDrawer (void)
+{
+    hu_textline_t	line;
+    char		text[HU_MAXLINELENGTH+1];
+    char*		c;
+    profframe_t*	fr;
+    int			frames;
+    int			time;
+    int			calls;
+    int			tics;
+    int			count;
+    int			i;
+    int			j;
+
+    if (!profiling || !framecount)
+	return;
+
+    frames = KEPTFRAMES;
+
+    for (i=0 ; i<NUMPROFZONES ; i++)
+    {
+	time = calls = 0;
+	for (j=0 ; j<frames ; j++)
+	{
+	    fr = &profframes[(framecount-1-j) % PROFFRAMES];
+	    time += fr->time[i];
+	    calls += fr->calls[i];
+	}
+
+	sprintf (text, "%*s%-8s %6.2f %5i",
+		 zoneinfo[i].depth*2, "", zoneinfo[i].name,
+		 time / 1000.0 / frames, calls / frames);
+
+	HUlib_initTextLine (&line, 2, 2 + i*9, hu_font, HU_FONTSTART);
+	for (c = text ; *c ; c++)
+	    HUlib_addCharToTextLine (&line, *c);
+	HUlib_drawTextLine (&line, false);
+    }
+
+    tics = 0;
+    for (j=0 ; j<frames ; j++)
+	tics += profframes[(framecount-1-j) % PROFFRAMES].counts[pc_tics];
+    if (!tics)
+	return;
+
+    for (i=1 ; i<NUMPROFCOUNTERS ; i++)
+    {
+	count = 0;
+	for (j=0 ; j<frames ; j++)
+	    count += profframes[(framecount-1-j) % PROFFRAMES].counts[i];
+
+	sprintf (text, "%-8s %12i", countername[i], count / tics);
+
+	HUlib_initTextLine (&line, 2, 2 + (NUMPROFZONES+i)*9,
+			    hu_font, HU_FONTSTART);
+	for (c = text ; *c ; c++)
+	    HUlib_addCharToTextLine (&line, *c);
+	HUlib_drawTextLine (&line, false);
+    }
+}
+
+
+//
+// M_ProfShutdown
+// Writes the kept frames as Chrome trace events.
+//
+void M_ProfShutdown (void)
+{
+    FILE*		f;
+    profframe_t*	fr;
+    profevent_t*	ev;
+    int64_t		base;
+    int			frames;
+    int			first;
+    int			i;
+    int			j;
+
+    if (!profiling || !tracename || !framecount)
+	return;
+
+    profiling = false;
+
+    f = fopen (tracename, "w");
+    if (!f)
+    {
+	printf ("M_ProfShutdown: can't write %s\n", tracename);
+	return;
+    }
+
+    frames = KEPTFRAMES;
+    first = framecount - frames;
+    base = profframes[first % PROFFRAMES].start;
+
+    fprintf (f, "{\"traceEvents\":[\n");
+
+    for (i=0 ; i<frames ; i++)
+    {
+	fr = &profframes[(first+i) % PROFFRAMES];
+
+	for (j=0 ; j<fr->numevents ; j++)
+	{
+	    ev = &fr->events[j];
+	    fprintf (f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%lld,"
+		     "\"dur\":%i,\"pid\":1,\"tid\":1}\n",
+		     i || j ? "," : "",
+		     zoneinfo[ev->zone].name,
+		     (long long)(ev->start - base), ev->time);
+	}
+    }
+
+    fprintf (f, "]}\n");
+    fclose (f);
+
+    printf ("M_ProfShutdown: wrote %i frames to %s\n", frames, tracename);
+}
@@ -0,0 +1,83 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//	Scoped zone profiler.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __M_PROF__
+#define __M_PROF__
+
+#include "doomtype.h"
+
+// Timed zones. They nest as listed.
+typedef enum
+{
+    pz_frame,
+    pz_sim,
+    pz_thinkers,
+    pz_trymove,
+    pz_sight,
+    pz_render,
+    pz_bsp,
+    pz_planes,
+    pz_masked,
+    pz_blit,
+    pz_mixer,		// on the mixer thread, see M_ProfAddTime
+    NUMPROFZONES
+} profzone_t;
+
+// Counts shown per tic under the zones.
+typedef enum
+{
+    pc_tics,		// game tics run, which the others are divided by
+    pc_thinkers,	// thinkers run
+    pc_dormant,		// thinkers left sleeping or static
+    NUMPROFCOUNTERS
+} profcounter_t;
+
+// True with -profile or -proftrace.
+extern boolean	profiling;
+
+// Zones cost one test of profiling when it is off.
+#define PROF_BEGIN(zone)	do { if (profiling) M_ProfBegin (zone); } while (0)
+#define PROF_END(zone)		do { if (profiling) M_ProfEnd (zone); } while (0)
+#define PROF_COUNT(counter,n)	do { if (profiling) M_ProfCount (counter, n); } while (0)
+
+void M_ProfInit (void);
+void M_ProfShutdown (void);
+
+void M_ProfBegin (profzone_t zone);
+void M_ProfEnd (profzone_t zone);
+void M_ProfCount (profcounter_t counter, int n);
+
+// Adds time spent outside the game thread to the current frame.
+void M_ProfAddTime (profzone_t zone, int us);
+
+// Called by D_DoomLoop around each frame.
+void M_ProfStartFrame (void);
+void M_ProfEndFrame (void);
+
+// Draws the overlay over the finished frame.
+void M_ProfDrawer (void);
+
+#endif
@@ -70,8 +70,7 @@ void T_MoveCeiling (ceiling_t* ceiling)
 	      case silentCrushAndRaise:
 		break;
 	      default:
-		S_StartSound((mobj_t *)&ceiling->sector->soundorg,
-			     sfx_stnmov);
+		P_SectorSound (ceiling->sector, sfx_stnmov);
 		// ?
 		break;
 	    }
@@ -86,8 +85,7 @@ void T_MoveCeiling (ceiling_t* ceiling)
 		break;
 		
 	      case silentCrushAndRaise:
-		S_StartSound((mobj_t *)&ceiling->sector->soundorg,
-			     sfx_pstop);
+		P_SectorSound (ceiling->sector, sfx_pstop);
 	      case fastCrushAndRaise:
 	      case crushAndRaise:
 		ceiling->direction = -1;
@@ -113,8 +111,7 @@ void T_MoveCeiling (ceiling_t* ceiling)
 	    {
 	      case silentCrushAndRaise: break;
 	      default:
-		S_StartSound((mobj_t *)&ceiling->sector->soundorg,
-			     sfx_stnmov);
+		P_SectorSound (ceiling->sector, sfx_stnmov);
 	    }
 	}
 	
@@ -123,8 +120,7 @@ void T_MoveCeiling (ceiling_t* ceiling)
 	    switch(ceiling->type)
 	    {
 	      case silentCrushAndRaise:
-		S_StartSound((mobj_t *)&ceiling->sector->soundorg,
-			     sfx_pstop);
+		P_SectorSound (ceiling->sector, sfx_pstop);
 	      case crushAndRaise:
 		ceiling->speed = CEILSPEED;
 	      case fastCrushAndRaise:
@@ -268,6 +264,12 @@ void P_AddActiveCeiling(ceiling_t* c)
 void P_RemoveActiveCeiling(ceiling_t* c)
 {
     int		i;
+
+    if (threadedspecials)
+    {
+	P_DeferSpecial (c->sector, (actionf_p1)P_RemoveActiveCeiling, c);
+	return;
+    }
 	
     for (i = 0;i < MAXCEILINGS;i++)
     {
@@ -73,20 +73,17 @@ void T_VerticalDoor (vldoor_t* door)
 	    {
 	      case blazeRaise:
 		door->direction = -1; // time to go back down
-		S_StartSound((mobj_t *)&door->sector->soundorg,
-			     sfx_bdcls);
+		P_SectorSound (door->sector, sfx_bdcls);
 		break;
 		
 	      case normal:
 		door->direction = -1; // time to go back down
-		S_StartSound((mobj_t *)&door->sector->soundorg,
-			     sfx_dorcls);
+		P_SectorSound (door->sector, sfx_dorcls);
 		break;
 		
 	      case close30ThenOpen:
 		door->direction = 1;
-		S_StartSound((mobj_t *)&door->sector->soundorg,
-			     sfx_doropn);
+		P_SectorSound (door->sector, sfx_doropn);
 		break;
 		
 	      default:
@@ -104,8 +101,7 @@ void T_VerticalDoor (vldoor_t* door)
 	      case raiseIn5Mins:
 		door->direction = 1;
 		door->type = normal;
-		S_StartSound((mobj_t *)&door->sector->soundorg,
-			     sfx_doropn);
+		P_SectorSound (door->sector, sfx_doropn);
 		break;
 		
 	      default:
@@ -128,8 +124,7 @@ void T_VerticalDoor (vldoor_t* door)
 	      case blazeClose:
 		door->sector->specialdata = NULL;
 		P_RemoveThinker (&door->thinker);  // unlink and free
-		S_StartSound((mobj_t *)&door->sector->soundorg,
-			     sfx_bdcls);
+		P_SectorSound (door->sector, sfx_bdcls);
 		break;
 		
 	      case normal:
@@ -157,8 +152,7 @@ void T_VerticalDoor (vldoor_t* door)
 		
 	      default:
 		door->direction = 1;
-		S_StartSound((mobj_t *)&door->sector->soundorg,
-			     sfx_doropn);
+		P_SectorSound (door->sector, sfx_doropn);
 		break;
 	    }
 	}
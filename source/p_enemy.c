@@ -109,6 +109,7 @@ P_RecursiveSound
     int		i;
     line_t*	check;
     sector_t*	other;
+    mobj_t*	mo;
 	
     // wake up all monsters in this sector
     if (sec->validcount == validcount
@@ -120,6 +121,10 @@ P_RecursiveSound
     sec->validcount = validcount;
     sec->soundtraversed = soundblocks+1;
     sec->soundtarget = soundtarget;
+
+    for (mo = sec->thinglist ; mo ; mo = mo->snext)
+	if (mo->thinker.activity == ta_sleeping)
+	    P_WakeThinker (&mo->thinker);
 	
     for (i=0 ;i<sec->linecount ; i++)
     {
@@ -663,6 +668,54 @@ void A_Look (mobj_t* actor)
 }
 
 
+//
+// P_CatchUpSleeper
+// Counts a sleeping monster down its A_Look states up to and
+// with tic, as P_MobjThinker would have, but without looking.
+// Returns false if it came to a state that is not a look,
+// which is left for P_MobjThinker to enter on its next run.
+//
+boolean P_CatchUpSleeper (mobj_t* actor, int tic)
+{
+    state_t*	st;
+
+    actor->tics -= tic - actor->sleeptic;
+    actor->sleeptic = tic;
+
+    while (actor->tics <= 0)
+    {
+	st = &states[actor->state->nextstate];
+	if (st->action.acp1 != (actionf_p1)A_Look || st->tics <= 0)
+	{
+	    actor->tics = 1;
+	    return false;
+	}
+
+	actor->state = st;
+	actor->tics += st->tics;
+	actor->sprite = st->sprite;
+	actor->frame = st->frame;
+    }
+
+    return true;
+}
+
+
+//
+// P_SleepThinker
+// Run by P_RunThinkers for a sleeping monster, before the active
+// thinkers, in place of the last SLEEPTICS tics of P_MobjThinker.
+// It only looks once.
+//
+void P_SleepThinker (mobj_t* actor)
+{
+    if (P_CatchUpSleeper (actor, leveltime-1))
+	A_Look (actor);
+    else
+	P_WakeThinker (&actor->thinker);
+}
+
+
 //
 // A_Chase
 // Actor has a melee attack,
@@ -1197,7 +1250,7 @@ void A_VileChase (mobj_t* actor)
 		// Call PIT_VileCheck to check
 		// whether object is a corpse
 		// that canbe raised.
-		if (!P_BlockThingsIterator(bx,by,PIT_VileCheck))
+		if (!P_BlockCorpsesIterator(bx,by,PIT_VileCheck))
 		{
 		    // got one!
 		    temp = actor->target;
@@ -215,8 +215,7 @@ void T_MoveFloor(floormove_t* floor)
 		      floor->crush,0,floor->direction);
     
     if (!(leveltime&7))
-	S_StartSound((mobj_t *)&floor->sector->soundorg,
-		     sfx_stnmov);
+	P_SectorSound (floor->sector, sfx_stnmov);
     
     if (res == pastdest)
     {
@@ -246,8 +245,7 @@ void T_MoveFloor(floormove_t* floor)
 	}
 	P_RemoveThinker(&floor->thinker);
 
-	S_StartSound((mobj_t *)&floor->sector->soundorg,
-		     sfx_pstop);
+	P_SectorSound (floor->sector, sfx_pstop);
     }
 
 }
@@ -0,0 +1,187 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//	Checksums of the play simulation state.
+//
+//	FNV-1a over the values themselves, never over pointers or
+//	padding, so the result is the same on every platform.
+//
+//-----------------------------------------------------------------------------
+
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "p_local.h"
+#include "r_state.h"
+
+#include "p_hash.h"
+
+
+extern int	prndindex;
+
+#define FNV_OFFSET	2166136261u
+#define FNV_PRIME	16777619u
+
+static uint32_t	hash;
+
+static void P_HashInt (int value)
+{
+    int		i;
+
+    for (i=0 ; i<4 ; i++)
+    {
+	hash ^= (value >> (i*8)) & 0xff;
+	hash *= FNV_PRIME;
+    }
+}
+
+
+static void P_HashMobj (mobj_t* mo)
+{
+    P_HashInt (mo->type);
+    P_HashInt (mo->x);
+    P_HashInt (mo->y);
+    P_HashInt (mo->z);
+    P_HashInt (mo->angle);
+    P_HashInt (mo->momx);
+    P_HashInt (mo->momy);
+    P_HashInt (mo->momz);
+    P_HashInt (mo->health);
+    P_HashInt (mo->state - states);
+    P_HashInt (mo->tics);
+    P_HashInt (mo->flags);
+    P_HashInt (mo->movedir);
+    P_HashInt (mo->movecount);
+    P_HashInt (mo->reactiontime);
+    P_HashInt (mo->threshold);
+}
+
+
+static void P_HashPlayer (player_t* p)
+{
+    int		i;
+
+    P_HashInt (p->playerstate);
+    P_HashInt (p->viewz);
+    P_HashInt (p->health);
+    P_HashInt (p->armorpoints);
+    P_HashInt (p->armortype);
+    P_HashInt (p->readyweapon);
+    P_HashInt (p->pendingweapon);
+    P_HashInt (p->killcount);
+    P_HashInt (p->itemcount);
+    P_HashInt (p->secretcount);
+
+    for (i=0 ; i<NUMPOWERS ; i++)
+	P_HashInt (p->powers[i]);
+    for (i=0 ; i<NUMAMMO ; i++)
+	P_HashInt (p->ammo[i]);
+    for (i=0 ; i<NUMWEAPONS ; i++)
+	P_HashInt (p->weaponowned[i]);
+}
+
+
+//
+// P_HashWorldParts
+//
+int P_HashWorldParts (worldhash_t* wh, thinghash_t* things, int maxthings)
+{
+    thinker_t*	th;
+    sector_t*	sec;
+    mobj_t*	mo;
+    thinghash_t* t;
+    uint32_t	thingshash;
+    int		numthings;
+    int		i;
+
+    wh->rng = prndindex;
+
+    hash = FNV_OFFSET;
+    for (i=0 ; i<MAXPLAYERS ; i++)
+	if (playeringame[i])
+	    P_HashPlayer (&players[i]);
+    wh->players = hash;
+
+    hash = FNV_OFFSET;
+    for (i=0, sec=sectors ; i<numsectors ; i++, sec++)
+    {
+	P_HashInt (sec->floorheight);
+	P_HashInt (sec->ceilingheight);
+	P_HashInt (sec->lightlevel);
+	P_HashInt (sec->special);
+    }
+    wh->sectors = hash;
+
+    // each thing is hashed alone, then the thing hashes in order
+    thingshash = FNV_OFFSET;
+    numthings = 0;
+    for (th = thinkercap.next ; th != &thinkercap ; th = th->next)
+    {
+	if (th->function.acp1 != (actionf_p1)P_MobjThinker)
+	    continue;
+
+	mo = (mobj_t*)th;
+	hash = FNV_OFFSET;
+	P_HashMobj (mo);
+
+	if (numthings < maxthings)
+	{
+	    t = &things[numthings];
+	    t->type = mo->type;
+	    t->state = mo->state - states;
+	    t->x = mo->x;
+	    t->y = mo->y;
+	    t->z = mo->z;
+	    t->momx = mo->momx;
+	    t->momy = mo->momy;
+	    t->momz = mo->momz;
+	    t->health = mo->health;
+	    t->hash = hash;
+	}
+	numthings++;
+
+	thingshash ^= hash;
+	thingshash *= FNV_PRIME;
+    }
+    wh->things = thingshash;
+
+    hash = FNV_OFFSET;
+    P_HashInt (leveltime);
+    P_HashInt (wh->rng);
+    P_HashInt (wh->players);
+    P_HashInt (wh->sectors);
+    P_HashInt (wh->things);
+    wh->world = hash;
+
+    return numthings;
+}
+
+
+//
+// P_HashWorld
+//
+uint32_t P_HashWorld (void)
+{
+    worldhash_t	wh;
+
+    P_HashWorldParts (&wh, NULL, 0);
+    return wh.world;
+}
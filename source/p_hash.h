@@ -0,0 +1,67 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//	Checksums of the play simulation state.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __P_HASH__
+#define __P_HASH__
+
+#include "doomtype.h"
+#include "m_fixed.h"
+
+// The parts of the world hash, so a mismatch can be narrowed down.
+typedef struct
+{
+    uint32_t	world;		// leveltime and all of the below
+    uint32_t	rng;		// P_Random index
+    uint32_t	players;
+    uint32_t	sectors;
+    uint32_t	things;
+} worldhash_t;
+
+// One thing, in thinker list order, with the fields
+// worth showing when it differs.
+typedef struct
+{
+    int		type;
+    int		state;
+    fixed_t	x;
+    fixed_t	y;
+    fixed_t	z;
+    fixed_t	momx;
+    fixed_t	momy;
+    fixed_t	momz;
+    int		health;
+    uint32_t	hash;		// of every field P_HashWorld covers
+} thinghash_t;
+
+// Hash of everything that must match between two runs of
+// the same demo: things, sectors, players and the RNG.
+uint32_t P_HashWorld (void);
+
+// Fills in wh and, up to maxthings, one thinghash_t per thing.
+// Returns the number of things, which may be more than maxthings.
+int P_HashWorldParts (worldhash_t* wh, thinghash_t* things, int maxthings);
+
+#endif
@@ -677,6 +677,7 @@ P_KillMobj
 
     target->flags |= MF_CORPSE|MF_DROPOFF;
     target->height >>= 2;
+    P_MarkCorpse (target);
 
     if (source && source->player)
     {
@@ -788,6 +789,8 @@ P_DamageMobj
     if (target->health <= 0)
 	return;
 
+    P_WakeThinker (&target->thinker);
+
     if ( target->flags & MF_SKULLFLY )
     {
 	target->momx = target->momy = target->momz = 0;
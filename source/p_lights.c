@@ -234,31 +234,15 @@ void EV_StartLightStrobing(line_t*	line)
 //
 void EV_TurnTagLightsOff(line_t* line)
 {
-    int			i;
-    int			j;
-    int			min;
+    int			secnum;
     sector_t*		sector;
-    sector_t*		tsec;
-    line_t*		templine;
 	
-    sector = sectors;
-    
-    for (j = 0;j < numsectors; j++, sector++)
+    secnum = -1;
+    while ((secnum = P_FindSectorFromLineTag(line,secnum)) >= 0)
     {
-	if (sector->tag == line->tag)
-	{
-	    min = sector->lightlevel;
-	    for (i = 0;i < sector->linecount; i++)
-	    {
-		templine = sector->lines[i];
-		tsec = getNextSector(templine,sector);
-		if (!tsec)
-		    continue;
-		if (tsec->lightlevel < min)
-		    min = tsec->lightlevel;
-	    }
-	    sector->lightlevel = min;
-	}
+	sector = &sectors[secnum];
+	sector->lightlevel = P_FindMinSurroundingLight (sector,
+							sector->lightlevel);
     }
 }
 
@@ -271,37 +255,30 @@ EV_LightTurnOn
 ( line_t*	line,
   int		bright )
 {
-    int		i;
+    int		secnum;
     int		j;
     sector_t*	sector;
     sector_t*	temp;
-    line_t*	templine;
-	
-    sector = sectors;
 	
-    for (i=0;i<numsectors;i++, sector++)
+    secnum = -1;
+    while ((secnum = P_FindSectorFromLineTag(line,secnum)) >= 0)
     {
-	if (sector->tag == line->tag)
+	sector = &sectors[secnum];
+
+	// bright = 0 means to search
+	// for highest light level
+	// surrounding sector
+	if (!bright)
 	{
-	    // bright = 0 means to search
-	    // for highest light level
-	    // surrounding sector
-	    if (!bright)
+	    for (j = 0;j < sector->neighbourcount; j++)
 	    {
-		for (j = 0;j < sector->linecount; j++)
-		{
-		    templine = sector->lines[j];
-		    temp = getNextSector(templine,sector);
-
-		    if (!temp)
-			continue;
+		temp = sector->neighbours[j];
 
-		    if (temp->lightlevel > bright)
-			bright = temp->lightlevel;
-		}
+		if (temp->lightlevel > bright)
+		    bright = temp->lightlevel;
 	    }
-	    sector-> lightlevel = bright;
 	}
+	sector-> lightlevel = bright;
     }
 }
 
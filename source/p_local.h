@@ -74,9 +74,27 @@
 extern	thinker_t	thinkercap;	
 
 
+// sleeping monsters are run once every SLEEPTICS tics
+#define SLEEPTICS		8
+
+// with -nodormant every thinker is run every tic
+extern boolean	nodormant;
+
+// set while sector specials run on several threads at once,
+// and with -serialspecials they are run one at a time
+extern boolean	threadedspecials;
+extern boolean	serialspecials;
+
 void P_InitThinkers (void);
 void P_AddThinker (thinker_t* thinker);
 void P_RemoveThinker (thinker_t* thinker);
+void P_WakeThinker (thinker_t* thinker);
+void P_WakeSleepers (void);
+
+// What a sector special does outside its sector, held back
+// until its batch is done while threadedspecials is set.
+void P_SectorSound (sector_t* sec, int sfx);
+void P_DeferSpecial (sector_t* sec, actionf_p1 func, void* arg);
 
 
 //
@@ -92,6 +110,14 @@ void P_DropWeapon (player_t* player);
 //
 void	P_PlayerThink (player_t* player);
 
+// Set while the console player is moved on ahead of the game,
+// see P_StartPrediction. Nothing may be triggered meanwhile.
+extern boolean	predicting;
+
+void	P_StartPrediction (player_t* player);
+void	P_PredictPlayer (player_t* player, ticcmd_t* cmd);
+void	P_EndPrediction (player_t* player);
+
 
 //
 // P_MOBJ
@@ -120,6 +146,9 @@ P_SpawnMobj
 void 	P_RemoveMobj (mobj_t* th);
 boolean	P_SetMobjState (mobj_t* mobj, statenum_t state);
 void 	P_MobjThinker (mobj_t* mobj);
+thinkactivity_t P_MobjActivity (mobj_t* mobj);
+void	P_XYMovement (mobj_t* mo);
+void	P_ZMovement (mobj_t* mo);
 
 void	P_SpawnPuff (fixed_t x, fixed_t y, fixed_t z);
 void 	P_SpawnBlood (fixed_t x, fixed_t y, fixed_t z, int damage);
@@ -131,6 +160,8 @@ void	P_SpawnPlayerMissile (mobj_t* source, mobjtype_t type);
 // P_ENEMY
 //
 void P_NoiseAlert (mobj_t* target, mobj_t* emmiter);
+void P_SleepThinker (mobj_t* actor);
+boolean P_CatchUpSleeper (mobj_t* actor, int tic);
 
 
 //
@@ -155,10 +186,28 @@ typedef struct
     }			d;
 } intercept_t;
 
+// what the original array held, and with -interceptlimit
+// the most a trace keeps
 #define MAXINTERCEPTS	128
 
-extern intercept_t	intercepts[MAXINTERCEPTS];
+// The ids of the things in a block, the last one put in last.
+// The corpses among them are kept in the same order too, with
+// perhaps some raised since.
+typedef struct
+{
+    unsigned short*	ids;
+    int			count;
+    int			max;
+
+    unsigned short*	corpses;
+    int			numcorpses;
+    int			maxcorpses;
+
+} blockthings_t;
+
+extern intercept_t*	intercepts;
 extern intercept_t*	intercept_p;
+extern boolean		interceptlimit;
 
 typedef boolean (*traverser_t) (intercept_t *in);
 
@@ -178,6 +227,16 @@ void 	P_LineOpening (line_t* linedef);
 
 boolean P_BlockLinesIterator (int x, int y, boolean(*func)(line_t*) );
 boolean P_BlockThingsIterator (int x, int y, boolean(*func)(mobj_t*) );
+boolean P_BlockCorpsesIterator (int x, int y, boolean(*func)(mobj_t*) );
+
+boolean
+P_BlockThingsNear
+( int		x,
+  int		y,
+  fixed_t	cx,
+  fixed_t	cy,
+  fixed_t	range,
+  boolean	(*func)(mobj_t*) );
 
 #define PT_ADDLINES		1
 #define PT_ADDTHINGS	2
@@ -197,6 +256,34 @@ P_PathTraverse
 void P_UnsetThingPosition (mobj_t* thing);
 void P_SetThingPosition (mobj_t* thing);
 
+// Things by id. The fields the block sweeps test are kept
+// by id too, from when the thing was last put in a block.
+extern mobj_t**	mobjbyid;
+extern fixed_t*	mobjx;
+extern fixed_t*	mobjy;
+extern fixed_t*	mobjradius;
+
+void P_InitMobjIds (void);
+void P_NewMobjId (mobj_t* mobj);
+void P_FreeMobjId (mobj_t* mobj);
+
+void P_LinkBlockThing (blockthings_t* block, int index, mobj_t* thing);
+
+// Call when a thing in the blocks has become a corpse.
+void P_MarkCorpse (mobj_t* thing);
+
+void P_InitSecNodes (void);
+void P_KeepSecNodes (void);
+void P_AddSecNodes (mobj_t* thing);
+void P_DelSecNodes (mobj_t* thing);
+
+// The next node of a sector list being walked, moved on by
+// P_DelSecNodes when that node is unlinked.
+extern msecnode_t*	secnodecursor;
+
+// set once P_KeepSecNodes has started the lists for the level
+extern boolean		touchlists;
+
 
 //
 // P_MAP
@@ -216,8 +303,14 @@ boolean P_TryMove (mobj_t* thing, fixed_t x, fixed_t y);
 boolean P_TeleportMove (mobj_t* thing, fixed_t x, fixed_t y);
 void	P_SlideMove (mobj_t* mo);
 boolean P_CheckSight (mobj_t* t1, mobj_t* t2);
+void	P_InitSightCache (void);
 void 	P_UseLines (player_t* player);
 
+extern boolean	blocksweep;
+
+// counts the floors and ceilings moved
+extern int	heightchanges;
+
 boolean P_ChangeSector (sector_t* sector, boolean crunch);
 
 extern mobj_t*	linetarget;	// who got hit (or NULL)
@@ -254,7 +347,7 @@ extern int		bmapwidth;
 extern int		bmapheight;	// in mapblocks
 extern fixed_t		bmaporgx;
 extern fixed_t		bmaporgy;	// origin of block map
-extern mobj_t**		blocklinks;	// for thing chains
+extern blockthings_t*	blockthings;	// for thing lists
 
 
 
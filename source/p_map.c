@@ -28,6 +28,7 @@
 
 #include "m_bbox.h"
 #include "m_random.h"
+#include "m_prof.h"
 #include "i_system.h"
 
 #include "doomdef.h"
@@ -158,7 +159,7 @@ P_TeleportMove
 
     for (bx=xl ; bx<=xh ; bx++)
 	for (by=yl ; by<=yh ; by++)
-	    if (!P_BlockThingsIterator(bx,by,PIT_StompThing))
+	    if (!P_BlockThingsNear(bx,by,x,y,tmthing->radius,PIT_StompThing))
 		return false;
     
     // the move is ok,
@@ -330,7 +331,7 @@ boolean PIT_CheckThing (mobj_t* thing)
     if (thing->flags & MF_SPECIAL)
     {
 	solid = thing->flags&MF_SOLID;
-	if (tmflags&MF_PICKUP)
+	if ((tmflags&MF_PICKUP) && !predicting)
 	{
 	    // can remove thing
 	    P_TouchSpecialThing (thing, tmthing);
@@ -423,7 +424,8 @@ P_CheckPosition
 
     for (bx=xl ; bx<=xh ; bx++)
 	for (by=yl ; by<=yh ; by++)
-	    if (!P_BlockThingsIterator(bx,by,PIT_CheckThing))
+	    if (!P_BlockThingsNear(bx,by,tmx,tmy,tmthing->radius,
+				   PIT_CheckThing))
 		return false;
     
     // check lines
@@ -446,8 +448,8 @@ P_CheckPosition
 // Attempt to move to a new position,
 // crossing special lines unless MF_TELEPORT is set.
 //
-boolean
-P_TryMove
+static boolean
+P_DoTryMove
 ( mobj_t*	thing,
   fixed_t	x,
   fixed_t	y )
@@ -496,7 +498,7 @@ P_TryMove
     P_SetThingPosition (thing);
     
     // if any special lines were hit, do the effect
-    if (! (thing->flags&(MF_TELEPORT|MF_NOCLIP)) )
+    if (! (thing->flags&(MF_TELEPORT|MF_NOCLIP)) && !predicting)
     {
 	while (numspechit--)
 	{
@@ -515,6 +517,21 @@ P_TryMove
     return true;
 }
 
+boolean
+P_TryMove
+( mobj_t*	thing,
+  fixed_t	x,
+  fixed_t	y )
+{
+    boolean	moved;
+
+    PROF_BEGIN (pz_trymove);
+    moved = P_DoTryMove (thing, x, y);
+    PROF_END (pz_trymove);
+
+    return moved;
+}
+
 
 //
 // P_ThingHeightClip
@@ -531,6 +548,8 @@ boolean P_ThingHeightClip (mobj_t* thing)
     boolean		onfloor;
 	
     onfloor = (thing->z == thing->floorz);
+
+    P_WakeThinker (&thing->thinker);
 	
     P_CheckPosition (thing, thing->x, thing->y);	
     // what about stranding a monster partially off an edge?
@@ -1228,7 +1247,8 @@ P_RadiusAttack
 	
     for (y=yl ; y<=yh ; y++)
 	for (x=xl ; x<=xh ; x++)
-	    P_BlockThingsIterator (x, y, PIT_RadiusAttack );
+	    P_BlockThingsNear (x, y, spot->x, spot->y, damage<<FRACBITS,
+			       PIT_RadiusAttack );
 }
 
 
@@ -1249,6 +1269,13 @@ P_RadiusAttack
 boolean		crushchange;
 boolean		nofit;
 
+// Sweep the blockmap around the sector for the things in it, as
+// the original did. The order things are crushed in changes what
+// the random numbers go to, so demos and net games keep to it.
+boolean		blocksweep;
+
+int		heightchanges;
+
 
 //
 // PIT_ChangeSector
@@ -1272,6 +1299,7 @@ boolean PIT_ChangeSector (mobj_t*	thing)
 	thing->flags &= ~MF_SOLID;
 	thing->height = 0;
 	thing->radius = 0;
+	mobjradius[thing->id] = 0;
 
 	// keep checking
 	return true;		
@@ -1323,15 +1351,37 @@ P_ChangeSector
 {
     int		x;
     int		y;
+    msecnode_t*	node;
+
+    // only sectors nothing touches are moved on several
+    // threads, and P_RunThinkers counts their changes
+    if (threadedspecials)
+	return false;
 	
     nofit = false;
     crushchange = crunch;
-	
-    // re-check heights for all things near the moving sector
-    for (x=sector->blockbox[BOXLEFT] ; x<= sector->blockbox[BOXRIGHT] ; x++)
-	for (y=sector->blockbox[BOXBOTTOM];y<= sector->blockbox[BOXTOP] ; y++)
-	    P_BlockThingsIterator (x, y, PIT_ChangeSector);
-	
+    heightchanges++;
+
+    if (!touchlists || blocksweep
+	|| demoplayback || demorecording || netgame)
+    {
+	// re-check heights for all things near the moving sector
+	for (x=sector->blockbox[BOXLEFT] ; x<= sector->blockbox[BOXRIGHT] ; x++)
+	    for (y=sector->blockbox[BOXBOTTOM];y<= sector->blockbox[BOXTOP] ; y++)
+		P_BlockThingsIterator (x, y, PIT_ChangeSector);
+
+	return nofit;
+    }
+
+    // re-check heights for the things touching the sector; the
+    // cursor is moved on if crushing one unlinks the next, and
+    // things spawned meanwhile go in at the head, already passed
+    for (node = sector->touchlist ; node ; node = secnodecursor)
+    {
+	secnodecursor = node->snext;
+	PIT_ChangeSector (node->thing);
+    }
+    secnodecursor = NULL;
 	
     return nofit;
 }
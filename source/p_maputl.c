@@ -27,11 +27,14 @@
 //-----------------------------------------------------------------------------
 
 #include <stdlib.h>
+#include <string.h>
 
 
 #include "m_bbox.h"
 
 #include "doomdef.h"
+#include "i_system.h"
+#include "z_zone.h"
 #include "p_local.h"
 
 
@@ -335,6 +338,444 @@ void P_LineOpening (line_t* linedef)
 //
 
 
+//
+// SECTOR TOUCHING LISTS
+//
+
+// nodes let go of, reused before allocating more
+static msecnode_t*	freesecnodes;
+
+msecnode_t*		secnodecursor;
+
+boolean			touchlists;
+
+
+//
+// P_InitSecNodes
+// The nodes of the last level went with its zone memory.
+//
+void P_InitSecNodes (void)
+{
+    freesecnodes = NULL;
+    secnodecursor = NULL;
+    touchlists = false;
+}
+
+
+//
+// P_KeepSecNodes
+// Demos and net games never read the lists, and a demo is only
+// known to be playing once its level is set up, so the lists are
+// started on the first tic that uses them. Links every thing
+// already in the blocks.
+//
+void P_KeepSecNodes (void)
+{
+    thinker_t*	th;
+    mobj_t*	mo;
+
+    if (touchlists)
+	return;
+    touchlists = true;
+
+    for (th = thinkercap.next ; th != &thinkercap ; th = th->next)
+    {
+	if (th->function.acp1 != (actionf_p1)P_MobjThinker)
+	    continue;
+
+	mo = (mobj_t *)th;
+	if (! (mo->flags & MF_NOBLOCKMAP) )
+	    P_AddSecNodes (mo);
+    }
+}
+
+
+//
+// P_AddSecNode
+// Links the thing to the sector, unless it already is.
+//
+static void P_AddSecNode (mobj_t* thing, sector_t* sec)
+{
+    msecnode_t*	node;
+
+    for (node = thing->touchlist ; node ; node = node->tnext)
+	if (node->sector == sec)
+	    return;
+
+    node = freesecnodes;
+    if (node)
+	freesecnodes = node->tnext;
+    else
+	node = Z_Malloc (sizeof(*node), PU_LEVEL, 0);
+
+    node->sector = sec;
+    node->thing = thing;
+
+    node->tnext = thing->touchlist;
+    thing->touchlist = node;
+
+    node->sprev = NULL;
+    node->snext = sec->touchlist;
+    if (sec->touchlist)
+	sec->touchlist->sprev = node;
+    sec->touchlist = node;
+}
+
+
+//
+// P_DelSecNodes
+// Unlinks the thing from all the sectors it touches.
+//
+void P_DelSecNodes (mobj_t* thing)
+{
+    msecnode_t*	node;
+    msecnode_t*	next;
+
+    for (node = thing->touchlist ; node ; node = next)
+    {
+	next = node->tnext;
+
+	if (node == secnodecursor)
+	    secnodecursor = node->snext;
+
+	if (node->snext)
+	    node->snext->sprev = node->sprev;
+
+	if (node->sprev)
+	    node->sprev->snext = node->snext;
+	else
+	    node->sector->touchlist = node->snext;
+
+	node->tnext = freesecnodes;
+	freesecnodes = node;
+    }
+    thing->touchlist = NULL;
+}
+
+
+//
+// P_AddSecNodes
+// Links the thing to its own sector and the sectors on
+// both sides of every line crossing its bounding box.
+// Walks the blockmap itself instead of using validcount,
+// as a thing can be linked in the middle of an iteration.
+//
+void P_AddSecNodes (mobj_t* thing)
+{
+    fixed_t	bbox[4];
+    int		xl;
+    int		xh;
+    int		yl;
+    int		yh;
+    int		bx;
+    int		by;
+    short*	list;
+    line_t*	ld;
+
+    P_AddSecNode (thing, thing->subsector->sector);
+
+    bbox[BOXTOP] = thing->y + thing->radius;
+    bbox[BOXBOTTOM] = thing->y - thing->radius;
+    bbox[BOXRIGHT] = thing->x + thing->radius;
+    bbox[BOXLEFT] = thing->x - thing->radius;
+
+    xl = (bbox[BOXLEFT] - bmaporgx)>>MAPBLOCKSHIFT;
+    xh = (bbox[BOXRIGHT] - bmaporgx)>>MAPBLOCKSHIFT;
+    yl = (bbox[BOXBOTTOM] - bmaporgy)>>MAPBLOCKSHIFT;
+    yh = (bbox[BOXTOP] - bmaporgy)>>MAPBLOCKSHIFT;
+
+    if (xl < 0)
+	xl = 0;
+    if (yl < 0)
+	yl = 0;
+    if (xh >= bmapwidth)
+	xh = bmapwidth-1;
+    if (yh >= bmapheight)
+	yh = bmapheight-1;
+
+    for (by=yl ; by<=yh ; by++)
+	for (bx=xl ; bx<=xh ; bx++)
+	{
+	    for (list = blockmaplump+blockmap[by*bmapwidth+bx] ;
+		 *list != -1 ;
+		 list++)
+	    {
+		ld = &lines[*list];
+
+		if (bbox[BOXRIGHT] <= ld->bbox[BOXLEFT]
+		    || bbox[BOXLEFT] >= ld->bbox[BOXRIGHT]
+		    || bbox[BOXTOP] <= ld->bbox[BOXBOTTOM]
+		    || bbox[BOXBOTTOM] >= ld->bbox[BOXTOP])
+		    continue;
+
+		if (P_BoxOnLineSide (bbox, ld) != -1)
+		    continue;
+
+		P_AddSecNode (thing, ld->frontsector);
+		if (ld->backsector)
+		    P_AddSecNode (thing, ld->backsector);
+	    }
+	}
+}
+
+
+//
+// THING IDS
+// The blocks hold things by id. What the block sweeps test
+// first is kept by id in arrays of its own, so a sweep only
+// reads the things it comes near. The copies are made when a
+// thing is put in a block, which is the only time its x and y
+// change, and when a thing in a block is given a new radius.
+//
+#define MAXMOBJIDS	65536
+
+mobj_t**	mobjbyid;
+fixed_t*	mobjx;
+fixed_t*	mobjy;
+fixed_t*	mobjradius;
+
+static int	nummobjids;	// handed out, with those freed
+static int	maxmobjids;
+static int*	freemobjids;
+static int	numfreemobjids;
+
+// A block sweep in progress, kept in step
+// with things taken out of its block.
+typedef struct blockiter_s
+{
+    blockthings_t*	block;
+    int			next;	// index of the next thing to visit
+    struct blockiter_s*	up;
+
+} blockiter_t;
+
+static blockiter_t*	blockiters;
+
+
+//
+// P_InitMobjIds
+// Forgets all the ids, for a new set of things.
+//
+void P_InitMobjIds (void)
+{
+    nummobjids = 0;
+    numfreemobjids = 0;
+    blockiters = NULL;
+}
+
+
+static void*
+P_GrowArray
+( void*		old,
+  int		oldsize,
+  int		size,
+  int		tag )
+{
+    void*	array;
+
+    array = Z_Malloc (size, tag, 0);
+    if (old)
+    {
+	memcpy (array, old, oldsize);
+	Z_Free (old);
+    }
+    return array;
+}
+
+
+//
+// P_NewMobjId
+//
+void P_NewMobjId (mobj_t* mobj)
+{
+    int		max;
+    int		id;
+
+    if (numfreemobjids)
+	id = freemobjids[--numfreemobjids];
+    else
+    {
+	if (nummobjids == maxmobjids)
+	{
+	    if (maxmobjids == MAXMOBJIDS)
+		I_Error ("P_NewMobjId: more than %i things", MAXMOBJIDS);
+
+	    max = maxmobjids ? maxmobjids*2 : 1024;
+	    mobjbyid = P_GrowArray (mobjbyid, maxmobjids*sizeof(*mobjbyid),
+				    max*sizeof(*mobjbyid), PU_STATIC);
+	    mobjx = P_GrowArray (mobjx, maxmobjids*sizeof(*mobjx),
+				 max*sizeof(*mobjx), PU_STATIC);
+	    mobjy = P_GrowArray (mobjy, maxmobjids*sizeof(*mobjy),
+				 max*sizeof(*mobjy), PU_STATIC);
+	    mobjradius = P_GrowArray (mobjradius,
+				      maxmobjids*sizeof(*mobjradius),
+				      max*sizeof(*mobjradius), PU_STATIC);
+	    freemobjids = P_GrowArray (freemobjids,
+				       maxmobjids*sizeof(*freemobjids),
+				       max*sizeof(*freemobjids), PU_STATIC);
+	    maxmobjids = max;
+	}
+	id = nummobjids++;
+    }
+
+    mobj->id = id;
+    mobjbyid[id] = mobj;
+}
+
+
+//
+// P_FreeMobjId
+// The thing must be out of the blocks.
+//
+void P_FreeMobjId (mobj_t* mobj)
+{
+    mobjbyid[mobj->id] = NULL;
+    freemobjids[numfreemobjids++] = mobj->id;
+}
+
+
+//
+// P_AddCorpse
+//
+static void
+P_AddCorpse
+( blockthings_t*	block,
+  int			id )
+{
+    if (block->numcorpses == block->maxcorpses)
+    {
+	block->maxcorpses = block->maxcorpses ? block->maxcorpses*2 : 4;
+	block->corpses = P_GrowArray (block->corpses,
+				      block->numcorpses*sizeof(*block->corpses),
+				      block->maxcorpses*sizeof(*block->corpses),
+				      PU_LEVEL);
+    }
+    block->corpses[block->numcorpses++] = id;
+}
+
+
+//
+// P_FindCorpses
+// Lists the corpses of a block over again, in its order.
+//
+static void P_FindCorpses (blockthings_t* block)
+{
+    int		i;
+
+    block->numcorpses = 0;
+    for (i=0 ; i<block->count ; i++)
+	if (mobjbyid[block->ids[i]]->flags & MF_CORPSE)
+	    P_AddCorpse (block, block->ids[i]);
+}
+
+
+//
+// P_MarkCorpse
+//
+void P_MarkCorpse (mobj_t* thing)
+{
+    int		blockx;
+    int		blocky;
+
+    if (thing->flags & MF_NOBLOCKMAP)
+	return;
+
+    blockx = (thing->x - bmaporgx)>>MAPBLOCKSHIFT;
+    blocky = (thing->y - bmaporgy)>>MAPBLOCKSHIFT;
+
+    if (blockx>=0 && blockx < bmapwidth
+	&& blocky>=0 && blocky <bmapheight)
+    {
+	P_FindCorpses (&blockthings[blocky*bmapwidth+blockx]);
+    }
+}
+
+
+//
+// P_LinkBlockThing
+// Puts a thing in a block at index, counted from the first
+// put in, and copies the fields sweeps test.
+//
+void
+P_LinkBlockThing
+( blockthings_t*	block,
+  int			index,
+  mobj_t*		thing )
+{
+    blockiter_t*	it;
+
+    if (block->count == block->max)
+    {
+	block->max = block->max ? block->max*2 : 4;
+	block->ids = P_GrowArray (block->ids,
+				  block->count*sizeof(*block->ids),
+				  block->max*sizeof(*block->ids), PU_LEVEL);
+    }
+
+    memmove (block->ids+index+1, block->ids+index,
+	     (block->count-index)*sizeof(*block->ids));
+    block->ids[index] = thing->id;
+    block->count++;
+
+    for (it = blockiters ; it ; it = it->up)
+	if (it->block == block && index <= it->next)
+	    it->next++;
+
+    mobjx[thing->id] = thing->x;
+    mobjy[thing->id] = thing->y;
+    mobjradius[thing->id] = thing->radius;
+
+    if (thing->flags & MF_CORPSE)
+    {
+	if (index == block->count-1)
+	    P_AddCorpse (block, thing->id);
+	else
+	    P_FindCorpses (block);
+    }
+}
+
+
+//
+// P_UnlinkBlockThing
+// Takes a thing out of a block. Sweeps of the block go on
+// as they would have through the original linked lists.
+//
+static void
+P_UnlinkBlockThing
+( blockthings_t*	block,
+  mobj_t*		thing )
+{
+    blockiter_t*	it;
+    int			index;
+
+    for (index = block->count-1 ; index >= 0 ; index--)
+	if (block->ids[index] == thing->id)
+	    break;
+
+    if (index < 0)
+	return;
+
+    block->count--;
+    memmove (block->ids+index, block->ids+index+1,
+	     (block->count-index)*sizeof(*block->ids));
+
+    for (it = blockiters ; it ; it = it->up)
+	if (it->block == block && index <= it->next)
+	    it->next--;
+
+    for (index = 0 ; index < block->numcorpses ; index++)
+    {
+	if (block->corpses[index] == thing->id)
+	{
+	    block->numcorpses--;
+	    memmove (block->corpses+index, block->corpses+index+1,
+		     (block->numcorpses-index)*sizeof(*block->corpses));
+	    break;
+	}
+    }
+}
+
+
 //
 // P_UnsetThingPosition
 // Unlinks a thing from block map and sectors.
@@ -347,6 +788,10 @@ void P_UnsetThingPosition (mobj_t* thing)
     int		blockx;
     int		blocky;
 
+    // a predicted move is taken back without touching the lists
+    if (thing->touchlist && !predicting)
+	P_DelSecNodes (thing);
+
     if ( ! (thing->flags & MF_NOSECTOR) )
     {
 	// inert things don't need to be in blockmap?
@@ -364,21 +809,13 @@ void P_UnsetThingPosition (mobj_t* thing)
     {
 	// inert things don't need to be in blockmap
 	// unlink from block map
-	if (thing->bnext)
-	    thing->bnext->bprev = thing->bprev;
-	
-	if (thing->bprev)
-	    thing->bprev->bnext = thing->bnext;
-	else
-	{
-	    blockx = (thing->x - bmaporgx)>>MAPBLOCKSHIFT;
-	    blocky = (thing->y - bmaporgy)>>MAPBLOCKSHIFT;
+	blockx = (thing->x - bmaporgx)>>MAPBLOCKSHIFT;
+	blocky = (thing->y - bmaporgy)>>MAPBLOCKSHIFT;
 
-	    if (blockx>=0 && blockx < bmapwidth
-		&& blocky>=0 && blocky <bmapheight)
-	    {
-		blocklinks[blocky*bmapwidth+blockx] = thing->bnext;
-	    }
+	if (blockx>=0 && blockx < bmapwidth
+	    && blocky>=0 && blocky <bmapheight)
+	{
+	    P_UnlinkBlockThing (&blockthings[blocky*bmapwidth+blockx], thing);
 	}
     }
 }
@@ -397,7 +834,7 @@ P_SetThingPosition (mobj_t* thing)
     sector_t*		sec;
     int			blockx;
     int			blocky;
-    mobj_t**		link;
+    blockthings_t*	block;
 
     
     // link into subsector
@@ -431,19 +868,13 @@ P_SetThingPosition (mobj_t* thing)
 	    && blocky>=0
 	    && blocky < bmapheight)
 	{
-	    link = &blocklinks[blocky*bmapwidth+blockx];
-	    thing->bprev = NULL;
-	    thing->bnext = *link;
-	    if (*link)
-		(*link)->bprev = thing;
-
-	    *link = thing;
-	}
-	else
-	{
-	    // thing is off the map
-	    thing->bnext = thing->bprev = NULL;
+	    block = &blockthings[blocky*bmapwidth+blockx];
+	    P_LinkBlockThing (block, block->count, thing);
 	}
+
+	// only things in blocks can be in the way of a moving sector
+	if (touchlists && !predicting)
+	    P_AddSecNodes (thing);
     }
 }
 
@@ -506,6 +937,7 @@ P_BlockLinesIterator
 
 //
 // P_BlockThingsIterator
+// The things are visited from the last put in.
 //
 boolean
 P_BlockThingsIterator
@@ -513,7 +945,7 @@ P_BlockThingsIterator
   int			y,
   boolean(*func)(mobj_t*) )
 {
-    mobj_t*		mobj;
+    blockiter_t		it;
 	
     if ( x<0
 	 || y<0
@@ -523,14 +955,106 @@ P_BlockThingsIterator
 	return true;
     }
     
+    it.block = &blockthings[y*bmapwidth+x];
+    it.next = it.block->count-1;
+    it.up = blockiters;
+    blockiters = &it;
 
-    for (mobj = blocklinks[y*bmapwidth+x] ;
-	 mobj ;
-	 mobj = mobj->bnext)
+    while (it.next >= 0)
     {
-	if (!func( mobj ) )
+	if (!func( mobjbyid[it.block->ids[it.next--]] ) )
+	{
+	    blockiters = it.up;
 	    return false;
+	}
     }
+
+    blockiters = it.up;
+    return true;
+}
+
+
+//
+// P_BlockThingsNear
+// As P_BlockThingsIterator, leaving out without reading them
+// the things whose x or y is their radius plus range or more
+// away from cx,cy.
+//
+boolean
+P_BlockThingsNear
+( int		x,
+  int		y,
+  fixed_t	cx,
+  fixed_t	cy,
+  fixed_t	range,
+  boolean	(*func)(mobj_t*) )
+{
+    blockiter_t		it;
+    fixed_t		blockdist;
+    int			id;
+	
+    if ( x<0
+	 || y<0
+	 || x>=bmapwidth
+	 || y>=bmapheight)
+    {
+	return true;
+    }
+    
+    it.block = &blockthings[y*bmapwidth+x];
+    it.next = it.block->count-1;
+    it.up = blockiters;
+    blockiters = &it;
+
+    while (it.next >= 0)
+    {
+	id = it.block->ids[it.next--];
+	blockdist = mobjradius[id] + range;
+
+	if ( abs(mobjx[id] - cx) >= blockdist
+	     || abs(mobjy[id] - cy) >= blockdist )
+	    continue;
+
+	if (!func( mobjbyid[id] ) )
+	{
+	    blockiters = it.up;
+	    return false;
+	}
+    }
+
+    blockiters = it.up;
+    return true;
+}
+
+
+//
+// P_BlockCorpsesIterator
+// As P_BlockThingsIterator for a func that passes over all
+// but corpses, which sees them in the same order. The func
+// must not put things in or take them out of blocks.
+//
+boolean
+P_BlockCorpsesIterator
+( int		x,
+  int		y,
+  boolean	(*func)(mobj_t*) )
+{
+    blockthings_t*	block;
+    int			i;
+	
+    if ( x<0
+	 || y<0
+	 || x>=bmapwidth
+	 || y>=bmapheight)
+    {
+	return true;
+    }
+
+    block = &blockthings[y*bmapwidth+x];
+    for (i = block->numcorpses-1 ; i >= 0 ; i--)
+	if (!func( mobjbyid[block->corpses[i]] ) )
+	    return false;
+
     return true;
 }
 
@@ -538,14 +1062,120 @@ P_BlockThingsIterator
 
 //
 // INTERCEPT ROUTINES
+// The intercepts of a trace go in a buffer that grows as
+// needed, and a heap of their indexes hands them out nearest
+// first, the first added first among equal fracs, in the
+// order the original search for the smallest gave.
 //
-intercept_t	intercepts[MAXINTERCEPTS];
+intercept_t*	intercepts;
 intercept_t*	intercept_p;
+static int	maxintercepts;
+
+static int*	interceptheap;
+static int	heapcount;
+
+// With -interceptlimit, what is found past MAXINTERCEPTS
+// is left out. The original wrote it over what followed
+// its array.
+boolean		interceptlimit;
 
 divline_t 	trace;
 boolean 	earlyout;
 int		ptflags;
 
+
+//
+// P_InterceptBefore
+//
+static boolean P_InterceptBefore (int a, int b)
+{
+    if (intercepts[a].frac != intercepts[b].frac)
+	return intercepts[a].frac < intercepts[b].frac;
+    return a < b;
+}
+
+
+//
+// P_AddIntercept
+//
+static void
+P_AddIntercept
+( fixed_t	frac,
+  boolean	isaline,
+  void*		hit )
+{
+    int		index;
+    int		i;
+    int		parent;
+
+    index = intercept_p - intercepts;
+
+    if (index == maxintercepts)
+    {
+	if (interceptlimit && maxintercepts >= MAXINTERCEPTS)
+	    return;
+
+	i = maxintercepts ? maxintercepts*2 : MAXINTERCEPTS;
+	intercepts = P_GrowArray (intercepts,
+				  maxintercepts*sizeof(*intercepts),
+				  i*sizeof(*intercepts), PU_STATIC);
+	interceptheap = P_GrowArray (interceptheap,
+				     maxintercepts*sizeof(*interceptheap),
+				     i*sizeof(*interceptheap), PU_STATIC);
+	maxintercepts = i;
+	intercept_p = intercepts + index;
+    }
+
+    intercept_p->frac = frac;
+    intercept_p->isaline = isaline;
+    if (isaline)
+	intercept_p->d.line = hit;
+    else
+	intercept_p->d.thing = hit;
+    intercept_p++;
+
+    for (i = heapcount++ ; i > 0 ; i = parent)
+    {
+	parent = (i-1)/2;
+	if (!P_InterceptBefore (index, interceptheap[parent]))
+	    break;
+	interceptheap[i] = interceptheap[parent];
+    }
+    interceptheap[i] = index;
+}
+
+
+//
+// P_NextIntercept
+// Takes the nearest intercept off the heap.
+//
+static intercept_t* P_NextIntercept (void)
+{
+    int		first;
+    int		last;
+    int		i;
+    int		child;
+
+    first = interceptheap[0];
+    last = interceptheap[--heapcount];
+
+    for (i = 0 ; (child = i*2+1) < heapcount ; i = child)
+    {
+	if (child+1 < heapcount
+	    && P_InterceptBefore (interceptheap[child+1],
+				  interceptheap[child]))
+	{
+	    child++;
+	}
+	if (!P_InterceptBefore (interceptheap[child], last))
+	    break;
+	interceptheap[i] = interceptheap[child];
+    }
+    interceptheap[i] = last;
+
+    return &intercepts[first];
+}
+
 //
 // PIT_AddLineIntercepts.
 // Looks for lines in the given block
@@ -598,10 +1228,7 @@ PIT_AddLineIntercepts (line_t* ld)
     }
     
 	
-    intercept_p->frac = frac;
-    intercept_p->isaline = true;
-    intercept_p->d.line = ld;
-    intercept_p++;
+    P_AddIntercept (frac, true, ld);
 
     return true;	// continue
 }
@@ -663,10 +1290,7 @@ boolean PIT_AddThingIntercepts (mobj_t* thing)
     if (frac < 0)
 	return true;		// behind source
 
-    intercept_p->frac = frac;
-    intercept_p->isaline = false;
-    intercept_p->d.thing = thing;
-    intercept_p++;
+    P_AddIntercept (frac, false, thing);
 
     return true;		// keep going
 }
@@ -682,46 +1306,17 @@ P_TraverseIntercepts
 ( traverser_t	func,
   fixed_t	maxfrac )
 {
-    int			count;
-    fixed_t		dist;
-    intercept_t*	scan;
     intercept_t*	in;
 	
-    count = intercept_p - intercepts;
-    
-    in = 0;			// shut up compiler warning
-	
-    while (count--)
+    while (heapcount)
     {
-	dist = MAXINT;
-	for (scan = intercepts ; scan<intercept_p ; scan++)
-	{
-	    if (scan->frac < dist)
-	    {
-		dist = scan->frac;
-		in = scan;
-	    }
-	}
-	
-	if (dist > maxfrac)
+	if (intercepts[interceptheap[0]].frac > maxfrac)
 	    return true;	// checked everything in range		
 
-#if 0  // UNUSED
-    {
-	// don't check these yet, there may be others inserted
-	in = scan = intercepts;
-	for ( scan = intercepts ; scan<intercept_p ; scan++)
-	    if (scan->frac > maxfrac)
-		*in++ = *scan;
-	intercept_p = in;
-	return false;
-    }
-#endif
+	in = P_NextIntercept ();
 
         if ( !func (in) )
 	    return false;	// don't bother going farther
-
-	in->frac = MAXINT;
     }
 	
     return true;		// everything was traversed
@@ -771,6 +1366,7 @@ P_PathTraverse
 		
     validcount++;
     intercept_p = intercepts;
+    heapcount = 0;
 	
     if ( ((x1-bmaporgx)&(MAPBLOCKSIZE-1)) == 0)
 	x1 += FRACUNIT;	// don't side exactly on a line
@@ -56,6 +56,8 @@ P_SetMobjState
 {
     state_t*	st;
 
+    P_WakeThinker (&mobj->thinker);
+
     do
     {
 	if (state == S_NULL)
@@ -313,7 +315,8 @@ void P_ZMovement (mobj_t* mo)
 		// after hitting the ground (hard),
 		// and utter appropriate sound.
 		mo->player->deltaviewheight = mo->momz>>3;
-		S_StartSound (mo, sfx_oof);
+		if (!predicting)
+		    S_StartSound (mo, sfx_oof);
 	    }
 	    mo->momz = 0;
 	}
@@ -493,6 +496,52 @@ void P_MobjThinker (mobj_t* mobj)
 }
 
 
+//
+// P_MobjActivity
+// How often the thing has to be run after P_MobjThinker:
+// ta_static if P_MobjThinker would do nothing more with it
+// until something wakes it, ta_sleeping if it only counts
+// down its A_Look states, otherwise ta_active.
+//
+void A_Look (mobj_t* actor);
+
+thinkactivity_t P_MobjActivity (mobj_t* mobj)
+{
+    if (mobj->player
+	|| mobj->momx
+	|| mobj->momy
+	|| mobj->momz
+	|| (mobj->flags & MF_SKULLFLY) )
+	return ta_active;
+
+    // P_ZMovement only leaves alone what is held in the air
+    if (mobj->z != mobj->floorz
+	&& ( !(mobj->flags & MF_NOGRAVITY)
+	     || (mobj->flags & MF_FLOAT && mobj->target)
+	     || mobj->z < mobj->floorz
+	     || mobj->z + mobj->height > mobj->ceilingz ) )
+	return ta_active;
+
+    if (mobj->tics == -1)
+    {
+	// counting down to a nightmare respawn
+	if ((mobj->flags & MF_COUNTKILL) && respawnmonsters)
+	    return ta_active;
+
+	return ta_static;
+    }
+
+    // just come to a look, with nothing heard
+    if (mobj->state->action.acp1 == (actionf_p1)A_Look
+	&& mobj->tics == mobj->state->tics
+	&& !mobj->target
+	&& !mobj->subsector->sector->soundtarget)
+	return ta_sleeping;
+
+    return ta_active;
+}
+
+
 //
 // P_SpawnMobj
 //
@@ -534,6 +583,7 @@ P_SpawnMobj
     mobj->frame = st->frame;
 
     // set subsector and/or block links
+    P_NewMobjId (mobj);
     P_SetThingPosition (mobj);
 	
     mobj->floorz = mobj->subsector->sector->floorheight;
@@ -581,6 +631,7 @@ void P_RemoveMobj (mobj_t* mobj)
 	
     // unlink from sector and block lists
     P_UnsetThingPosition (mobj);
+    P_FreeMobjId (mobj);
     
     // stop any playing sound
     S_StopSound (mobj);
@@ -69,7 +69,7 @@
 // The sound code uses the x,y, and subsector fields
 // to do stereo positioning of any sound effited by the mobj_t.
 //
-// The play simulation uses the blocklinks, x,y,z, radius, height
+// The play simulation uses the blockthings, x,y,z, radius, height
 // to determine when mobj_ts are touching each other,
 // touching lines in the map, or hit by trace lines (gunshots,
 // lines of sight, etc).
@@ -220,12 +220,14 @@ typedef struct mobj_s
     int			frame;	// might be ORed with FF_FULLBRIGHT
 
     // Interaction info, by BLOCKMAP.
-    // Links in blocks (if needed).
-    struct mobj_s*	bnext;
-    struct mobj_s*	bprev;
+    // Index into mobjbyid, and into blockthings if in a block.
+    int			id;
     
     struct subsector_s*	subsector;
 
+    // Sectors touched, for things in blocks.
+    struct msecnode_s*	touchlist;
+
     // The closest interval over all contacted Sectors.
     fixed_t		floorz;
     fixed_t		ceilingz;
@@ -273,6 +275,9 @@ typedef struct mobj_s
     // Player number last looked for.
     int			lastlook;	
 
+    // Tic it was last run for while sleeping, see P_SleepThinker.
+    int			sleeptic;
+
     // For nightmare respawn.
     mapthing_t		spawnpoint;	
 
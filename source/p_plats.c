@@ -63,8 +63,7 @@ void T_PlatRaise(plat_t* plat)
 	    || plat->type == raiseToNearestAndChange)
 	{
 	    if (!(leveltime&7))
-		S_StartSound((mobj_t *)&plat->sector->soundorg,
-			     sfx_stnmov);
+		P_SectorSound (plat->sector, sfx_stnmov);
 	}
 	
 				
@@ -72,8 +71,7 @@ void T_PlatRaise(plat_t* plat)
 	{
 	    plat->count = plat->wait;
 	    plat->status = down;
-	    S_StartSound((mobj_t *)&plat->sector->soundorg,
-			 sfx_pstart);
+	    P_SectorSound (plat->sector, sfx_pstart);
 	}
 	else
 	{
@@ -81,8 +79,7 @@ void T_PlatRaise(plat_t* plat)
 	    {
 		plat->count = plat->wait;
 		plat->status = waiting;
-		S_StartSound((mobj_t *)&plat->sector->soundorg,
-			     sfx_pstop);
+		P_SectorSound (plat->sector, sfx_pstop);
 
 		switch(plat->type)
 		{
@@ -110,7 +107,7 @@ void T_PlatRaise(plat_t* plat)
 	{
 	    plat->count = plat->wait;
 	    plat->status = waiting;
-	    S_StartSound((mobj_t *)&plat->sector->soundorg,sfx_pstop);
+	    P_SectorSound (plat->sector, sfx_pstop);
 	}
 	break;
 	
@@ -121,7 +118,7 @@ void T_PlatRaise(plat_t* plat)
 		plat->status = up;
 	    else
 		plat->status = down;
-	    S_StartSound((mobj_t *)&plat->sector->soundorg,sfx_pstart);
+	    P_SectorSound (plat->sector, sfx_pstart);
 	}
       case	in_stasis:
 	break;
@@ -299,6 +296,13 @@ void P_AddActivePlat(plat_t* plat)
 void P_RemoveActivePlat(plat_t* plat)
 {
     int		i;
+
+    if (threadedspecials)
+    {
+	P_DeferSpecial (plat->sector, (actionf_p1)P_RemoveActivePlat, plat);
+	return;
+    }
+
     for (i = 0;i < MAXPLATS;i++)
 	if (plat == activeplats[i])
 	{
@@ -0,0 +1,601 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//	REJECT table built at load time.
+//
+//	Many maps come with a REJECT lump of all zeros, or one too
+//	short for their sectors, and then P_CheckSight can never
+//	turn a look down without walking the BSP. Such a lump is
+//	replaced by a table built here.
+//
+//	A sector is taken to be seen from another if a straight
+//	line could get from a two sided line of the one, through
+//	the two sided lines between, to the other. Each two sided
+//	line is taken REJECTMARGIN units longer at both ends, to
+//	allow for the rounding in P_CheckSight. Heights and closed
+//	doors are left out. So a pair is only rejected when no
+//	line of sight can join them at all, and P_CheckSight gives
+//	the same answers as with the empty lump.
+//
+//	A line with the same sector on both sides is the mark of a
+//	map trick (deep water, invisible bridges) that the flow
+//	can't follow, so such a sector and those around it are
+//	taken to see everything.
+//
+//	The flow through the lines is worked out for each sector on
+//	its own, spread over the threads the platform has. The table
+//	is saved to a file named after a checksum of the map's lines,
+//	and read back from it the next time the map is loaded.
+//	-keepreject uses the lump as it is.
+//
+//-----------------------------------------------------------------------------
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <string.h>
+
+#include "doomdef.h"
+#include "doomdata.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "w_wad.h"
+#include "z_zone.h"
+#include "p_local.h"
+
+// State.
+#include "r_state.h"
+
+#include "p_reject.h"
+
+// map units each two sided line is made longer by at both ends
+#define REJECTMARGIN	8.0
+
+// anything this close to a line is taken to be on it
+#define REJECTEPSILON	(1.0/16)
+
+// flows followed from one sector before it is taken to see all
+#define MAXFLOWS	200000
+
+// bumped when the tables built change, so old files are not used
+#define REJECTVERSION	2
+
+#define FNV_OFFSET	2166136261u
+#define FNV_PRIME	16777619u
+
+
+// a stretch of a line a sight line could pass through
+typedef struct
+{
+    double	x1;
+    double	y1;
+    double	x2;
+    double	y2;
+
+} rwinding_t;
+
+// what each thread works with
+typedef struct
+{
+    byte*	onchain;	// lines on the way from the source
+    byte*	row;		// sectors seen from the source
+    int		flows;
+    boolean	overflow;
+
+} rthread_t;
+
+
+static rwinding_t*	portals;	// for each line
+static rthread_t*	rthreads;
+static byte*		rows;
+static int		rowbytes;
+
+
+//
+// P_ClipWinding
+// Cuts off the part of w on the right of the line from
+// (ax,ay) to (bx,by). Returns false if nothing is left.
+//
+static boolean
+P_ClipWinding
+( rwinding_t*	w,
+  double	ax,
+  double	ay,
+  double	bx,
+  double	by )
+{
+    double	dx;
+    double	dy;
+    double	length;
+    double	d1;
+    double	d2;
+    double	frac;
+
+    dx = bx - ax;
+    dy = by - ay;
+    length = sqrt (dx*dx + dy*dy);
+    if (length < REJECTEPSILON)
+	return true;
+
+    // distances on the left
+    d1 = (dx*(w->y1 - ay) - dy*(w->x1 - ax)) / length;
+    d2 = (dx*(w->y2 - ay) - dy*(w->x2 - ax)) / length;
+
+    if (d1 >= -REJECTEPSILON && d2 >= -REJECTEPSILON)
+	return true;
+
+    if (d1 < -REJECTEPSILON && d2 < -REJECTEPSILON)
+	return false;
+
+    frac = d1 / (d1 - d2);
+    if (d1 < -REJECTEPSILON)
+    {
+	w->x1 += frac * (w->x2 - w->x1);
+	w->y1 += frac * (w->y2 - w->y1);
+    }
+    else
+    {
+	w->x2 = w->x1 + frac * (w->x2 - w->x1);
+	w->y2 = w->y1 + frac * (w->y2 - w->y1);
+    }
+    return true;
+}
+
+
+//
+// P_Side
+// Returns 1 if (x,y) is on the left of the line from
+// (ax,ay) to (bx,by), -1 on the right, 0 on it.
+//
+static int
+P_Side
+( double	x,
+  double	y,
+  double	ax,
+  double	ay,
+  double	bx,
+  double	by )
+{
+    double	dx;
+    double	dy;
+    double	length;
+    double	d;
+
+    dx = bx - ax;
+    dy = by - ay;
+    length = sqrt (dx*dx + dy*dy);
+    d = (dx*(y - ay) - dy*(x - ax)) / length;
+
+    if (d > REJECTEPSILON)
+	return 1;
+    if (d < -REJECTEPSILON)
+	return -1;
+    return 0;
+}
+
+
+//
+// P_ClipToSeparators
+// Cuts target down to what the lines of sight from source
+// through pass can reach. Each line through an end of source
+// and an end of pass, with source wholly on one side and pass
+// on the other, bounds them. Lines that cannot be told apart
+// are left out, which only keeps more.
+//
+static boolean
+P_ClipToSeparators
+( rwinding_t*	source,
+  rwinding_t*	pass,
+  rwinding_t*	target )
+{
+    double	sx[2];
+    double	sy[2];
+    double	px[2];
+    double	py[2];
+    double	dx;
+    double	dy;
+    int		i;
+    int		j;
+    int		sside;
+    int		pside;
+
+    sx[0] = source->x1;	sy[0] = source->y1;
+    sx[1] = source->x2;	sy[1] = source->y2;
+    px[0] = pass->x1;	py[0] = pass->y1;
+    px[1] = pass->x2;	py[1] = pass->y2;
+
+    for (i=0 ; i<2 ; i++)
+    {
+	for (j=0 ; j<2 ; j++)
+	{
+	    dx = px[j] - sx[i];
+	    dy = py[j] - sy[i];
+	    if (dx*dx + dy*dy < REJECTEPSILON*REJECTEPSILON)
+		continue;
+
+	    sside = P_Side (sx[i^1], sy[i^1], sx[i], sy[i], px[j], py[j]);
+	    pside = P_Side (px[j^1], py[j^1], sx[i], sy[i], px[j], py[j]);
+	    if (!sside || !pside || sside == pside)
+		continue;
+
+	    // keep the side pass is on
+	    if (pside > 0)
+	    {
+		if (!P_ClipWinding (target, sx[i], sy[i], px[j], py[j]))
+		    return false;
+	    }
+	    else
+	    {
+		if (!P_ClipWinding (target, px[j], py[j], sx[i], sy[i]))
+		    return false;
+	    }
+	}
+    }
+    return true;
+}
+
+
+//
+// P_RejectFlow
+// Marks sec as seen, and follows the lines of sight from
+// source through pass on through the two sided lines of sec.
+// A straight line crosses each line once at most, so lines
+// already on the way are not gone through again.
+//
+static void
+P_RejectFlow
+( rthread_t*	th,
+  rwinding_t*	source,
+  rwinding_t*	pass,
+  line_t*	passline,
+  sector_t*	sec )
+{
+    int		secnum;
+    int		i;
+    line_t*	li;
+    line_t*	pl;
+    sector_t*	next;
+    rwinding_t	target;
+    rwinding_t	narrowed;
+
+    secnum = sec - sectors;
+    th->row[secnum>>3] |= 1 << (secnum&7);
+
+    if (++th->flows > MAXFLOWS)
+    {
+	th->overflow = true;
+	return;
+    }
+
+    pl = passline;
+
+    for (i=0 ; i<sec->linecount && !th->overflow ; i++)
+    {
+	li = sec->lines[i];
+	if (!li->backsector
+	    || li->frontsector == li->backsector
+	    || th->onchain[li - lines])
+	    continue;
+
+	next = li->frontsector == sec ? li->backsector : li->frontsector;
+	target = portals[li - lines];
+
+	// the far side of the line crossed last,
+	// the front being on its right
+	if (sec == pl->frontsector)
+	{
+	    if (!P_ClipWinding (&target, pl->v2->x/(double)FRACUNIT,
+				pl->v2->y/(double)FRACUNIT,
+				pl->v1->x/(double)FRACUNIT,
+				pl->v1->y/(double)FRACUNIT))
+		continue;
+	}
+	else
+	{
+	    if (!P_ClipWinding (&target, pl->v1->x/(double)FRACUNIT,
+				pl->v1->y/(double)FRACUNIT,
+				pl->v2->x/(double)FRACUNIT,
+				pl->v2->y/(double)FRACUNIT))
+		continue;
+	}
+
+	if (!P_ClipToSeparators (source, pass, &target))
+	    continue;
+
+	// only the part of the source that sees target matters now
+	narrowed = *source;
+	if (!P_ClipToSeparators (&target, pass, &narrowed))
+	    continue;
+
+	th->onchain[li - lines] = 1;
+	P_RejectFlow (th, &narrowed, &target, li, next);
+	th->onchain[li - lines] = 0;
+    }
+}
+
+
+//
+// P_RejectSector
+// Works out the sectors seen from one sector.
+//
+static void P_RejectSector (int secnum, int thread)
+{
+    rthread_t*	th;
+    sector_t*	sec;
+    line_t*	li;
+    int		i;
+
+    th = &rthreads[thread];
+    th->row = rows + secnum*rowbytes;
+    th->flows = 0;
+    th->overflow = false;
+
+    sec = &sectors[secnum];
+    th->row[secnum>>3] |= 1 << (secnum&7);
+
+    for (i=0 ; i<sec->linecount && !th->overflow ; i++)
+    {
+	li = sec->lines[i];
+	if (!li->backsector || li->frontsector == li->backsector)
+	    continue;
+
+	th->onchain[li - lines] = 1;
+	P_RejectFlow (th, &portals[li - lines], &portals[li - lines], li,
+		      li->frontsector == sec ? li->backsector
+		      : li->frontsector);
+	th->onchain[li - lines] = 0;
+    }
+
+    // too much to follow, so it might see anything
+    if (th->overflow)
+    {
+	memset (th->row, 0xff, rowbytes);
+	memset (th->onchain, 0, numlines);
+    }
+}
+
+
+//
+// P_RejectSelfReferencing
+// Sets the whole row of each sector with a line having it on
+// both sides, of the sectors next to it, and of the sectors
+// whose subsectors the line bounds, which are the ones the
+// sector really shows in.
+//
+static void P_RejectSelfReferencing (void)
+{
+    line_t*	li;
+    line_t*	other;
+    sector_t*	sec;
+    subsector_t* ss;
+    seg_t*	seg;
+    int		i;
+    int		j;
+
+    for (i=0, li=lines ; i<numlines ; i++, li++)
+    {
+	if (!li->backsector || li->frontsector != li->backsector)
+	    continue;
+
+	sec = li->frontsector;
+	memset (rows + (sec-sectors)*rowbytes, 0xff, rowbytes);
+
+	for (j=0 ; j<sec->linecount ; j++)
+	{
+	    other = sec->lines[j];
+	    if (!other->backsector)
+		continue;
+
+	    memset (rows + (other->frontsector-sectors)*rowbytes,
+		    0xff, rowbytes);
+	    memset (rows + (other->backsector-sectors)*rowbytes,
+		    0xff, rowbytes);
+	}
+    }
+
+    for (i=0, ss=subsectors ; i<numsubsectors ; i++, ss++)
+    {
+	seg = &segs[ss->firstline];
+	for (j=0 ; j<ss->numlines ; j++, seg++)
+	{
+	    li = seg->linedef;
+	    if (li->backsector && li->frontsector == li->backsector)
+	    {
+		memset (rows + (ss->sector-sectors)*rowbytes, 0xff, rowbytes);
+		break;
+	    }
+	}
+    }
+}
+
+
+//
+// P_BuildReject
+//
+static void P_BuildReject (void)
+{
+    line_t*	li;
+    rwinding_t*	w;
+    double	dx;
+    double	dy;
+    double	length;
+    int		threads;
+    int		i;
+    int		j;
+    int		pnum;
+
+    rowbytes = (numsectors+7)/8;
+    rows = Z_Malloc (numsectors*rowbytes, PU_STATIC, 0);
+    memset (rows, 0, numsectors*rowbytes);
+
+    portals = Z_Malloc (numlines*sizeof(*portals), PU_STATIC, 0);
+    for (i=0, li=lines ; i<numlines ; i++, li++)
+    {
+	w = &portals[i];
+	w->x1 = li->v1->x / (double)FRACUNIT;
+	w->y1 = li->v1->y / (double)FRACUNIT;
+	w->x2 = li->v2->x / (double)FRACUNIT;
+	w->y2 = li->v2->y / (double)FRACUNIT;
+
+	dx = w->x2 - w->x1;
+	dy = w->y2 - w->y1;
+	length = sqrt (dx*dx + dy*dy);
+	if (length > 0)
+	{
+	    dx *= REJECTMARGIN / length;
+	    dy *= REJECTMARGIN / length;
+	}
+	w->x1 -= dx;
+	w->y1 -= dy;
+	w->x2 += dx;
+	w->y2 += dy;
+    }
+
+    threads = I_ParallelThreads ();
+    rthreads = Z_Malloc (threads*sizeof(*rthreads), PU_STATIC, 0);
+    for (i=0 ; i<threads ; i++)
+    {
+	rthreads[i].onchain = Z_Malloc (numlines, PU_STATIC, 0);
+	memset (rthreads[i].onchain, 0, numlines);
+    }
+
+    I_RunParallel (P_RejectSector, numsectors);
+    P_RejectSelfReferencing ();
+
+    // a set bit in REJECT means neither sees the other, so a
+    // full row makes a full column too
+    for (i=0 ; i<numsectors ; i++)
+    {
+	for (j=0 ; j<numsectors ; j++)
+	{
+	    if (rows[i*rowbytes + (j>>3)] & (1 << (j&7))
+		|| rows[j*rowbytes + (i>>3)] & (1 << (i&7)))
+		continue;
+
+	    pnum = i*numsectors + j;
+	    rejectmatrix[pnum>>3] |= 1 << (pnum&7);
+	}
+    }
+
+    for (i=0 ; i<threads ; i++)
+	Z_Free (rthreads[i].onchain);
+    Z_Free (rthreads);
+    Z_Free (portals);
+    Z_Free (rows);
+}
+
+
+//
+// P_HashLump
+//
+static uint32_t P_HashLump (uint32_t hash, int lump)
+{
+    byte*	data;
+    int		length;
+    int		i;
+
+    data = W_CacheLumpNum (lump, PU_STATIC);
+    length = W_LumpLength (lump);
+    for (i=0 ; i<length ; i++)
+    {
+	hash ^= data[i];
+	hash *= FNV_PRIME;
+    }
+    Z_ChangeTag (data, PU_CACHE);
+
+    return hash;
+}
+
+
+//
+// P_ReadRejectFile
+// Returns false unless the whole table was read.
+//
+static boolean P_ReadRejectFile (char* name, int length)
+{
+    FILE*	handle;
+    int		count;
+
+    handle = fopen (name, "rb");
+    if (!handle)
+	return false;
+
+    // one byte more, so a longer file is found out
+    count = fread (rejectmatrix, 1, length, handle);
+    if (count == length && fgetc (handle) != EOF)
+	count = -1;
+    fclose (handle);
+
+    return count == length;
+}
+
+
+//
+// P_LoadReject
+//
+void P_LoadReject (int lumpnum)
+{
+    byte*	lump;
+    char	name[32];
+    uint32_t	hash;
+    int		length;
+    int		size;
+    int		i;
+    int64_t	start;
+
+    lump = W_CacheLumpNum (lumpnum+ML_REJECT, PU_LEVEL);
+    rejectmatrix = lump;
+    if (M_CheckParm ("-keepreject"))
+	return;
+
+    // does the lump reject anything?
+    size = (numsectors*numsectors+7)/8;
+    length = W_LumpLength (lumpnum+ML_REJECT);
+    if (length >= size)
+    {
+	for (i=0 ; i<size ; i++)
+	    if (lump[i])
+		return;
+    }
+
+    rejectmatrix = Z_Malloc (size, PU_LEVEL, 0);
+
+    hash = (FNV_OFFSET ^ REJECTVERSION) * FNV_PRIME;
+    hash = P_HashLump (hash, lumpnum+ML_VERTEXES);
+    hash = P_HashLump (hash, lumpnum+ML_LINEDEFS);
+    hash = P_HashLump (hash, lumpnum+ML_SIDEDEFS);
+    sprintf (name, "%08x.rej", hash);
+
+    if (P_ReadRejectFile (name, size))
+	return;
+
+    start = I_GetTimeUS ();
+    memset (rejectmatrix, 0, size);
+    P_BuildReject ();
+
+    printf ("P_LoadReject: built %s in %i ms\n",
+	    name, (int)((I_GetTimeUS () - start) / 1000));
+
+    if (!M_WriteFile (name, rejectmatrix, size))
+	printf ("P_LoadReject: couldn't write %s\n", name);
+}
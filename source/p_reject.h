@@ -0,0 +1,36 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//	REJECT table built at load time.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __P_REJECT__
+#define __P_REJECT__
+
+// Sets rejectmatrix for the map at lumpnum, from its REJECT
+// lump if that has anything in it, otherwise from the file the
+// table was saved to or by building it.
+// The lines and sectors must be loaded.
+void P_LoadReject (int lumpnum);
+
+#endif
@@ -23,9 +23,12 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <stdlib.h>
+
 #include "i_system.h"
 #include "z_zone.h"
 #include "p_local.h"
+#include "s_sound.h"
 
 // State.
 #include "doomstat.h"
@@ -36,7 +39,7 @@ byte*		save_p;
 
 // Pads save_p to a 4-byte boundary
 //  so that the load/save works on SGI&Gecko.
-#define PADSAVEP()	save_p += (4 - ((int) save_p & 3)) & 3
+#define PADSAVEP()	save_p += (4 - ((intptr_t) save_p & 3)) & 3
 
 
 
@@ -74,6 +77,8 @@ void P_ArchivePlayers (void)
 
 //
 // P_UnArchivePlayers
+// player_t is still as version 109 saved it. If it changes,
+// give it a frozen layout like the thinkers below have.
 //
 void P_UnArchivePlayers (void)
 {
@@ -100,7 +105,7 @@ void P_UnArchivePlayers (void)
 	    if (players[i]. psprites[j].state)
 	    {
 		players[i]. psprites[j].state 
-		    = &states[ (int)players[i].psprites[j].state ];
+		    = &states[ (intptr_t)players[i].psprites[j].state ];
 	    }
 	}
     }
@@ -175,6 +180,7 @@ void P_UnArchiveWorld (void)
     get = (short *)save_p;
     
     // do sectors
+    heightchanges++;
     for (i=0, sec = sectors ; i<numsectors ; i++,sec++)
     {
 	sec->floorheight = *get++ << FRACBITS;
@@ -224,40 +230,169 @@ typedef enum
 } thinkerclass_t;
 
 
+//
+// P_ArchiveMobj
+// Returns the copy, for the caller to swizzle further.
+//
+static mobj_t* P_ArchiveMobj (mobj_t* mo)
+{
+    mobj_t*	mobj;
+
+    PADSAVEP();
+    mobj = (mobj_t *)save_p;
+    memcpy (mobj, mo, sizeof(*mobj));
+    save_p += sizeof(*mobj);
+    mobj->state = (state_t *)(mobj->state - states);
+
+    if (mobj->player)
+	mobj->player = (player_t *)((mobj->player-players) + 1);
+
+    return mobj;
+}
+
 
 //
-// P_ArchiveThinkers
+// P_UnArchiveMobj
+// The thing is neither linked nor added as a thinker.
 //
-void P_ArchiveThinkers (void)
+static mobj_t* P_UnArchiveMobj (void)
 {
-    thinker_t*		th;
-    mobj_t*		mobj;
-	
-    // save off the current thinkers
-    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    mobj_t*	mobj;
+
+    PADSAVEP();
+    mobj = Z_Malloc (sizeof(*mobj), PU_LEVEL, NULL);
+    memcpy (mobj, save_p, sizeof(*mobj));
+    save_p += sizeof(*mobj);
+    mobj->state = &states[(intptr_t)mobj->state];
+    if (mobj->player)
     {
-	if (th->function.acp1 == (actionf_p1)P_MobjThinker)
-	{
-	    *save_p++ = tc_mobj;
-	    PADSAVEP();
-	    mobj = (mobj_t *)save_p;
-	    memcpy (mobj, th, sizeof(*mobj));
-	    save_p += sizeof(*mobj);
-	    mobj->state = (state_t *)(mobj->state - states);
-	    
-	    if (mobj->player)
-		mobj->player = (player_t *)((mobj->player-players) + 1);
-	    continue;
-	}
-		
-	// I_Error ("P_ArchiveThinkers: Unknown thinker function");
+	mobj->player = &players[(intptr_t)mobj->player-1];
+	mobj->player->mo = mobj;
     }
+    mobj->info = &mobjinfo[mobj->type];
+    mobj->thinker.function.acp1 = (actionf_p1)P_MobjThinker;
+    mobj->touchlist = NULL;
+    P_NewMobjId (mobj);
 
-    // add a terminating marker
-    *save_p++ = tc_end;	
+    return mobj;
 }
 
 
+//
+// Version 109 savegames
+//
+// G_DoLoadOldGame reads the thinkers and specials as the original
+// game wrote them, straight from its structs. These are frozen
+// copies of those layouts, so the structs the game uses now can
+// change without breaking old saves. Swizzled pointers are kept
+// as the indexes they hold.
+//
+typedef struct
+{
+    void*		prev;
+    void*		next;
+    think_t		function;
+    
+} oldthinker_t;
+
+typedef struct
+{
+    oldthinker_t	thinker;
+    fixed_t		x;
+    fixed_t		y;
+    fixed_t		z;
+    void*		snext;
+    void*		sprev;
+    angle_t		angle;
+    spritenum_t		sprite;
+    int			frame;
+    void*		bnext;
+    void*		bprev;
+    void*		subsector;
+    fixed_t		floorz;
+    fixed_t		ceilingz;
+    fixed_t		radius;
+    fixed_t		height;
+    fixed_t		momx;
+    fixed_t		momy;
+    fixed_t		momz;
+    int			validcount;
+    mobjtype_t		type;
+    void*		info;
+    int			tics;
+    intptr_t		state;		// index into states
+    int			flags;
+    int			health;
+    int			movedir;
+    int			movecount;
+    void*		target;
+    int			reactiontime;
+    int			threshold;
+    intptr_t		player;		// index into players + 1
+    int			lastlook;
+    mapthing_t		spawnpoint;
+    void*		tracer;
+    
+} oldmobj_t;
+
+
+//
+// P_UnArchiveOldMobj
+// Like P_UnArchiveMobj, from a version 109 save.
+// Pointers between things were not saved, so they start out NULL.
+//
+static mobj_t* P_UnArchiveOldMobj (void)
+{
+    oldmobj_t	old;
+    mobj_t*	mobj;
+
+    PADSAVEP();
+    memcpy (&old, save_p, sizeof(old));
+    save_p += sizeof(old);
+
+    if ((unsigned)old.type >= NUMMOBJTYPES
+	|| (uintptr_t)old.state >= NUMSTATES
+	|| (uintptr_t)old.player > MAXPLAYERS)
+	I_Error ("P_UnArchiveOldMobj: bad thing in savegame");
+    
+    mobj = Z_Malloc (sizeof(*mobj), PU_LEVEL, NULL);
+    memset (mobj, 0, sizeof(*mobj));
+    mobj->x = old.x;
+    mobj->y = old.y;
+    mobj->z = old.z;
+    mobj->angle = old.angle;
+    mobj->sprite = old.sprite;
+    mobj->frame = old.frame;
+    mobj->floorz = old.floorz;
+    mobj->ceilingz = old.ceilingz;
+    mobj->radius = old.radius;
+    mobj->height = old.height;
+    mobj->momx = old.momx;
+    mobj->momy = old.momy;
+    mobj->momz = old.momz;
+    mobj->type = old.type;
+    mobj->info = &mobjinfo[old.type];
+    mobj->tics = old.tics;
+    mobj->state = &states[old.state];
+    mobj->flags = old.flags;
+    mobj->health = old.health;
+    mobj->movedir = old.movedir;
+    mobj->movecount = old.movecount;
+    mobj->reactiontime = old.reactiontime;
+    mobj->threshold = old.threshold;
+    mobj->lastlook = old.lastlook;
+    mobj->spawnpoint = old.spawnpoint;
+    if (old.player)
+    {
+	mobj->player = &players[old.player-1];
+	mobj->player->mo = mobj;
+    }
+    mobj->thinker.function.acp1 = (actionf_p1)P_MobjThinker;
+    P_NewMobjId (mobj);
+
+    return mobj;
+}
+
 
 //
 // P_UnArchiveThinkers
@@ -294,22 +429,10 @@ void P_UnArchiveThinkers (void)
 	    return; 	// end of list
 			
 	  case tc_mobj:
-	    PADSAVEP();
-	    mobj = Z_Malloc (sizeof(*mobj), PU_LEVEL, NULL);
-	    memcpy (mobj, save_p, sizeof(*mobj));
-	    save_p += sizeof(*mobj);
-	    mobj->state = &states[(int)mobj->state];
-	    mobj->target = NULL;
-	    if (mobj->player)
-	    {
-		mobj->player = &players[(int)mobj->player-1];
-		mobj->player->mo = mobj;
-	    }
+	    mobj = P_UnArchiveOldMobj ();
 	    P_SetThingPosition (mobj);
-	    mobj->info = &mobjinfo[mobj->type];
 	    mobj->floorz = mobj->subsector->sector->floorheight;
 	    mobj->ceilingz = mobj->subsector->sector->ceilingheight;
-	    mobj->thinker.function.acp1 = (actionf_p1)P_MobjThinker;
 	    P_AddThinker (&mobj->thinker);
 	    break;
 			
@@ -334,7 +457,8 @@ enum
     tc_flash,
     tc_strobe,
     tc_glow,
-    tc_endspecials
+    tc_endspecials,
+    tc_fireflicker	// after the end marker, so older saves still load
 
 } specials_e;	
 
@@ -349,11 +473,93 @@ enum
 // T_LightFlash, (lightflash_t: sector_t * swizzle),
 // T_StrobeFlash, (strobe_t: sector_t *),
 // T_Glow, (glow_t: sector_t *),
+// T_FireFlicker, (fireflicker_t: sector_t *),
 // T_PlatRaise, (plat_t: sector_t *), - active list
 //
-void P_ArchiveSpecials (void)
+// Each is the thinker struct with its sector swizzled,
+// so they are all saved the same way.
+//
+static void P_ArchiveSpecialData (int tclass, thinker_t* th, int size,
+				  sector_t** sector)
+{
+    sector_t**	dest;
+
+    *save_p++ = tclass;
+    PADSAVEP();
+    memcpy (save_p, th, size);
+    dest = (sector_t **)(save_p + ((byte *)sector - (byte *)th));
+    *dest = (sector_t *)(*sector - sectors);
+    save_p += size;
+}
+
+
+//
+// P_ArchiveSpecial
+// Returns false if th is not a special.
+//
+static boolean P_ArchiveSpecial (thinker_t* th)
+{
+    int			i;
+	
+    if (th->function.acv == (actionf_v)NULL)
+    {
+	// in stasis
+	for (i = 0; i < MAXCEILINGS;i++)
+	    if (activeceilings[i] == (ceiling_t *)th)
+	    {
+		P_ArchiveSpecialData (tc_ceiling, th, sizeof(ceiling_t),
+				      &((ceiling_t *)th)->sector);
+		return true;
+	    }
+
+	for (i = 0; i < MAXPLATS;i++)
+	    if (activeplats[i] == (plat_t *)th)
+	    {
+		P_ArchiveSpecialData (tc_plat, th, sizeof(plat_t),
+				      &((plat_t *)th)->sector);
+		return true;
+	    }
+
+	return false;
+    }
+			
+    if (th->function.acp1 == (actionf_p1)T_MoveCeiling)
+	P_ArchiveSpecialData (tc_ceiling, th, sizeof(ceiling_t),
+			      &((ceiling_t *)th)->sector);
+    else if (th->function.acp1 == (actionf_p1)T_VerticalDoor)
+	P_ArchiveSpecialData (tc_door, th, sizeof(vldoor_t),
+			      &((vldoor_t *)th)->sector);
+    else if (th->function.acp1 == (actionf_p1)T_MoveFloor)
+	P_ArchiveSpecialData (tc_floor, th, sizeof(floormove_t),
+			      &((floormove_t *)th)->sector);
+    else if (th->function.acp1 == (actionf_p1)T_PlatRaise)
+	P_ArchiveSpecialData (tc_plat, th, sizeof(plat_t),
+			      &((plat_t *)th)->sector);
+    else if (th->function.acp1 == (actionf_p1)T_LightFlash)
+	P_ArchiveSpecialData (tc_flash, th, sizeof(lightflash_t),
+			      &((lightflash_t *)th)->sector);
+    else if (th->function.acp1 == (actionf_p1)T_StrobeFlash)
+	P_ArchiveSpecialData (tc_strobe, th, sizeof(strobe_t),
+			      &((strobe_t *)th)->sector);
+    else if (th->function.acp1 == (actionf_p1)T_Glow)
+	P_ArchiveSpecialData (tc_glow, th, sizeof(glow_t),
+			      &((glow_t *)th)->sector);
+    else if (th->function.acp1 == (actionf_p1)T_FireFlicker)
+	P_ArchiveSpecialData (tc_fireflicker, th, sizeof(fireflicker_t),
+			      &((fireflicker_t *)th)->sector);
+    else
+	return false;
+
+    return true;
+}
+
+
+//
+// P_UnArchiveSpecial
+// Reads one special of class tclass and starts it.
+//
+static void P_UnArchiveSpecial (int tclass)
 {
-    thinker_t*		th;
     ceiling_t*		ceiling;
     vldoor_t*		door;
     floormove_t*	floor;
@@ -361,119 +567,238 @@ void P_ArchiveSpecials (void)
     lightflash_t*	flash;
     strobe_t*		strobe;
     glow_t*		glow;
-    int			i;
+    fireflicker_t*	flick;
 	
-    // save off the current thinkers
-    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    switch (tclass)
     {
-	if (th->function.acv == (actionf_v)NULL)
-	{
-	    for (i = 0; i < MAXCEILINGS;i++)
-		if (activeceilings[i] == (ceiling_t *)th)
-		    break;
-	    
-	    if (i<MAXCEILINGS)
-	    {
-		*save_p++ = tc_ceiling;
-		PADSAVEP();
-		ceiling = (ceiling_t *)save_p;
-		memcpy (ceiling, th, sizeof(*ceiling));
-		save_p += sizeof(*ceiling);
-		ceiling->sector = (sector_t *)(ceiling->sector - sectors);
-	    }
-	    continue;
-	}
-			
-	if (th->function.acp1 == (actionf_p1)T_MoveCeiling)
-	{
-	    *save_p++ = tc_ceiling;
-	    PADSAVEP();
-	    ceiling = (ceiling_t *)save_p;
-	    memcpy (ceiling, th, sizeof(*ceiling));
-	    save_p += sizeof(*ceiling);
-	    ceiling->sector = (sector_t *)(ceiling->sector - sectors);
-	    continue;
-	}
-			
-	if (th->function.acp1 == (actionf_p1)T_VerticalDoor)
-	{
-	    *save_p++ = tc_door;
-	    PADSAVEP();
-	    door = (vldoor_t *)save_p;
-	    memcpy (door, th, sizeof(*door));
-	    save_p += sizeof(*door);
-	    door->sector = (sector_t *)(door->sector - sectors);
-	    continue;
-	}
-			
-	if (th->function.acp1 == (actionf_p1)T_MoveFloor)
-	{
-	    *save_p++ = tc_floor;
-	    PADSAVEP();
-	    floor = (floormove_t *)save_p;
-	    memcpy (floor, th, sizeof(*floor));
-	    save_p += sizeof(*floor);
-	    floor->sector = (sector_t *)(floor->sector - sectors);
-	    continue;
-	}
-			
-	if (th->function.acp1 == (actionf_p1)T_PlatRaise)
-	{
-	    *save_p++ = tc_plat;
-	    PADSAVEP();
-	    plat = (plat_t *)save_p;
-	    memcpy (plat, th, sizeof(*plat));
-	    save_p += sizeof(*plat);
-	    plat->sector = (sector_t *)(plat->sector - sectors);
-	    continue;
-	}
-			
-	if (th->function.acp1 == (actionf_p1)T_LightFlash)
-	{
-	    *save_p++ = tc_flash;
-	    PADSAVEP();
-	    flash = (lightflash_t *)save_p;
-	    memcpy (flash, th, sizeof(*flash));
-	    save_p += sizeof(*flash);
-	    flash->sector = (sector_t *)(flash->sector - sectors);
-	    continue;
-	}
-			
-	if (th->function.acp1 == (actionf_p1)T_StrobeFlash)
-	{
-	    *save_p++ = tc_strobe;
-	    PADSAVEP();
-	    strobe = (strobe_t *)save_p;
-	    memcpy (strobe, th, sizeof(*strobe));
-	    save_p += sizeof(*strobe);
-	    strobe->sector = (sector_t *)(strobe->sector - sectors);
-	    continue;
-	}
-			
-	if (th->function.acp1 == (actionf_p1)T_Glow)
-	{
-	    *save_p++ = tc_glow;
-	    PADSAVEP();
-	    glow = (glow_t *)save_p;
-	    memcpy (glow, th, sizeof(*glow));
-	    save_p += sizeof(*glow);
-	    glow->sector = (sector_t *)(glow->sector - sectors);
-	    continue;
-	}
+      case tc_ceiling:
+	PADSAVEP();
+	ceiling = Z_Malloc (sizeof(*ceiling), PU_LEVEL, NULL);
+	memcpy (ceiling, save_p, sizeof(*ceiling));
+	save_p += sizeof(*ceiling);
+	ceiling->sector = &sectors[(intptr_t)ceiling->sector];
+	ceiling->sector->specialdata = ceiling;
+
+	if (ceiling->thinker.function.acp1)
+	    ceiling->thinker.function.acp1 = (actionf_p1)T_MoveCeiling;
+
+	P_AddThinker (&ceiling->thinker);
+	P_AddActiveCeiling(ceiling);
+	break;
+				
+      case tc_door:
+	PADSAVEP();
+	door = Z_Malloc (sizeof(*door), PU_LEVEL, NULL);
+	memcpy (door, save_p, sizeof(*door));
+	save_p += sizeof(*door);
+	door->sector = &sectors[(intptr_t)door->sector];
+	door->sector->specialdata = door;
+	door->thinker.function.acp1 = (actionf_p1)T_VerticalDoor;
+	P_AddThinker (&door->thinker);
+	break;
+				
+      case tc_floor:
+	PADSAVEP();
+	floor = Z_Malloc (sizeof(*floor), PU_LEVEL, NULL);
+	memcpy (floor, save_p, sizeof(*floor));
+	save_p += sizeof(*floor);
+	floor->sector = &sectors[(intptr_t)floor->sector];
+	floor->sector->specialdata = floor;
+	floor->thinker.function.acp1 = (actionf_p1)T_MoveFloor;
+	P_AddThinker (&floor->thinker);
+	break;
+				
+      case tc_plat:
+	PADSAVEP();
+	plat = Z_Malloc (sizeof(*plat), PU_LEVEL, NULL);
+	memcpy (plat, save_p, sizeof(*plat));
+	save_p += sizeof(*plat);
+	plat->sector = &sectors[(intptr_t)plat->sector];
+	plat->sector->specialdata = plat;
+
+	if (plat->thinker.function.acp1)
+	    plat->thinker.function.acp1 = (actionf_p1)T_PlatRaise;
+
+	P_AddThinker (&plat->thinker);
+	P_AddActivePlat(plat);
+	break;
+				
+      case tc_flash:
+	PADSAVEP();
+	flash = Z_Malloc (sizeof(*flash), PU_LEVEL, NULL);
+	memcpy (flash, save_p, sizeof(*flash));
+	save_p += sizeof(*flash);
+	flash->sector = &sectors[(intptr_t)flash->sector];
+	flash->thinker.function.acp1 = (actionf_p1)T_LightFlash;
+	P_AddThinker (&flash->thinker);
+	break;
+				
+      case tc_strobe:
+	PADSAVEP();
+	strobe = Z_Malloc (sizeof(*strobe), PU_LEVEL, NULL);
+	memcpy (strobe, save_p, sizeof(*strobe));
+	save_p += sizeof(*strobe);
+	strobe->sector = &sectors[(intptr_t)strobe->sector];
+	strobe->thinker.function.acp1 = (actionf_p1)T_StrobeFlash;
+	P_AddThinker (&strobe->thinker);
+	break;
+				
+      case tc_glow:
+	PADSAVEP();
+	glow = Z_Malloc (sizeof(*glow), PU_LEVEL, NULL);
+	memcpy (glow, save_p, sizeof(*glow));
+	save_p += sizeof(*glow);
+	glow->sector = &sectors[(intptr_t)glow->sector];
+	glow->thinker.function.acp1 = (actionf_p1)T_Glow;
+	P_AddThinker (&glow->thinker);
+	break;
+				
+      case tc_fireflicker:
+	PADSAVEP();
+	flick = Z_Malloc (sizeof(*flick), PU_LEVEL, NULL);
+	memcpy (flick, save_p, sizeof(*flick));
+	save_p += sizeof(*flick);
+	flick->sector = &sectors[(intptr_t)flick->sector];
+	flick->thinker.function.acp1 = (actionf_p1)T_FireFlicker;
+	P_AddThinker (&flick->thinker);
+	break;
+				
+      default:
+	I_Error ("P_UnarchiveSpecials:Unknown tclass %i "
+		 "in savegame",tclass);
     }
-	
-    // add a terminating marker
-    *save_p++ = tc_endspecials;	
+}
+
+
+//
+// The version 109 specials, each the thinker
+// followed by the struct as it was.
+//
+typedef struct
+{
+    oldthinker_t	thinker;
+    ceiling_e		type;
+    intptr_t		sector;
+    fixed_t		bottomheight;
+    fixed_t		topheight;
+    fixed_t		speed;
+    boolean		crush;
+    int			direction;
+    int			tag;
+    int			olddirection;
+    
+} oldceiling_t;
+
+typedef struct
+{
+    oldthinker_t	thinker;
+    vldoor_e		type;
+    intptr_t		sector;
+    fixed_t		topheight;
+    fixed_t		speed;
+    int			direction;
+    int			topwait;
+    int			topcountdown;
+    
+} olddoor_t;
+
+typedef struct
+{
+    oldthinker_t	thinker;
+    floor_e		type;
+    boolean		crush;
+    intptr_t		sector;
+    int			direction;
+    int			newspecial;
+    short		texture;
+    fixed_t		floordestheight;
+    fixed_t		speed;
+
+} oldfloor_t;
+
+typedef struct
+{
+    oldthinker_t	thinker;
+    intptr_t		sector;
+    fixed_t		speed;
+    fixed_t		low;
+    fixed_t		high;
+    int			wait;
+    int			count;
+    plat_e		status;
+    plat_e		oldstatus;
+    boolean		crush;
+    int			tag;
+    plattype_e		type;
+    
+} oldplat_t;
+
+typedef struct
+{
+    oldthinker_t	thinker;
+    intptr_t		sector;
+    int			count;
+    int			maxlight;
+    int			minlight;
+    int			maxtime;
+    int			mintime;
+    
+} oldflash_t;
 
+typedef struct
+{
+    oldthinker_t	thinker;
+    intptr_t		sector;
+    int			count;
+    int			minlight;
+    int			maxlight;
+    int			darktime;
+    int			brighttime;
+    
+} oldstrobe_t;
+
+typedef struct
+{
+    oldthinker_t	thinker;
+    intptr_t		sector;
+    int			minlight;
+    int			maxlight;
+    int			direction;
+
+} oldglow_t;
+
+
+//
+// P_OldSpecialSector
+// Reads one version 109 special of the given size into old,
+// returning the sector its index at sector names.
+//
+static sector_t* P_OldSpecialSector (void* old, int size, intptr_t* sector)
+{
+    PADSAVEP();
+    memcpy (old, save_p, size);
+    save_p += size;
+
+    if ((uintptr_t)*sector >= (uintptr_t)numsectors)
+	I_Error ("P_UnArchiveOldSpecial: bad sector in savegame");
+
+    return &sectors[*sector];
 }
 
 
 //
-// P_UnArchiveSpecials
+// P_UnArchiveOldSpecial
+// Like P_UnArchiveSpecial, from a version 109 save.
 //
-void P_UnArchiveSpecials (void)
+static void P_UnArchiveOldSpecial (int tclass)
 {
-    byte		tclass;
+    oldceiling_t	oldceiling;
+    olddoor_t		olddoor;
+    oldfloor_t		oldfloor;
+    oldplat_t		oldplat;
+    oldflash_t		oldflash;
+    oldstrobe_t		oldstrobe;
+    oldglow_t		oldglow;
     ceiling_t*		ceiling;
     vldoor_t*		door;
     floormove_t*	floor;
@@ -482,104 +807,1900 @@ void P_UnArchiveSpecials (void)
     strobe_t*		strobe;
     glow_t*		glow;
 	
-	
-    // read in saved thinkers
-    while (1)
+    switch (tclass)
     {
-	tclass = *save_p++;
-	switch (tclass)
-	{
-	  case tc_endspecials:
-	    return;	// end of list
-			
-	  case tc_ceiling:
-	    PADSAVEP();
-	    ceiling = Z_Malloc (sizeof(*ceiling), PU_LEVEL, NULL);
-	    memcpy (ceiling, save_p, sizeof(*ceiling));
-	    save_p += sizeof(*ceiling);
-	    ceiling->sector = &sectors[(int)ceiling->sector];
-	    ceiling->sector->specialdata = ceiling;
-
-	    if (ceiling->thinker.function.acp1)
-		ceiling->thinker.function.acp1 = (actionf_p1)T_MoveCeiling;
-
-	    P_AddThinker (&ceiling->thinker);
-	    P_AddActiveCeiling(ceiling);
-	    break;
+      case tc_ceiling:
+	ceiling = Z_Malloc (sizeof(*ceiling), PU_LEVEL, NULL);
+	memset (ceiling, 0, sizeof(*ceiling));
+	ceiling->sector = P_OldSpecialSector (&oldceiling, sizeof(oldceiling),
+					  &oldceiling.sector);
+	ceiling->type = oldceiling.type;
+	ceiling->bottomheight = oldceiling.bottomheight;
+	ceiling->topheight = oldceiling.topheight;
+	ceiling->speed = oldceiling.speed;
+	ceiling->crush = oldceiling.crush;
+	ceiling->direction = oldceiling.direction;
+	ceiling->tag = oldceiling.tag;
+	ceiling->olddirection = oldceiling.olddirection;
+	ceiling->sector->specialdata = ceiling;
+
+	if (oldceiling.thinker.function.acp1)
+	    ceiling->thinker.function.acp1 = (actionf_p1)T_MoveCeiling;
+
+	P_AddThinker (&ceiling->thinker);
+	P_AddActiveCeiling(ceiling);
+	break;
 				
-	  case tc_door:
-	    PADSAVEP();
-	    door = Z_Malloc (sizeof(*door), PU_LEVEL, NULL);
-	    memcpy (door, save_p, sizeof(*door));
-	    save_p += sizeof(*door);
-	    door->sector = &sectors[(int)door->sector];
-	    door->sector->specialdata = door;
-	    door->thinker.function.acp1 = (actionf_p1)T_VerticalDoor;
-	    P_AddThinker (&door->thinker);
-	    break;
+      case tc_door:
+	door = Z_Malloc (sizeof(*door), PU_LEVEL, NULL);
+	memset (door, 0, sizeof(*door));
+	door->sector = P_OldSpecialSector (&olddoor, sizeof(olddoor),
+					  &olddoor.sector);
+	door->type = olddoor.type;
+	door->topheight = olddoor.topheight;
+	door->speed = olddoor.speed;
+	door->direction = olddoor.direction;
+	door->topwait = olddoor.topwait;
+	door->topcountdown = olddoor.topcountdown;
+	door->sector->specialdata = door;
+	door->thinker.function.acp1 = (actionf_p1)T_VerticalDoor;
+	P_AddThinker (&door->thinker);
+	break;
 				
-	  case tc_floor:
-	    PADSAVEP();
-	    floor = Z_Malloc (sizeof(*floor), PU_LEVEL, NULL);
-	    memcpy (floor, save_p, sizeof(*floor));
-	    save_p += sizeof(*floor);
-	    floor->sector = &sectors[(int)floor->sector];
-	    floor->sector->specialdata = floor;
-	    floor->thinker.function.acp1 = (actionf_p1)T_MoveFloor;
-	    P_AddThinker (&floor->thinker);
-	    break;
+      case tc_floor:
+	floor = Z_Malloc (sizeof(*floor), PU_LEVEL, NULL);
+	memset (floor, 0, sizeof(*floor));
+	floor->sector = P_OldSpecialSector (&oldfloor, sizeof(oldfloor),
+					  &oldfloor.sector);
+	floor->type = oldfloor.type;
+	floor->crush = oldfloor.crush;
+	floor->direction = oldfloor.direction;
+	floor->newspecial = oldfloor.newspecial;
+	floor->texture = oldfloor.texture;
+	floor->floordestheight = oldfloor.floordestheight;
+	floor->speed = oldfloor.speed;
+	floor->sector->specialdata = floor;
+	floor->thinker.function.acp1 = (actionf_p1)T_MoveFloor;
+	P_AddThinker (&floor->thinker);
+	break;
 				
-	  case tc_plat:
-	    PADSAVEP();
-	    plat = Z_Malloc (sizeof(*plat), PU_LEVEL, NULL);
-	    memcpy (plat, save_p, sizeof(*plat));
-	    save_p += sizeof(*plat);
-	    plat->sector = &sectors[(int)plat->sector];
-	    plat->sector->specialdata = plat;
-
-	    if (plat->thinker.function.acp1)
-		plat->thinker.function.acp1 = (actionf_p1)T_PlatRaise;
-
-	    P_AddThinker (&plat->thinker);
-	    P_AddActivePlat(plat);
-	    break;
+      case tc_plat:
+	plat = Z_Malloc (sizeof(*plat), PU_LEVEL, NULL);
+	memset (plat, 0, sizeof(*plat));
+	plat->sector = P_OldSpecialSector (&oldplat, sizeof(oldplat),
+					  &oldplat.sector);
+	plat->speed = oldplat.speed;
+	plat->low = oldplat.low;
+	plat->high = oldplat.high;
+	plat->wait = oldplat.wait;
+	plat->count = oldplat.count;
+	plat->status = oldplat.status;
+	plat->oldstatus = oldplat.oldstatus;
+	plat->crush = oldplat.crush;
+	plat->tag = oldplat.tag;
+	plat->type = oldplat.type;
+	plat->sector->specialdata = plat;
+
+	if (oldplat.thinker.function.acp1)
+	    plat->thinker.function.acp1 = (actionf_p1)T_PlatRaise;
+
+	P_AddThinker (&plat->thinker);
+	P_AddActivePlat(plat);
+	break;
 				
-	  case tc_flash:
-	    PADSAVEP();
-	    flash = Z_Malloc (sizeof(*flash), PU_LEVEL, NULL);
-	    memcpy (flash, save_p, sizeof(*flash));
-	    save_p += sizeof(*flash);
-	    flash->sector = &sectors[(int)flash->sector];
-	    flash->thinker.function.acp1 = (actionf_p1)T_LightFlash;
-	    P_AddThinker (&flash->thinker);
-	    break;
+      case tc_flash:
+	flash = Z_Malloc (sizeof(*flash), PU_LEVEL, NULL);
+	memset (flash, 0, sizeof(*flash));
+	flash->sector = P_OldSpecialSector (&oldflash, sizeof(oldflash),
+					  &oldflash.sector);
+	flash->count = oldflash.count;
+	flash->maxlight = oldflash.maxlight;
+	flash->minlight = oldflash.minlight;
+	flash->maxtime = oldflash.maxtime;
+	flash->mintime = oldflash.mintime;
+	flash->thinker.function.acp1 = (actionf_p1)T_LightFlash;
+	P_AddThinker (&flash->thinker);
+	break;
 				
-	  case tc_strobe:
-	    PADSAVEP();
-	    strobe = Z_Malloc (sizeof(*strobe), PU_LEVEL, NULL);
-	    memcpy (strobe, save_p, sizeof(*strobe));
-	    save_p += sizeof(*strobe);
-	    strobe->sector = &sectors[(int)strobe->sector];
-	    strobe->thinker.function.acp1 = (actionf_p1)T_StrobeFlash;
-	    P_AddThinker (&strobe->thinker);
-	    break;
+      case tc_strobe:
+	strobe = Z_Malloc (sizeof(*strobe), PU_LEVEL, NULL);
+	memset (strobe, 0, sizeof(*strobe));
+	strobe->sector = P_OldSpecialSector (&oldstrobe, sizeof(oldstrobe),
+					  &oldstrobe.sector);
+	strobe->count = oldstrobe.count;
+	strobe->minlight = oldstrobe.minlight;
+	strobe->maxlight = oldstrobe.maxlight;
+	strobe->darktime = oldstrobe.darktime;
+	strobe->brighttime = oldstrobe.brighttime;
+	strobe->thinker.function.acp1 = (actionf_p1)T_StrobeFlash;
+	P_AddThinker (&strobe->thinker);
+	break;
 				
-	  case tc_glow:
-	    PADSAVEP();
-	    glow = Z_Malloc (sizeof(*glow), PU_LEVEL, NULL);
-	    memcpy (glow, save_p, sizeof(*glow));
-	    save_p += sizeof(*glow);
-	    glow->sector = &sectors[(int)glow->sector];
-	    glow->thinker.function.acp1 = (actionf_p1)T_Glow;
-	    P_AddThinker (&glow->thinker);
-	    break;
+      case tc_glow:
+	glow = Z_Malloc (sizeof(*glow), PU_LEVEL, NULL);
+	memset (glow, 0, sizeof(*glow));
+	glow->sector = P_OldSpecialSector (&oldglow, sizeof(oldglow),
+					  &oldglow.sector);
+	glow->minlight = oldglow.minlight;
+	glow->maxlight = oldglow.maxlight;
+	glow->direction = oldglow.direction;
+	glow->thinker.function.acp1 = (actionf_p1)T_Glow;
+	P_AddThinker (&glow->thinker);
+	break;
 				
-	  default:
-	    I_Error ("P_UnarchiveSpecials:Unknown tclass %i "
-		     "in savegame",tclass);
-	}
+      default:
+	I_Error ("P_UnarchiveSpecials:Unknown tclass %i "
+		 "in savegame",tclass);
+    }
+}
+
+
+//
+// P_UnArchiveSpecials
+//
+void P_UnArchiveSpecials (void)
+{
+    byte		tclass;
 	
+    // read in saved thinkers
+    while (1)
+    {
+	tclass = *save_p++;
+	if (tclass == tc_endspecials)
+	    return;	// end of list
+
+	P_UnArchiveOldSpecial (tclass);
+    }
+}
+
+
+
+//
+// Snapshots
+//
+// A snapshot is a savegame that restores the play state exactly,
+// so a demo played on from it does not desync: thinkers keep their
+// order, pointers between things are kept as indexes, thing lists
+// keep their order and heights keep their fractions. It is only
+// restored over the level it was taken on.
+//
+// A pointer to a thing already removed is kept as NULL, where the
+// game itself would go on reading freed memory.
+//
+
+extern int		prndindex;
+extern boolean		levelTimer;
+extern int		levelTimeCount;
+extern mobj_t*		braintargets[32];
+extern int		numbraintargets;
+extern int		braintargeton;
+
+enum
+{
+    sc_end,
+    sc_mobj,
+    sc_special
+
+} snapclass_e;
+
+// Things in thinker order, and by address to look up their index.
+typedef struct
+{
+    mobj_t*	mo;
+    int		index;
+} mobjindex_t;
+
+static mobj_t**		snapmobjs;
+static mobjindex_t*	snapindex;
+static int		numsnapmobjs;
+static int		maxsnapmobjs;
+
+
+static void P_SaveInt (int value)
+{
+    PADSAVEP();
+    memcpy (save_p, &value, sizeof(value));
+    save_p += sizeof(value);
+}
+
+
+static int P_LoadInt (void)
+{
+    int		value;
+
+    PADSAVEP();
+    memcpy (&value, save_p, sizeof(value));
+    save_p += sizeof(value);
+    return value;
+}
+
+
+static void P_GrowSnapMobjs (int count)
+{
+    if (count <= maxsnapmobjs)
+	return;
+
+    maxsnapmobjs = count*2;
+    snapmobjs = realloc (snapmobjs, maxsnapmobjs * sizeof(*snapmobjs));
+    snapindex = realloc (snapindex, maxsnapmobjs * sizeof(*snapindex));
+    if (!snapmobjs || !snapindex)
+	I_Error ("P_GrowSnapMobjs: out of memory");
+}
+
+
+static int P_CompareMobjIndex (const void* a, const void* b)
+{
+    uintptr_t	x = (uintptr_t)((const mobjindex_t*)a)->mo;
+    uintptr_t	y = (uintptr_t)((const mobjindex_t*)b)->mo;
+
+    return x < y ? -1 : x > y;
+}
+
+
+//
+// P_IndexMobjs
+// Numbers the things in thinker order, from 1.
+//
+static void P_IndexMobjs (void)
+{
+    thinker_t*	th;
+    int		count;
+
+    count = 0;
+    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+	if (th->function.acp1 == (actionf_p1)P_MobjThinker)
+	    count++;
+
+    P_GrowSnapMobjs (count);
+
+    numsnapmobjs = 0;
+    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    {
+	if (th->function.acp1 != (actionf_p1)P_MobjThinker)
+	    continue;
+
+	snapmobjs[numsnapmobjs] = (mobj_t *)th;
+	snapindex[numsnapmobjs].mo = (mobj_t *)th;
+	snapindex[numsnapmobjs].index = numsnapmobjs+1;
+	numsnapmobjs++;
     }
 
+    qsort (snapindex, numsnapmobjs, sizeof(*snapindex), P_CompareMobjIndex);
 }
 
+
+//
+// P_MobjIndex
+// 0 for NULL and things no longer in the world.
+//
+static int P_MobjIndex (mobj_t* mo)
+{
+    int		low;
+    int		high;
+    int		mid;
+
+    if (!mo)
+	return 0;
+
+    low = 0;
+    high = numsnapmobjs-1;
+    while (low <= high)
+    {
+	mid = (low+high) / 2;
+	if (snapindex[mid].mo == mo)
+	    return snapindex[mid].index;
+	if ((uintptr_t)snapindex[mid].mo < (uintptr_t)mo)
+	    low = mid+1;
+	else
+	    high = mid-1;
+    }
+
+    return 0;
+}
+
+
+static mobj_t* P_IndexedMobj (intptr_t index)
+{
+    if (index <= 0 || index > numsnapmobjs)
+	return NULL;
+
+    return snapmobjs[index-1];
+}
+
+
+//
+// P_SnapshotSize
+// At most what P_ArchiveSnapshot will write now.
+//
+int P_SnapshotSize (void)
+{
+    thinker_t*	th;
+    int		count;
+
+    count = 0;
+    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+	count++;
+
+    // every thinker at the size of a thing, which is the largest,
+    // and a thing list entry, cell and terminator for each
+    return 1024
+	+ MAXPLAYERS * (sizeof(player_t) + 8)
+	+ numsectors * (7*2 + 4*4 + 4)
+	+ numlines * (3*2 + 2*5*2)
+	+ numsides * 2*4
+	+ count * (sizeof(mobj_t) + 8 + 4*4)
+	+ MAXBUTTONS * 4*4
+	+ sizeof(itemrespawnque) + sizeof(itemrespawntime)
+	+ BODYQUESIZE * 4
+	+ 32 * 4;
+}
+
+
+//
+// P_ArchiveSnapshot
+//
+void P_ArchiveSnapshot (void)
+{
+    thinker_t*	th;
+    mobj_t*	mo;
+    mobj_t*	copy;
+    sector_t*	sec;
+    button_t*	button;
+    int		i;
+    int		j;
+
+    P_WakeSleepers ();
+    P_IndexMobjs ();
+
+    P_SaveInt (leveltime);
+    P_SaveInt (prndindex);
+    P_SaveInt (totalkills);
+    P_SaveInt (totalitems);
+    P_SaveInt (totalsecret);
+    P_SaveInt (levelTimer);
+    P_SaveInt (levelTimeCount);
+    P_SaveInt (numsnapmobjs);
+
+    P_ArchivePlayers ();
+    for (i=0 ; i<MAXPLAYERS ; i++)
+	if (playeringame[i])
+	    P_SaveInt (P_MobjIndex (players[i].attacker));
+
+    // P_ArchiveWorld keeps heights and offsets in whole units
+    P_ArchiveWorld ();
+    for (i=0, sec=sectors ; i<numsectors ; i++, sec++)
+    {
+	P_SaveInt (sec->floorheight);
+	P_SaveInt (sec->ceilingheight);
+	P_SaveInt (sec->soundtraversed);
+	P_SaveInt (P_MobjIndex (sec->soundtarget));
+    }
+    for (i=0 ; i<numsides ; i++)
+    {
+	P_SaveInt (sides[i].textureoffset);
+	P_SaveInt (sides[i].rowoffset);
+    }
+
+    // things and specials, in the order they think
+    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    {
+	if (th->function.acp1 == (actionf_p1)P_MobjThinker)
+	{
+	    *save_p++ = sc_mobj;
+	    mo = (mobj_t *)th;
+	    copy = P_ArchiveMobj (mo);
+	    copy->target = (mobj_t *)(intptr_t)P_MobjIndex (mo->target);
+	    copy->tracer = (mobj_t *)(intptr_t)P_MobjIndex (mo->tracer);
+	    continue;
+	}
+
+	*save_p++ = sc_special;
+	if (!P_ArchiveSpecial (th))
+	    save_p--;
+    }
+    *save_p++ = sc_end;
+
+    // the order of the thing lists decides what is hit first
+    for (i=0, sec=sectors ; i<numsectors ; i++, sec++)
+    {
+	for (mo = sec->thinglist ; mo ; mo = mo->snext)
+	    P_SaveInt (P_MobjIndex (mo));
+	P_SaveInt (0);
+    }
+    for (i=0 ; i<bmapwidth*bmapheight ; i++)
+    {
+	if (!blockthings[i].count)
+	    continue;
+
+	P_SaveInt (i+1);
+	for (j=blockthings[i].count-1 ; j>=0 ; j--)
+	    P_SaveInt (P_MobjIndex (mobjbyid[blockthings[i].ids[j]]));
+	P_SaveInt (0);
+    }
+    P_SaveInt (0);
+
+    for (i=0, button=buttonlist ; i<MAXBUTTONS ; i++, button++)
+    {
+	P_SaveInt (button->line ? button->line - lines + 1 : 0);
+	P_SaveInt (button->where);
+	P_SaveInt (button->btexture);
+	P_SaveInt (button->btimer);
+    }
+
+    P_SaveInt (iquehead);
+    P_SaveInt (iquetail);
+    memcpy (save_p, itemrespawnque, sizeof(itemrespawnque));
+    save_p += sizeof(itemrespawnque);
+    memcpy (save_p, itemrespawntime, sizeof(itemrespawntime));
+    save_p += sizeof(itemrespawntime);
+
+    P_SaveInt (bodyqueslot);
+    for (i=0 ; i<BODYQUESIZE ; i++)
+	P_SaveInt (P_MobjIndex (bodyque[i]));
+
+    P_SaveInt (numbraintargets);
+    P_SaveInt (braintargeton);
+    for (i=0 ; i<numbraintargets ; i++)
+	P_SaveInt (P_MobjIndex (braintargets[i]));
+}
+
+
+//
+// P_FreeThinkers
+// Frees every thinker and empties the thing and active lists,
+// without the side effects of P_RemoveMobj.
+//
+static void P_FreeThinkers (void)
+{
+    thinker_t*	th;
+    thinker_t*	next;
+    int		i;
+
+    for (th = thinkercap.next ; th != &thinkercap ; th = next)
+    {
+	next = th->next;
+	if (th->function.acp1 == (actionf_p1)P_MobjThinker)
+	{
+	    S_StopSound ((mobj_t *)th);
+	    P_DelSecNodes ((mobj_t *)th);
+	}
+	Z_Free (th);
+    }
+    P_InitThinkers ();
+
+    for (i=0 ; i<numsectors ; i++)
+	sectors[i].thinglist = NULL;
+    for (i=0 ; i<bmapwidth*bmapheight ; i++)
+    {
+	blockthings[i].count = 0;
+	blockthings[i].numcorpses = 0;
+    }
+    P_InitMobjIds ();
+
+    memset (activeceilings, 0, sizeof(activeceilings));
+    memset (activeplats, 0, sizeof(activeplats));
+}
+
+
+//
+// P_UnArchiveSnapshot
+//
+void P_UnArchiveSnapshot (void)
+{
+    mobj_t*	mo;
+    mobj_t*	prev;
+    sector_t*	sec;
+    button_t*	button;
+    byte	sclass;
+    int		count;
+    int		cell;
+    int		i;
+
+    leveltime = P_LoadInt ();
+    prndindex = P_LoadInt ();
+    totalkills = P_LoadInt ();
+    totalitems = P_LoadInt ();
+    totalsecret = P_LoadInt ();
+    levelTimer = P_LoadInt ();
+    levelTimeCount = P_LoadInt ();
+    count = P_LoadInt ();
+
+    P_GrowSnapMobjs (count);
+
+    // pointers to things are held as indexes until they are read
+    P_UnArchivePlayers ();
+    for (i=0 ; i<MAXPLAYERS ; i++)
+	if (playeringame[i])
+	    players[i].attacker = (mobj_t *)(intptr_t)P_LoadInt ();
+
+    P_UnArchiveWorld ();
+    for (i=0, sec=sectors ; i<numsectors ; i++, sec++)
+    {
+	sec->floorheight = P_LoadInt ();
+	sec->ceilingheight = P_LoadInt ();
+	sec->soundtraversed = P_LoadInt ();
+	sec->soundtarget = (mobj_t *)(intptr_t)P_LoadInt ();
+    }
+    for (i=0 ; i<numsides ; i++)
+    {
+	sides[i].textureoffset = P_LoadInt ();
+	sides[i].rowoffset = P_LoadInt ();
+    }
+
+    P_FreeThinkers ();
+
+    numsnapmobjs = 0;
+    while ((sclass = *save_p++) != sc_end)
+    {
+	switch (sclass)
+	{
+	  case sc_mobj:
+	    if (numsnapmobjs == count)
+		I_Error ("P_UnArchiveSnapshot: too many things");
+
+	    mo = P_UnArchiveMobj ();
+	    mo->subsector = R_PointInSubsector (mo->x, mo->y);
+	    mo->snext = mo->sprev = NULL;
+	    if (! (mo->flags & MF_NOBLOCKMAP) )
+		P_AddSecNodes (mo);
+	    P_AddThinker (&mo->thinker);
+	    snapmobjs[numsnapmobjs++] = mo;
+	    break;
+
+	  case sc_special:
+	    P_UnArchiveSpecial (*save_p++);
+	    break;
+
+	  default:
+	    I_Error ("P_UnArchiveSnapshot: unknown class %i", sclass);
+	}
+    }
+
+    for (i=0 ; i<numsnapmobjs ; i++)
+    {
+	mo = snapmobjs[i];
+	mo->target = P_IndexedMobj ((intptr_t)mo->target);
+	mo->tracer = P_IndexedMobj ((intptr_t)mo->tracer);
+    }
+    for (i=0 ; i<MAXPLAYERS ; i++)
+	if (playeringame[i])
+	    players[i].attacker = P_IndexedMobj ((intptr_t)players[i].attacker);
+    for (i=0, sec=sectors ; i<numsectors ; i++, sec++)
+	sec->soundtarget = P_IndexedMobj ((intptr_t)sec->soundtarget);
+
+    for (i=0, sec=sectors ; i<numsectors ; i++, sec++)
+    {
+	prev = NULL;
+	while ( (mo = P_IndexedMobj (P_LoadInt ())) )
+	{
+	    mo->sprev = prev;
+	    if (prev)
+		prev->snext = mo;
+	    else
+		sec->thinglist = mo;
+	    prev = mo;
+	}
+    }
+    // saved first to last in the order sweeps visit them
+    while ( (cell = P_LoadInt ()) )
+    {
+	while ( (mo = P_IndexedMobj (P_LoadInt ())) )
+	    P_LinkBlockThing (&blockthings[cell-1], 0, mo);
+    }
+
+    for (i=0, button=buttonlist ; i<MAXBUTTONS ; i++, button++)
+    {
+	cell = P_LoadInt ();
+	button->line = cell ? &lines[cell-1] : NULL;
+	button->where = P_LoadInt ();
+	button->btexture = P_LoadInt ();
+	button->btimer = P_LoadInt ();
+	button->soundorg = cell ?
+	    (mobj_t *)&button->line->frontsector->soundorg : NULL;
+    }
+
+    iquehead = P_LoadInt ();
+    iquetail = P_LoadInt ();
+    memcpy (itemrespawnque, save_p, sizeof(itemrespawnque));
+    save_p += sizeof(itemrespawnque);
+    memcpy (itemrespawntime, save_p, sizeof(itemrespawntime));
+    save_p += sizeof(itemrespawntime);
+
+    bodyqueslot = P_LoadInt ();
+    for (i=0 ; i<BODYQUESIZE ; i++)
+	bodyque[i] = P_IndexedMobj (P_LoadInt ());
+
+    numbraintargets = P_LoadInt ();
+    braintargeton = P_LoadInt ();
+    for (i=0 ; i<numbraintargets ; i++)
+	braintargets[i] = P_IndexedMobj (P_LoadInt ());
+}
+
+
+
+//
+// Compact savegames
+//
+// Every field is written on its own, little endian, as a varint
+// (signed ones zigzagged) unless noted, into a buffer that grows
+// as it is filled. The world is written as its changes from the
+// map as loaded, and a thing only writes the fields that are not
+// what it would have been spawned with. Pointers between things
+// are kept as indexes, as in snapshots.
+//
+
+// The map as it was loaded, before anything ran on it.
+typedef struct
+{
+    fixed_t	floorheight;
+    fixed_t	ceilingheight;
+    short	floorpic;
+    short	ceilingpic;
+    short	lightlevel;
+    short	special;
+    short	tag;
+} mapsector_state_t;
+
+typedef struct
+{
+    short	flags;
+    short	special;
+    short	tag;
+} mapline_state_t;
+
+typedef struct
+{
+    fixed_t	textureoffset;
+    fixed_t	rowoffset;
+    short	toptexture;
+    short	bottomtexture;
+    short	midtexture;
+} mapside_state_t;
+
+static mapsector_state_t*	mapsectors;
+static mapline_state_t*		maplines;
+static mapside_state_t*		mapsides;
+
+static byte*		savestart;
+static int		savemax;
+static byte*		saveend;
+
+enum
+{
+    sv_end,
+    sv_mobj,
+    sv_ceiling,
+    sv_door,
+    sv_floor,
+    sv_plat,
+    sv_flash,
+    sv_strobe,
+    sv_glow,
+    sv_fireflicker
+
+} saveclass_e;
+
+// Fields a thing writes when they differ from its spawn values.
+enum
+{
+    ms_angle	= 1,
+    ms_sprite	= 2,
+    ms_floorz	= 4,
+    ms_ceilingz	= 8,
+    ms_radius	= 16,
+    ms_height	= 32,
+    ms_mom	= 64,
+    ms_flags	= 128,
+    ms_health	= 256,
+    ms_move	= 512,
+    ms_target	= 1024,
+    ms_tracer	= 2048,
+    ms_reaction	= 4096,
+    ms_threshold = 8192,
+    ms_player	= 16384,
+    ms_lastlook	= 32768,
+    ms_spawn	= 65536,
+    ms_sleeping	= 131072
+
+} mobjsave_e;
+
+
+//
+// P_NoteMapState
+//
+void P_NoteMapState (void)
+{
+    int		i;
+
+    mapsectors = Z_Malloc (numsectors*sizeof(*mapsectors), PU_LEVEL, 0);
+    for (i=0 ; i<numsectors ; i++)
+    {
+	mapsectors[i].floorheight = sectors[i].floorheight;
+	mapsectors[i].ceilingheight = sectors[i].ceilingheight;
+	mapsectors[i].floorpic = sectors[i].floorpic;
+	mapsectors[i].ceilingpic = sectors[i].ceilingpic;
+	mapsectors[i].lightlevel = sectors[i].lightlevel;
+	mapsectors[i].special = sectors[i].special;
+	mapsectors[i].tag = sectors[i].tag;
+    }
+
+    maplines = Z_Malloc (numlines*sizeof(*maplines), PU_LEVEL, 0);
+    for (i=0 ; i<numlines ; i++)
+    {
+	maplines[i].flags = lines[i].flags;
+	maplines[i].special = lines[i].special;
+	maplines[i].tag = lines[i].tag;
+    }
+
+    mapsides = Z_Malloc (numsides*sizeof(*mapsides), PU_LEVEL, 0);
+    for (i=0 ; i<numsides ; i++)
+    {
+	mapsides[i].textureoffset = sides[i].textureoffset;
+	mapsides[i].rowoffset = sides[i].rowoffset;
+	mapsides[i].toptexture = sides[i].toptexture;
+	mapsides[i].bottomtexture = sides[i].bottomtexture;
+	mapsides[i].midtexture = sides[i].midtexture;
+    }
+}
+
+
+//
+// P_BeginSave
+//
+void P_BeginSave (void)
+{
+    savemax = 0x10000;
+    savestart = malloc (savemax);
+    if (!savestart)
+	I_Error ("P_BeginSave: out of memory");
+    save_p = savestart;
+}
+
+
+//
+// P_EndSave
+// The buffer is the caller's, to free.
+//
+byte* P_EndSave (int* length)
+{
+    byte*	buffer;
+
+    buffer = savestart;
+    *length = save_p - savestart;
+    savestart = NULL;
+    savemax = 0;
+    return buffer;
+}
+
+
+static void P_SaveRoom (int count)
+{
+    int		used;
+
+    used = save_p - savestart;
+    if (used + count <= savemax)
+	return;
+
+    while (used + count > savemax)
+	savemax *= 2;
+    savestart = realloc (savestart, savemax);
+    if (!savestart)
+	I_Error ("P_SaveRoom: out of memory");
+    save_p = savestart + used;
+}
+
+
+void P_WriteByte (int value)
+{
+    P_SaveRoom (1);
+    *save_p++ = value;
+}
+
+
+void P_WriteLong (int value)
+{
+    P_SaveRoom (4);
+    *save_p++ = value;
+    *save_p++ = value >> 8;
+    *save_p++ = value >> 16;
+    *save_p++ = value >> 24;
+}
+
+
+void P_WriteBytes (const void* data, int count)
+{
+    P_SaveRoom (count);
+    memcpy (save_p, data, count);
+    save_p += count;
+}
+
+
+static void P_WriteVar (unsigned value)
+{
+    P_SaveRoom (5);
+    while (value >= 0x80)
+    {
+	*save_p++ = (value & 0x7f) | 0x80;
+	value >>= 7;
+    }
+    *save_p++ = value;
+}
+
+
+static void P_WriteSigned (int value)
+{
+    P_WriteVar (((unsigned)value << 1) ^ (unsigned)(value >> 31));
+}
+
+
+//
+// P_BeginLoad
+//
+void P_BeginLoad (byte* buffer, int length)
+{
+    save_p = buffer;
+    saveend = buffer + length;
+}
+
+
+int P_ReadByte (void)
+{
+    if (save_p >= saveend)
+	I_Error ("Bad savegame: ends early");
+    return *save_p++;
+}
+
+
+int P_ReadLong (void)
+{
+    int		value;
+
+    value = P_ReadByte ();
+    value |= P_ReadByte () << 8;
+    value |= P_ReadByte () << 16;
+    value |= (unsigned)P_ReadByte () << 24;
+    return value;
+}
+
+
+void P_ReadBytes (void* data, int count)
+{
+    if (saveend - save_p < count)
+	I_Error ("Bad savegame: ends early");
+    memcpy (data, save_p, count);
+    save_p += count;
+}
+
+
+static unsigned P_ReadVar (void)
+{
+    unsigned	value;
+    unsigned	b;
+    int		shift;
+
+    value = 0;
+    for (shift = 0 ; shift < 35 ; shift += 7)
+    {
+	b = P_ReadByte ();
+	value |= (b & 0x7f) << shift;
+	if (! (b & 0x80) )
+	    return value;
+    }
+
+    I_Error ("Bad savegame: bad number");
+    return 0;
+}
+
+
+//
+// P_ReadNext
+// The element after last that P_WriteWorld wrote, -1 at the end.
+//
+static int P_ReadNext (int last, int count, const char* what)
+{
+    unsigned	gap;
+
+    gap = P_ReadVar ();
+    if (!gap)
+	return -1;
+    if (gap > (unsigned)(count - 1 - last))
+	I_Error ("Bad savegame: %s out of range", what);
+    return last + gap;
+}
+
+
+static int P_ReadSigned (void)
+{
+    unsigned	value;
+
+    value = P_ReadVar ();
+    return (value >> 1) ^ -(value & 1);
+}
+
+
+static int P_ReadIndex (int count, const char* what)
+{
+    unsigned	index;
+
+    index = P_ReadVar ();
+    if (index >= (unsigned)count)
+	I_Error ("Bad savegame: %s %u out of range", what, index);
+    return index;
+}
+
+
+//
+// P_WritePlayer
+//
+static void P_WritePlayer (player_t* p)
+{
+    int		i;
+    int		bits;
+    pspdef_t*	psp;
+
+    P_WriteVar (p->playerstate);
+    P_WriteSigned (p->cmd.forwardmove);
+    P_WriteSigned (p->cmd.sidemove);
+    P_WriteSigned (p->cmd.angleturn);
+    P_WriteSigned (p->cmd.consistancy);
+    P_WriteVar (p->cmd.chatchar);
+    P_WriteVar (p->cmd.buttons);
+
+    P_WriteSigned (p->viewz);
+    P_WriteSigned (p->viewheight);
+    P_WriteSigned (p->deltaviewheight);
+    P_WriteSigned (p->bob);
+    P_WriteSigned (p->health);
+    P_WriteSigned (p->armorpoints);
+    P_WriteSigned (p->armortype);
+
+    for (i=0 ; i<NUMPOWERS ; i++)
+	P_WriteSigned (p->powers[i]);
+    for (i=bits=0 ; i<NUMCARDS ; i++)
+	if (p->cards[i])
+	    bits |= 1<<i;
+    P_WriteVar (bits);
+    P_WriteVar (p->backpack);
+    for (i=0 ; i<MAXPLAYERS ; i++)
+	P_WriteSigned (p->frags[i]);
+
+    P_WriteVar (p->readyweapon);
+    P_WriteVar (p->pendingweapon);
+    for (i=bits=0 ; i<NUMWEAPONS ; i++)
+	if (p->weaponowned[i])
+	    bits |= 1<<i;
+    P_WriteVar (bits);
+    for (i=0 ; i<NUMAMMO ; i++)
+    {
+	P_WriteSigned (p->ammo[i]);
+	P_WriteSigned (p->maxammo[i]);
+    }
+
+    P_WriteSigned (p->attackdown);
+    P_WriteSigned (p->usedown);
+    P_WriteSigned (p->cheats);
+    P_WriteSigned (p->refire);
+    P_WriteSigned (p->killcount);
+    P_WriteSigned (p->itemcount);
+    P_WriteSigned (p->secretcount);
+    P_WriteSigned (p->damagecount);
+    P_WriteSigned (p->bonuscount);
+    P_WriteVar (P_MobjIndex (p->attacker));
+    P_WriteSigned (p->extralight);
+    P_WriteSigned (p->fixedcolormap);
+    P_WriteSigned (p->colormap);
+
+    for (i=0, psp=p->psprites ; i<NUMPSPRITES ; i++, psp++)
+    {
+	P_WriteVar (psp->state ? psp->state - states + 1 : 0);
+	P_WriteSigned (psp->tics);
+	P_WriteSigned (psp->sx);
+	P_WriteSigned (psp->sy);
+    }
+    P_WriteVar (p->didsecret);
+}
+
+
+//
+// P_ReadPlayer
+// The attacker is left as an index.
+//
+static void P_ReadPlayer (player_t* p)
+{
+    int		i;
+    int		bits;
+    pspdef_t*	psp;
+
+    memset (p->frags, 0, sizeof(p->frags));
+    p->mo = NULL;
+    p->message = NULL;
+
+    p->playerstate = P_ReadVar ();
+    p->cmd.forwardmove = P_ReadSigned ();
+    p->cmd.sidemove = P_ReadSigned ();
+    p->cmd.angleturn = P_ReadSigned ();
+    p->cmd.consistancy = P_ReadSigned ();
+    p->cmd.chatchar = P_ReadVar ();
+    p->cmd.buttons = P_ReadVar ();
+
+    p->viewz = P_ReadSigned ();
+    p->viewheight = P_ReadSigned ();
+    p->deltaviewheight = P_ReadSigned ();
+    p->bob = P_ReadSigned ();
+    p->health = P_ReadSigned ();
+    p->armorpoints = P_ReadSigned ();
+    p->armortype = P_ReadSigned ();
+
+    for (i=0 ; i<NUMPOWERS ; i++)
+	p->powers[i] = P_ReadSigned ();
+    bits = P_ReadVar ();
+    for (i=0 ; i<NUMCARDS ; i++)
+	p->cards[i] = (bits >> i) & 1;
+    p->backpack = P_ReadVar ();
+    for (i=0 ; i<MAXPLAYERS ; i++)
+	p->frags[i] = P_ReadSigned ();
+
+    p->readyweapon = P_ReadIndex (NUMWEAPONS, "weapon");
+    p->pendingweapon = P_ReadIndex (wp_nochange+1, "weapon");
+    bits = P_ReadVar ();
+    for (i=0 ; i<NUMWEAPONS ; i++)
+	p->weaponowned[i] = (bits >> i) & 1;
+    for (i=0 ; i<NUMAMMO ; i++)
+    {
+	p->ammo[i] = P_ReadSigned ();
+	p->maxammo[i] = P_ReadSigned ();
+    }
+
+    p->attackdown = P_ReadSigned ();
+    p->usedown = P_ReadSigned ();
+    p->cheats = P_ReadSigned ();
+    p->refire = P_ReadSigned ();
+    p->killcount = P_ReadSigned ();
+    p->itemcount = P_ReadSigned ();
+    p->secretcount = P_ReadSigned ();
+    p->damagecount = P_ReadSigned ();
+    p->bonuscount = P_ReadSigned ();
+    p->attacker = (mobj_t *)(intptr_t)P_ReadVar ();
+    p->extralight = P_ReadSigned ();
+    p->fixedcolormap = P_ReadSigned ();
+    p->colormap = P_ReadSigned ();
+
+    for (i=0, psp=p->psprites ; i<NUMPSPRITES ; i++, psp++)
+    {
+	bits = P_ReadIndex (NUMSTATES+1, "state");
+	psp->state = bits ? &states[bits-1] : NULL;
+	psp->tics = P_ReadSigned ();
+	psp->sx = P_ReadSigned ();
+	psp->sy = P_ReadSigned ();
+    }
+    p->didsecret = P_ReadVar ();
+}
+
+
+//
+// P_WriteWorld
+// Each changed sector, line and side is written as the distance
+// from the last one, a mask of its changed fields and the fields.
+//
+static void P_WriteWorld (void)
+{
+    int			i;
+    int			last;
+    int			mask;
+    sector_t*		sec;
+    mapsector_state_t*	msec;
+    line_t*		li;
+    mapline_state_t*	mli;
+    side_t*		si;
+    mapside_state_t*	msi;
+
+    for (i=0, last=-1, sec=sectors, msec=mapsectors ; i<numsectors ;
+	 i++, sec++, msec++)
+    {
+	mask = (sec->floorheight != msec->floorheight)
+	    | (sec->ceilingheight != msec->ceilingheight) << 1
+	    | (sec->floorpic != msec->floorpic) << 2
+	    | (sec->ceilingpic != msec->ceilingpic) << 3
+	    | (sec->lightlevel != msec->lightlevel) << 4
+	    | (sec->special != msec->special) << 5
+	    | (sec->tag != msec->tag) << 6;
+	if (!mask)
+	    continue;
+
+	P_WriteVar (i - last);
+	P_WriteVar (mask);
+	if (mask & 1)
+	    P_WriteSigned (sec->floorheight - msec->floorheight);
+	if (mask & 2)
+	    P_WriteSigned (sec->ceilingheight - msec->ceilingheight);
+	if (mask & 4)
+	    P_WriteSigned (sec->floorpic);
+	if (mask & 8)
+	    P_WriteSigned (sec->ceilingpic);
+	if (mask & 16)
+	    P_WriteSigned (sec->lightlevel);
+	if (mask & 32)
+	    P_WriteSigned (sec->special);
+	if (mask & 64)
+	    P_WriteSigned (sec->tag);
+	last = i;
+    }
+    P_WriteVar (0);
+
+    for (i=0, last=-1, li=lines, mli=maplines ; i<numlines ; i++, li++, mli++)
+    {
+	mask = (li->flags != mli->flags)
+	    | (li->special != mli->special) << 1
+	    | (li->tag != mli->tag) << 2;
+	if (!mask)
+	    continue;
+
+	P_WriteVar (i - last);
+	P_WriteVar (mask);
+	if (mask & 1)
+	    P_WriteSigned (li->flags);
+	if (mask & 2)
+	    P_WriteSigned (li->special);
+	if (mask & 4)
+	    P_WriteSigned (li->tag);
+	last = i;
+    }
+    P_WriteVar (0);
+
+    for (i=0, last=-1, si=sides, msi=mapsides ; i<numsides ; i++, si++, msi++)
+    {
+	mask = (si->textureoffset != msi->textureoffset)
+	    | (si->rowoffset != msi->rowoffset) << 1
+	    | (si->toptexture != msi->toptexture) << 2
+	    | (si->bottomtexture != msi->bottomtexture) << 3
+	    | (si->midtexture != msi->midtexture) << 4;
+	if (!mask)
+	    continue;
+
+	P_WriteVar (i - last);
+	P_WriteVar (mask);
+	if (mask & 1)
+	    P_WriteSigned (si->textureoffset - msi->textureoffset);
+	if (mask & 2)
+	    P_WriteSigned (si->rowoffset - msi->rowoffset);
+	if (mask & 4)
+	    P_WriteSigned (si->toptexture);
+	if (mask & 8)
+	    P_WriteSigned (si->bottomtexture);
+	if (mask & 16)
+	    P_WriteSigned (si->midtexture);
+	last = i;
+    }
+    P_WriteVar (0);
+}
+
+
+//
+// P_ReadWorld
+// Puts the map back as loaded, then applies the changes.
+//
+static void P_ReadWorld (void)
+{
+    int			i;
+    int			mask;
+    sector_t*		sec;
+    mapsector_state_t*	msec;
+    line_t*		li;
+    mapline_state_t*	mli;
+    side_t*		si;
+    mapside_state_t*	msi;
+    boolean		retag;
+
+    retag = false;
+    heightchanges++;
+    for (i=0, sec=sectors, msec=mapsectors ; i<numsectors ; i++, sec++, msec++)
+    {
+	sec->floorheight = msec->floorheight;
+	sec->ceilingheight = msec->ceilingheight;
+	sec->floorpic = msec->floorpic;
+	sec->ceilingpic = msec->ceilingpic;
+	sec->lightlevel = msec->lightlevel;
+	sec->special = msec->special;
+	sec->tag = msec->tag;
+	sec->specialdata = 0;
+	sec->soundtarget = 0;
+    }
+    for (i=0, li=lines, mli=maplines ; i<numlines ; i++, li++, mli++)
+    {
+	li->flags = mli->flags;
+	li->special = mli->special;
+	li->tag = mli->tag;
+    }
+    for (i=0, si=sides, msi=mapsides ; i<numsides ; i++, si++, msi++)
+    {
+	si->textureoffset = msi->textureoffset;
+	si->rowoffset = msi->rowoffset;
+	si->toptexture = msi->toptexture;
+	si->bottomtexture = msi->bottomtexture;
+	si->midtexture = msi->midtexture;
+    }
+
+    for (i=-1 ; (i = P_ReadNext (i, numsectors, "sector")) >= 0 ; )
+    {
+	sec = &sectors[i];
+	msec = &mapsectors[i];
+	mask = P_ReadVar ();
+	if (mask & 1)
+	    sec->floorheight = msec->floorheight + P_ReadSigned ();
+	if (mask & 2)
+	    sec->ceilingheight = msec->ceilingheight + P_ReadSigned ();
+	if (mask & 4)
+	    sec->floorpic = P_ReadSigned ();
+	if (mask & 8)
+	    sec->ceilingpic = P_ReadSigned ();
+	if (mask & 16)
+	    sec->lightlevel = P_ReadSigned ();
+	if (mask & 32)
+	    sec->special = P_ReadSigned ();
+	if (mask & 64)
+	{
+	    sec->tag = P_ReadSigned ();
+	    retag = true;
+	}
+    }
+
+    for (i=-1 ; (i = P_ReadNext (i, numlines, "line")) >= 0 ; )
+    {
+	li = &lines[i];
+	mask = P_ReadVar ();
+	if (mask & 1)
+	    li->flags = P_ReadSigned ();
+	if (mask & 2)
+	    li->special = P_ReadSigned ();
+	if (mask & 4)
+	    li->tag = P_ReadSigned ();
+    }
+
+    for (i=-1 ; (i = P_ReadNext (i, numsides, "side")) >= 0 ; )
+    {
+	si = &sides[i];
+	msi = &mapsides[i];
+	mask = P_ReadVar ();
+	if (mask & 1)
+	    si->textureoffset = msi->textureoffset + P_ReadSigned ();
+	if (mask & 2)
+	    si->rowoffset = msi->rowoffset + P_ReadSigned ();
+	if (mask & 4)
+	    si->toptexture = P_ReadSigned ();
+	if (mask & 8)
+	    si->bottomtexture = P_ReadSigned ();
+	if (mask & 16)
+	    si->midtexture = P_ReadSigned ();
+    }
+
+    if (retag)
+	P_InitTagLists ();
+}
+
+
+//
+// P_WriteMobj
+//
+static void P_WriteMobj (mobj_t* mo)
+{
+    mobjinfo_t*	info;
+    sector_t*	sec;
+    int		mask;
+
+    info = mo->info;
+    sec = mo->subsector->sector;
+
+    mask = 0;
+    if (mo->angle)
+	mask |= ms_angle;
+    if (mo->sprite != mo->state->sprite || mo->frame != mo->state->frame)
+	mask |= ms_sprite;
+    if (mo->floorz != sec->floorheight)
+	mask |= ms_floorz;
+    if (mo->ceilingz != sec->ceilingheight)
+	mask |= ms_ceilingz;
+    if (mo->radius != info->radius)
+	mask |= ms_radius;
+    if (mo->height != info->height)
+	mask |= ms_height;
+    if (mo->momx || mo->momy || mo->momz)
+	mask |= ms_mom;
+    if (mo->flags != info->flags)
+	mask |= ms_flags;
+    if (mo->health != info->spawnhealth)
+	mask |= ms_health;
+    if (mo->movedir || mo->movecount)
+	mask |= ms_move;
+    if (P_MobjIndex (mo->target))
+	mask |= ms_target;
+    if (P_MobjIndex (mo->tracer))
+	mask |= ms_tracer;
+    if (mo->reactiontime != info->reactiontime)
+	mask |= ms_reaction;
+    if (mo->threshold)
+	mask |= ms_threshold;
+    if (mo->player)
+	mask |= ms_player;
+    if (mo->lastlook)
+	mask |= ms_lastlook;
+    if (mo->spawnpoint.x || mo->spawnpoint.y || mo->spawnpoint.angle
+	|| mo->spawnpoint.type || mo->spawnpoint.options)
+	mask |= ms_spawn;
+    if (mo->thinker.activity == ta_sleeping)
+	mask |= ms_sleeping;
+
+    P_WriteVar (mo->type);
+    P_WriteVar (mask);
+    P_WriteSigned (mo->x);
+    P_WriteSigned (mo->y);
+    P_WriteSigned (mo->z);
+    P_WriteVar (mo->state - states);
+    P_WriteSigned (mo->tics);
+
+    if (mask & ms_angle)
+	P_WriteVar (mo->angle);
+    if (mask & ms_sprite)
+    {
+	P_WriteVar (mo->sprite);
+	P_WriteVar (mo->frame);
+    }
+    if (mask & ms_floorz)
+	P_WriteSigned (mo->floorz - sec->floorheight);
+    if (mask & ms_ceilingz)
+	P_WriteSigned (mo->ceilingz - sec->ceilingheight);
+    if (mask & ms_radius)
+	P_WriteSigned (mo->radius);
+    if (mask & ms_height)
+	P_WriteSigned (mo->height);
+    if (mask & ms_mom)
+    {
+	P_WriteSigned (mo->momx);
+	P_WriteSigned (mo->momy);
+	P_WriteSigned (mo->momz);
+    }
+    if (mask & ms_flags)
+	P_WriteVar (mo->flags);
+    if (mask & ms_health)
+	P_WriteSigned (mo->health);
+    if (mask & ms_move)
+    {
+	P_WriteVar (mo->movedir);
+	P_WriteSigned (mo->movecount);
+    }
+    if (mask & ms_target)
+	P_WriteVar (P_MobjIndex (mo->target));
+    if (mask & ms_tracer)
+	P_WriteVar (P_MobjIndex (mo->tracer));
+    if (mask & ms_reaction)
+	P_WriteSigned (mo->reactiontime);
+    if (mask & ms_threshold)
+	P_WriteSigned (mo->threshold);
+    if (mask & ms_player)
+	P_WriteVar (mo->player - players);
+    if (mask & ms_lastlook)
+	P_WriteVar (mo->lastlook);
+    if (mask & ms_spawn)
+    {
+	P_WriteSigned (mo->spawnpoint.x);
+	P_WriteSigned (mo->spawnpoint.y);
+	P_WriteSigned (mo->spawnpoint.angle);
+	P_WriteSigned (mo->spawnpoint.type);
+	P_WriteSigned (mo->spawnpoint.options);
+    }
+    if (mask & ms_sleeping)
+	P_WriteVar (leveltime - mo->sleeptic);
+}
+
+
+//
+// P_ReadMobj
+// The thing is linked, but not added as a thinker, and its
+// target and tracer are left as indexes.
+//
+static mobj_t* P_ReadMobj (void)
+{
+    mobj_t*	mo;
+    mobjinfo_t*	info;
+    sector_t*	sec;
+    int		mask;
+    int		i;
+
+    mo = Z_Malloc (sizeof(*mo), PU_LEVEL, NULL);
+    memset (mo, 0, sizeof(*mo));
+
+    mo->type = P_ReadIndex (NUMMOBJTYPES, "thing type");
+    mo->info = info = &mobjinfo[mo->type];
+    mask = P_ReadVar ();
+    mo->x = P_ReadSigned ();
+    mo->y = P_ReadSigned ();
+    mo->z = P_ReadSigned ();
+    mo->state = &states[P_ReadIndex (NUMSTATES, "state")];
+    mo->tics = P_ReadSigned ();
+
+    mo->angle = mask & ms_angle ? P_ReadVar () : 0;
+    if (mask & ms_sprite)
+    {
+	mo->sprite = P_ReadIndex (NUMSPRITES, "sprite");
+	mo->frame = P_ReadVar ();
+    }
+    else
+    {
+	mo->sprite = mo->state->sprite;
+	mo->frame = mo->state->frame;
+    }
+
+    // the offsets from the sector are added once it is linked
+    mo->floorz = mask & ms_floorz ? P_ReadSigned () : 0;
+    mo->ceilingz = mask & ms_ceilingz ? P_ReadSigned () : 0;
+    mo->radius = mask & ms_radius ? P_ReadSigned () : info->radius;
+    mo->height = mask & ms_height ? P_ReadSigned () : info->height;
+    if (mask & ms_mom)
+    {
+	mo->momx = P_ReadSigned ();
+	mo->momy = P_ReadSigned ();
+	mo->momz = P_ReadSigned ();
+    }
+    mo->flags = mask & ms_flags ? P_ReadVar () : info->flags;
+    mo->health = mask & ms_health ? P_ReadSigned () : info->spawnhealth;
+    if (mask & ms_move)
+    {
+	mo->movedir = P_ReadVar ();
+	mo->movecount = P_ReadSigned ();
+    }
+    if (mask & ms_target)
+	mo->target = (mobj_t *)(intptr_t)P_ReadVar ();
+    if (mask & ms_tracer)
+	mo->tracer = (mobj_t *)(intptr_t)P_ReadVar ();
+    mo->reactiontime = mask & ms_reaction ? P_ReadSigned ()
+	: info->reactiontime;
+    mo->threshold = mask & ms_threshold ? P_ReadSigned () : 0;
+    if (mask & ms_player)
+    {
+	i = P_ReadIndex (MAXPLAYERS, "player");
+	if (!playeringame[i])
+	    I_Error ("Bad savegame: player %i is not in the game", i);
+	mo->player = &players[i];
+	mo->player->mo = mo;
+    }
+    mo->lastlook = mask & ms_lastlook ? P_ReadVar () : 0;
+    if (mask & ms_spawn)
+    {
+	mo->spawnpoint.x = P_ReadSigned ();
+	mo->spawnpoint.y = P_ReadSigned ();
+	mo->spawnpoint.angle = P_ReadSigned ();
+	mo->spawnpoint.type = P_ReadSigned ();
+	mo->spawnpoint.options = P_ReadSigned ();
+    }
+
+    // a sleeping monster is behind on its states, so it
+    // is woken, up to the last tic that was run
+    if (mask & ms_sleeping)
+    {
+	i = P_ReadVar ();
+	if (i < 0 || i > leveltime)
+	    I_Error ("Bad savegame: slept %i tics", i);
+	mo->sleeptic = leveltime - i;
+	P_CatchUpSleeper (mo, leveltime-1);
+    }
+
+    mo->thinker.function.acp1 = (actionf_p1)P_MobjThinker;
+    P_NewMobjId (mo);
+    P_SetThingPosition (mo);
+
+    sec = mo->subsector->sector;
+    mo->floorz += sec->floorheight;
+    mo->ceilingz += sec->ceilingheight;
+
+    return mo;
+}
+
+
+//
+// P_SaveClass
+// The class a thinker is saved as, sv_end if it is not saved.
+//
+static int P_SaveClass (thinker_t* th)
+{
+    actionf_p1	func;
+    int		i;
+
+    func = th->function.acp1;
+
+    if (func == (actionf_p1)P_MobjThinker)
+	return sv_mobj;
+    if (func == (actionf_p1)T_MoveCeiling)
+	return sv_ceiling;
+    if (func == (actionf_p1)T_VerticalDoor)
+	return sv_door;
+    if (func == (actionf_p1)T_MoveFloor)
+	return sv_floor;
+    if (func == (actionf_p1)T_PlatRaise)
+	return sv_plat;
+    if (func == (actionf_p1)T_LightFlash)
+	return sv_flash;
+    if (func == (actionf_p1)T_StrobeFlash)
+	return sv_strobe;
+    if (func == (actionf_p1)T_Glow)
+	return sv_glow;
+    if (func == (actionf_p1)T_FireFlicker)
+	return sv_fireflicker;
+
+    if (!func)
+    {
+	// in stasis
+	for (i = 0; i < MAXCEILINGS;i++)
+	    if (activeceilings[i] == (ceiling_t *)th)
+		return sv_ceiling;
+	for (i = 0; i < MAXPLATS;i++)
+	    if (activeplats[i] == (plat_t *)th)
+		return sv_plat;
+    }
+
+    return sv_end;
+}
+
+
+//
+// P_WriteSpecial
+// Every special starts with its sector.
+//
+static void P_WriteSpecial (int sclass, thinker_t* th)
+{
+    ceiling_t*		ceiling;
+    vldoor_t*		door;
+    floormove_t*	floor;
+    plat_t*		plat;
+    lightflash_t*	flash;
+    strobe_t*		strobe;
+    glow_t*		glow;
+    fireflicker_t*	flick;
+
+    switch (sclass)
+    {
+      case sv_ceiling:
+	ceiling = (ceiling_t *)th;
+	P_WriteVar (ceiling->sector - sectors);
+	P_WriteVar (ceiling->thinker.function.acp1 != NULL);
+	P_WriteVar (ceiling->type);
+	P_WriteSigned (ceiling->bottomheight);
+	P_WriteSigned (ceiling->topheight);
+	P_WriteSigned (ceiling->speed);
+	P_WriteVar (ceiling->crush);
+	P_WriteSigned (ceiling->direction);
+	P_WriteSigned (ceiling->tag);
+	P_WriteSigned (ceiling->olddirection);
+	break;
+
+      case sv_door:
+	door = (vldoor_t *)th;
+	P_WriteVar (door->sector - sectors);
+	P_WriteVar (door->type);
+	P_WriteSigned (door->topheight);
+	P_WriteSigned (door->speed);
+	P_WriteSigned (door->direction);
+	P_WriteSigned (door->topwait);
+	P_WriteSigned (door->topcountdown);
+	break;
+
+      case sv_floor:
+	floor = (floormove_t *)th;
+	P_WriteVar (floor->sector - sectors);
+	P_WriteVar (floor->type);
+	P_WriteVar (floor->crush);
+	P_WriteSigned (floor->direction);
+	P_WriteSigned (floor->newspecial);
+	P_WriteSigned (floor->texture);
+	P_WriteSigned (floor->floordestheight);
+	P_WriteSigned (floor->speed);
+	break;
+
+      case sv_plat:
+	plat = (plat_t *)th;
+	P_WriteVar (plat->sector - sectors);
+	P_WriteVar (plat->thinker.function.acp1 != NULL);
+	P_WriteSigned (plat->speed);
+	P_WriteSigned (plat->low);
+	P_WriteSigned (plat->high);
+	P_WriteSigned (plat->wait);
+	P_WriteSigned (plat->count);
+	P_WriteVar (plat->status);
+	P_WriteVar (plat->oldstatus);
+	P_WriteVar (plat->crush);
+	P_WriteSigned (plat->tag);
+	P_WriteVar (plat->type);
+	break;
+
+      case sv_flash:
+	flash = (lightflash_t *)th;
+	P_WriteVar (flash->sector - sectors);
+	P_WriteSigned (flash->count);
+	P_WriteSigned (flash->maxlight);
+	P_WriteSigned (flash->minlight);
+	P_WriteSigned (flash->maxtime);
+	P_WriteSigned (flash->mintime);
+	break;
+
+      case sv_strobe:
+	strobe = (strobe_t *)th;
+	P_WriteVar (strobe->sector - sectors);
+	P_WriteSigned (strobe->count);
+	P_WriteSigned (strobe->minlight);
+	P_WriteSigned (strobe->maxlight);
+	P_WriteSigned (strobe->darktime);
+	P_WriteSigned (strobe->brighttime);
+	break;
+
+      case sv_glow:
+	glow = (glow_t *)th;
+	P_WriteVar (glow->sector - sectors);
+	P_WriteSigned (glow->minlight);
+	P_WriteSigned (glow->maxlight);
+	P_WriteSigned (glow->direction);
+	break;
+
+      case sv_fireflicker:
+	flick = (fireflicker_t *)th;
+	P_WriteVar (flick->sector - sectors);
+	P_WriteSigned (flick->count);
+	P_WriteSigned (flick->maxlight);
+	P_WriteSigned (flick->minlight);
+	break;
+    }
+}
+
+
+//
+// P_ReadSpecial
+// Reads one special of class sclass and starts it.
+//
+static void P_ReadSpecial (int sclass)
+{
+    sector_t*		sec;
+    ceiling_t*		ceiling;
+    vldoor_t*		door;
+    floormove_t*	floor;
+    plat_t*		plat;
+    lightflash_t*	flash;
+    strobe_t*		strobe;
+    glow_t*		glow;
+    fireflicker_t*	flick;
+
+    sec = &sectors[P_ReadIndex (numsectors, "sector")];
+
+    switch (sclass)
+    {
+      case sv_ceiling:
+	ceiling = Z_Malloc (sizeof(*ceiling), PU_LEVEL, NULL);
+	ceiling->sector = sec;
+	ceiling->thinker.function.acp1 = P_ReadVar () ?
+	    (actionf_p1)T_MoveCeiling : NULL;
+	ceiling->type = P_ReadVar ();
+	ceiling->bottomheight = P_ReadSigned ();
+	ceiling->topheight = P_ReadSigned ();
+	ceiling->speed = P_ReadSigned ();
+	ceiling->crush = P_ReadVar ();
+	ceiling->direction = P_ReadSigned ();
+	ceiling->tag = P_ReadSigned ();
+	ceiling->olddirection = P_ReadSigned ();
+	sec->specialdata = ceiling;
+	P_AddThinker (&ceiling->thinker);
+	P_AddActiveCeiling (ceiling);
+	break;
+
+      case sv_door:
+	door = Z_Malloc (sizeof(*door), PU_LEVEL, NULL);
+	door->sector = sec;
+	door->type = P_ReadVar ();
+	door->topheight = P_ReadSigned ();
+	door->speed = P_ReadSigned ();
+	door->direction = P_ReadSigned ();
+	door->topwait = P_ReadSigned ();
+	door->topcountdown = P_ReadSigned ();
+	door->thinker.function.acp1 = (actionf_p1)T_VerticalDoor;
+	sec->specialdata = door;
+	P_AddThinker (&door->thinker);
+	break;
+
+      case sv_floor:
+	floor = Z_Malloc (sizeof(*floor), PU_LEVEL, NULL);
+	floor->sector = sec;
+	floor->type = P_ReadVar ();
+	floor->crush = P_ReadVar ();
+	floor->direction = P_ReadSigned ();
+	floor->newspecial = P_ReadSigned ();
+	floor->texture = P_ReadSigned ();
+	floor->floordestheight = P_ReadSigned ();
+	floor->speed = P_ReadSigned ();
+	floor->thinker.function.acp1 = (actionf_p1)T_MoveFloor;
+	sec->specialdata = floor;
+	P_AddThinker (&floor->thinker);
+	break;
+
+      case sv_plat:
+	plat = Z_Malloc (sizeof(*plat), PU_LEVEL, NULL);
+	plat->sector = sec;
+	plat->thinker.function.acp1 = P_ReadVar () ?
+	    (actionf_p1)T_PlatRaise : NULL;
+	plat->speed = P_ReadSigned ();
+	plat->low = P_ReadSigned ();
+	plat->high = P_ReadSigned ();
+	plat->wait = P_ReadSigned ();
+	plat->count = P_ReadSigned ();
+	plat->status = P_ReadVar ();
+	plat->oldstatus = P_ReadVar ();
+	plat->crush = P_ReadVar ();
+	plat->tag = P_ReadSigned ();
+	plat->type = P_ReadVar ();
+	sec->specialdata = plat;
+	P_AddThinker (&plat->thinker);
+	P_AddActivePlat (plat);
+	break;
+
+      case sv_flash:
+	flash = Z_Malloc (sizeof(*flash), PU_LEVEL, NULL);
+	flash->sector = sec;
+	flash->count = P_ReadSigned ();
+	flash->maxlight = P_ReadSigned ();
+	flash->minlight = P_ReadSigned ();
+	flash->maxtime = P_ReadSigned ();
+	flash->mintime = P_ReadSigned ();
+	flash->thinker.function.acp1 = (actionf_p1)T_LightFlash;
+	P_AddThinker (&flash->thinker);
+	break;
+
+      case sv_strobe:
+	strobe = Z_Malloc (sizeof(*strobe), PU_LEVEL, NULL);
+	strobe->sector = sec;
+	strobe->count = P_ReadSigned ();
+	strobe->minlight = P_ReadSigned ();
+	strobe->maxlight = P_ReadSigned ();
+	strobe->darktime = P_ReadSigned ();
+	strobe->brighttime = P_ReadSigned ();
+	strobe->thinker.function.acp1 = (actionf_p1)T_StrobeFlash;
+	P_AddThinker (&strobe->thinker);
+	break;
+
+      case sv_glow:
+	glow = Z_Malloc (sizeof(*glow), PU_LEVEL, NULL);
+	glow->sector = sec;
+	glow->minlight = P_ReadSigned ();
+	glow->maxlight = P_ReadSigned ();
+	glow->direction = P_ReadSigned ();
+	glow->thinker.function.acp1 = (actionf_p1)T_Glow;
+	P_AddThinker (&glow->thinker);
+	break;
+
+      case sv_fireflicker:
+	flick = Z_Malloc (sizeof(*flick), PU_LEVEL, NULL);
+	flick->sector = sec;
+	flick->count = P_ReadSigned ();
+	flick->maxlight = P_ReadSigned ();
+	flick->minlight = P_ReadSigned ();
+	flick->thinker.function.acp1 = (actionf_p1)T_FireFlicker;
+	P_AddThinker (&flick->thinker);
+	break;
+    }
+}
+
+
+//
+// P_WriteGame
+// Players, world and thinkers, after the header G_DoSaveGame writes.
+//
+void P_WriteGame (void)
+{
+    thinker_t*	th;
+    int		sclass;
+    int		i;
+
+    // sleeping monsters are saved as they are, and
+    // woken when loaded, so saving changes nothing
+    P_IndexMobjs ();
+
+    P_WriteVar (numsnapmobjs);
+    for (i=0 ; i<MAXPLAYERS ; i++)
+	if (playeringame[i])
+	    P_WritePlayer (&players[i]);
+
+    P_WriteWorld ();
+
+    // things and specials, in the order they think
+    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    {
+	sclass = P_SaveClass (th);
+	if (sclass == sv_end)
+	    continue;
+
+	P_WriteVar (sclass);
+	if (sclass == sv_mobj)
+	    P_WriteMobj ((mobj_t *)th);
+	else
+	    P_WriteSpecial (sclass, th);
+    }
+    P_WriteVar (sv_end);
+
+    P_WriteVar (bodyqueslot);
+    for (i=0 ; i<BODYQUESIZE ; i++)
+	P_WriteVar (P_MobjIndex (bodyque[i]));
+
+    P_WriteVar (numbraintargets);
+    P_WriteVar (braintargeton);
+    for (i=0 ; i<numbraintargets ; i++)
+	P_WriteVar (P_MobjIndex (braintargets[i]));
+}
+
+
+//
+// P_ReadGame
+// Over the base level G_DoLoadGame has set up.
+//
+void P_ReadGame (void)
+{
+    mobj_t*	mo;
+    int		count;
+    int		sclass;
+    int		i;
+
+    // every thing takes a few bytes at least
+    count = P_ReadVar ();
+    if (count > saveend - save_p)
+	I_Error ("Bad savegame: %i things", count);
+    P_GrowSnapMobjs (count);
+
+    for (i=0 ; i<MAXPLAYERS ; i++)
+	if (playeringame[i])
+	    P_ReadPlayer (&players[i]);
+
+    P_ReadWorld ();
+
+    P_FreeThinkers ();
+
+    numsnapmobjs = 0;
+    while ( (sclass = P_ReadVar ()) != sv_end)
+    {
+	switch (sclass)
+	{
+	  case sv_mobj:
+	    if (numsnapmobjs == count)
+		I_Error ("Bad savegame: too many things");
+
+	    mo = P_ReadMobj ();
+	    P_AddThinker (&mo->thinker);
+	    snapmobjs[numsnapmobjs++] = mo;
+	    break;
+
+	  case sv_ceiling:
+	  case sv_door:
+	  case sv_floor:
+	  case sv_plat:
+	  case sv_flash:
+	  case sv_strobe:
+	  case sv_glow:
+	  case sv_fireflicker:
+	    P_ReadSpecial (sclass);
+	    break;
+
+	  default:
+	    I_Error ("Bad savegame: unknown class %i", sclass);
+	}
+    }
+
+    for (i=0 ; i<numsnapmobjs ; i++)
+    {
+	mo = snapmobjs[i];
+	mo->target = P_IndexedMobj ((intptr_t)mo->target);
+	mo->tracer = P_IndexedMobj ((intptr_t)mo->tracer);
+    }
+    for (i=0 ; i<MAXPLAYERS ; i++)
+	if (playeringame[i])
+	    players[i].attacker = P_IndexedMobj ((intptr_t)players[i].attacker);
+
+    bodyqueslot = P_ReadVar ();
+    for (i=0 ; i<BODYQUESIZE ; i++)
+	bodyque[i] = P_IndexedMobj (P_ReadVar ());
+
+    numbraintargets = P_ReadIndex (33, "brain target count");
+    braintargeton = P_ReadVar ();
+    for (i=0 ; i<numbraintargets ; i++)
+	braintargets[i] = P_IndexedMobj (P_ReadVar ());
+}
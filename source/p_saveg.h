@@ -28,16 +28,38 @@
 #define __P_SAVEG__
 
 // Persistent storage/archiving.
-// These are the load / save game routines.
+// The old savegame format, still read, and used in snapshots.
 void P_ArchivePlayers (void);
 void P_UnArchivePlayers (void);
 void P_ArchiveWorld (void);
 void P_UnArchiveWorld (void);
-void P_ArchiveThinkers (void);
 void P_UnArchiveThinkers (void);
-void P_ArchiveSpecials (void);
 void P_UnArchiveSpecials (void);
 
+// Exact copies of the play state of the loaded level,
+// for seeking in demos.
+int P_SnapshotSize (void);
+void P_ArchiveSnapshot (void);
+void P_UnArchiveSnapshot (void);
+
+// Compact savegames, written field by field into a buffer
+// that grows as needed, with the world kept as its changes
+// from the map as loaded. P_EndSave hands the buffer over,
+// for the caller to free.
+void P_NoteMapState (void);
+void P_BeginSave (void);
+byte* P_EndSave (int* length);
+void P_WriteByte (int value);
+void P_WriteLong (int value);
+void P_WriteBytes (const void* data, int count);
+void P_WriteGame (void);
+
+void P_BeginLoad (byte* buffer, int length);
+int P_ReadByte (void);
+int P_ReadLong (void);
+void P_ReadBytes (void* data, int count);
+void P_ReadGame (void);
+
 extern byte*		save_p; 
 
 #endif
@@ -30,6 +30,7 @@
 
 #include "m_swap.h"
 #include "m_bbox.h"
+#include "m_argv.h"
 
 #include "g_game.h"
 
@@ -38,6 +39,8 @@
 
 #include "doomdef.h"
 #include "p_local.h"
+#include "p_reject.h"
+#include "p_saveg.h"
 
 #include "s_sound.h"
 
@@ -90,7 +93,7 @@ short*		blockmaplump;
 fixed_t		bmaporgx;
 fixed_t		bmaporgy;
 // for thing chains
-mobj_t**	blocklinks;		
+blockthings_t*	blockthings;
 
 
 // REJECT
@@ -482,9 +485,9 @@ void P_LoadBlockMap (int lump)
     bmapheight = blockmaplump[3];
 	
     // clear out mobj chains
-    count = sizeof(*blocklinks)* bmapwidth*bmapheight;
-    blocklinks = Z_Malloc (count,PU_LEVEL, 0);
-    memset (blocklinks, 0, count);
+    count = sizeof(*blockthings)* bmapwidth*bmapheight;
+    blockthings = Z_Malloc (count,PU_LEVEL, 0);
+    memset (blockthings, 0, count);
 }
 
 
@@ -497,6 +500,8 @@ void P_LoadBlockMap (int lump)
 void P_GroupLines (void)
 {
     line_t**		linebuffer;
+    sector_t**		neighbourbuffer;
+    sector_t*		other;
     int			i;
     int			j;
     int			total;
@@ -534,6 +539,7 @@ void P_GroupLines (void)
 
     // build line tables for each sector	
     linebuffer = Z_Malloc (total*sizeof(**linebuffer), PU_LEVEL, 0);
+    neighbourbuffer = Z_Malloc (total*sizeof(*neighbourbuffer), PU_LEVEL, 0);
     sector = sectors;
     for (i=0 ; i<numsectors ; i++, sector++)
     {
@@ -551,6 +557,20 @@ void P_GroupLines (void)
 	}
 	if (linebuffer - sector->lines != sector->linecount)
 	    I_Error ("P_GroupLines: miscounted");
+
+	// build the neighbour table for the P_Find*Surrounding lookups
+	validcount++;
+	sector->neighbours = neighbourbuffer;
+	for (j=0 ; j<sector->linecount ; j++)
+	{
+	    other = getNextSector (sector->lines[j], sector);
+	    if (!other || other->validcount == validcount)
+		continue;
+
+	    other->validcount = validcount;
+	    *neighbourbuffer++ = other;
+	}
+	sector->neighbourcount = neighbourbuffer - sector->neighbours;
 			
 	// set the degenmobj_t to the middle of the bounding box
 	sector->soundorg.x = (bbox[BOXRIGHT]+bbox[BOXLEFT])/2;
@@ -620,6 +640,8 @@ P_SetupLevel
 
     // UNUSED W_Profile ();
     P_InitThinkers ();
+    P_InitSecNodes ();
+    P_InitMobjIds ();
 
     // if working with a devlopment map, reload it
     W_Reload ();			
@@ -656,8 +678,11 @@ P_SetupLevel
     P_LoadNodes (lumpnum+ML_NODES);
     P_LoadSegs (lumpnum+ML_SEGS);
 	
-    rejectmatrix = W_CacheLumpNum (lumpnum+ML_REJECT,PU_LEVEL);
     P_GroupLines ();
+    P_LoadReject (lumpnum);
+    P_InitTagLists ();
+    P_InitSightCache ();
+    P_NoteMapState ();
 
     bodyqueslot = 0;
     deathmatch_p = deathmatchstarts;
@@ -705,6 +730,11 @@ void P_Init (void)
     P_InitPicAnims ();
     printf ("R_InitSprites\n");
     R_InitSprites (sprnames);
+
+    blocksweep = M_CheckParm ("-blocksweep");
+    nodormant = M_CheckParm ("-nodormant");
+    serialspecials = M_CheckParm ("-serialspecials");
+    interceptlimit = M_CheckParm ("-interceptlimit");
     
     printf ("P_Init completed.\n");
     return;
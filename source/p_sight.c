@@ -21,11 +21,22 @@
 // DESCRIPTION:
 //	LineOfSight/Visibility checks, uses REJECT Lookup Table.
 //
+//	Behind REJECT is a cache with an entry per pair of sectors
+//	looked between. It keeps the last answer, which stands for
+//	the same positions for as long as no floor or ceiling moves,
+//	and the last line that blocked the view. The line is tried
+//	first next time. If it is still crossed and still blocks, and
+//	the BSP walk would reach a subsector it is in, the walk could
+//	only end the same way. Either way the answer is the one the
+//	full walk gives.
+//
 //-----------------------------------------------------------------------------
 
 #include "doomdef.h"
 
 #include "i_system.h"
+#include "m_prof.h"
+#include "z_zone.h"
 #include "p_local.h"
 
 // State.
@@ -44,6 +55,42 @@ fixed_t		t2y;
 
 int		sightcounts[2];
 
+// line and subsector the last walk stopped at, or -1
+static int	blockline;
+static int	blocksub;
+
+// entries, a power of two
+#define SIGHTCACHESIZE	1024
+
+typedef struct
+{
+    int		s1;		// sectors looked from and at, -1 if empty
+    int		s2;
+
+    // the last answer, and what it was worked out from
+    boolean	seen;
+    int		changes;	// heightchanges then
+    fixed_t	x1;
+    fixed_t	y1;
+    fixed_t	z1;		// eye z
+    fixed_t	x2;
+    fixed_t	y2;
+    fixed_t	bottom;
+    fixed_t	top;
+
+    // the last line that blocked the view, or -1
+    int		line;
+    int		sub;
+    
+} sightcache_t;
+
+static sightcache_t*	sightcache;
+
+// parent node of each node and subsector, times two plus
+// the side it is on, -1 for the head node
+static int*		nodeparents;
+static int*		subparents;
+
 
 //
 // P_DivlineSide
@@ -125,6 +172,39 @@ P_InterceptVector2
     return frac;
 }
 
+//
+// P_SightCrosses
+// Returns true if strace crosses the line,
+// which is left in divl.
+//
+static boolean P_SightCrosses (line_t* line, divline_t* divl)
+{
+    int			s1;
+    int			s2;
+    vertex_t*		v1;
+    vertex_t*		v2;
+
+    v1 = line->v1;
+    v2 = line->v2;
+    s1 = P_DivlineSide (v1->x,v1->y, &strace);
+    s2 = P_DivlineSide (v2->x, v2->y, &strace);
+
+    // line isn't crossed?
+    if (s1 == s2)
+	return false;
+	
+    divl->x = v1->x;
+    divl->y = v1->y;
+    divl->dx = v2->x - v1->x;
+    divl->dy = v2->y - v1->y;
+    s1 = P_DivlineSide (strace.x, strace.y, divl);
+    s2 = P_DivlineSide (t2x, t2y, divl);
+
+    // line isn't crossed?
+    return s1 != s2;
+}
+
+
 //
 // P_CrossSubsector
 // Returns true
@@ -134,8 +214,6 @@ boolean P_CrossSubsector (int num)
 {
     seg_t*		seg;
     line_t*		line;
-    int			s1;
-    int			s2;
     int			count;
     subsector_t*	sub;
     sector_t*		front;
@@ -143,8 +221,6 @@ boolean P_CrossSubsector (int num)
     fixed_t		opentop;
     fixed_t		openbottom;
     divline_t		divl;
-    vertex_t*		v1;
-    vertex_t*		v2;
     fixed_t		frac;
     fixed_t		slope;
 	
@@ -171,30 +247,17 @@ boolean P_CrossSubsector (int num)
 	
 	line->validcount = validcount;
 		
-	v1 = line->v1;
-	v2 = line->v2;
-	s1 = P_DivlineSide (v1->x,v1->y, &strace);
-	s2 = P_DivlineSide (v2->x, v2->y, &strace);
-
-	// line isn't crossed?
-	if (s1 == s2)
-	    continue;
-	
-	divl.x = v1->x;
-	divl.y = v1->y;
-	divl.dx = v2->x - v1->x;
-	divl.dy = v2->y - v1->y;
-	s1 = P_DivlineSide (strace.x, strace.y, &divl);
-	s2 = P_DivlineSide (t2x, t2y, &divl);
-
-	// line isn't crossed?
-	if (s1 == s2)
+	if (!P_SightCrosses (line, &divl))
 	    continue;	
 
 	// stop because it is not two sided anyway
 	// might do this after updating validcount?
 	if ( !(line->flags & ML_TWOSIDED) )
+	{
+	    blockline = line - lines;
+	    blocksub = num;
 	    return false;
+	}
 	
 	// crosses a two sided line
 	front = seg->frontsector;
@@ -220,7 +283,11 @@ boolean P_CrossSubsector (int num)
 		
 	// quick test for totally closed doors
 	if (openbottom >= opentop)	
+	{
+	    blockline = line - lines;
+	    blocksub = num;
 	    return false;		// stop
+	}
 	
 	frac = P_InterceptVector2 (&strace, &divl);
 		
@@ -288,14 +355,118 @@ boolean P_CrossBSPNode (int bspnum)
 }
 
 
+//
+// P_InitSightCache
+// Empties the cache and notes the parents in the BSP tree
+// of the level just loaded.
+//
+void P_InitSightCache (void)
+{
+    node_t*	bsp;
+    int		child;
+    int		i;
+    int		j;
+
+    sightcache = Z_Malloc (SIGHTCACHESIZE*sizeof(*sightcache), PU_LEVEL, 0);
+    for (i=0 ; i<SIGHTCACHESIZE ; i++)
+	sightcache[i].s1 = -1;
+
+    nodeparents = Z_Malloc (numnodes*sizeof(*nodeparents), PU_LEVEL, 0);
+    subparents = Z_Malloc (numsubsectors*sizeof(*subparents), PU_LEVEL, 0);
+
+    // the head node is the last node output
+    for (i=0 ; i<numnodes ; i++)
+	nodeparents[i] = -1;
+    for (i=0 ; i<numsubsectors ; i++)
+	subparents[i] = -1;
+
+    for (i=0, bsp=nodes ; i<numnodes ; i++, bsp++)
+    {
+	for (j=0 ; j<2 ; j++)
+	{
+	    child = bsp->children[j];
+	    if (child & NF_SUBSECTOR)
+		subparents[child&(~NF_SUBSECTOR)] = i*2+j;
+	    else
+		nodeparents[child] = i*2+j;
+	}
+    }
+}
+
+
+//
+// P_SightReaches
+// Returns true if P_CrossBSPNode would cross the given
+// subsector on the way along strace.
+//
+static boolean P_SightReaches (int num)
+{
+    node_t*	bsp;
+    int		parent;
+    int		side;
+
+    for (parent = subparents[num] ; parent >= 0 ;
+	 parent = nodeparents[parent>>1])
+    {
+	bsp = &nodes[parent>>1];
+
+	side = P_DivlineSide (strace.x, strace.y, (divline_t *)bsp);
+	if (side == 2)
+	    side = 0;
+
+	// the starting side is always crossed, the other
+	// side only if the line reaches it
+	if (side != (parent&1)
+	    && side == P_DivlineSide (t2x, t2y, (divline_t *)bsp))
+	    return false;
+    }
+    return true;
+}
+
+
+//
+// P_SightBlocked
+// Returns true if strace is still stopped by the line
+// in the subsector it stopped at before.
+//
+static boolean P_SightBlocked (int linenum, int num)
+{
+    line_t*	line;
+    sector_t*	front;
+    sector_t*	back;
+    divline_t	divl;
+
+    line = &lines[linenum];
+    if (!P_SightCrosses (line, &divl))
+	return false;
+
+    if (line->flags & ML_TWOSIDED)
+    {
+	// still a totally closed door?
+	front = line->frontsector;
+	back = line->backsector;
+	if (front->floorheight == back->floorheight
+	    && front->ceilingheight == back->ceilingheight)
+	    return false;
+	if ((front->floorheight > back->floorheight ?
+	     front->floorheight : back->floorheight)
+	    < (front->ceilingheight < back->ceilingheight ?
+	       front->ceilingheight : back->ceilingheight))
+	    return false;
+    }
+
+    return P_SightReaches (num);
+}
+
+
 //
 // P_CheckSight
 // Returns true
 //  if a straight line between t1 and t2 is unobstructed.
 // Uses REJECT.
 //
-boolean
-P_CheckSight
+static boolean
+P_DoCheckSight
 ( mobj_t*	t1,
   mobj_t*	t2 )
 {
@@ -304,6 +475,10 @@ P_CheckSight
     int		pnum;
     int		bytenum;
     int		bitnum;
+    sightcache_t*	cache;
+    fixed_t	z1;
+    fixed_t	bottom;
+    fixed_t	top;
     
     // First check for trivial rejection.
 
@@ -325,14 +500,37 @@ P_CheckSight
 
     // An unobstructed LOS is possible.
     // Now look from eyes of t1 to any part of t2.
-    sightcounts[1]++;
+    z1 = t1->z + t1->height - (t1->height>>2);
+    bottom = t2->z;
+    top = t2->z + t2->height;
+
+    cache = &sightcache[(s1*31 + s2) & (SIGHTCACHESIZE-1)];
+    if (cache->s1 != s1 || cache->s2 != s2)
+    {
+	cache->s1 = s1;
+	cache->s2 = s2;
+	cache->changes = heightchanges-1;
+	cache->line = -1;
+    }
+
+    // nothing has moved since the last look?
+    if (cache->changes == heightchanges
+	&& cache->x1 == t1->x && cache->y1 == t1->y && cache->z1 == z1
+	&& cache->x2 == t2->x && cache->y2 == t2->y
+	&& cache->bottom == bottom && cache->top == top)
+    {
+	return cache->seen;
+    }
+
+    cache->changes = heightchanges;
+    cache->x1 = t1->x;
+    cache->y1 = t1->y;
+    cache->z1 = z1;
+    cache->x2 = t2->x;
+    cache->y2 = t2->y;
+    cache->bottom = bottom;
+    cache->top = top;
 
-    validcount++;
-	
-    sightzstart = t1->z + t1->height - (t1->height>>2);
-    topslope = (t2->z+t2->height) - sightzstart;
-    bottomslope = (t2->z) - sightzstart;
-	
     strace.x = t1->x;
     strace.y = t1->y;
     t2x = t2->x;
@@ -340,8 +538,46 @@ P_CheckSight
     strace.dx = t2->x - t1->x;
     strace.dy = t2->y - t1->y;
 
+    // still behind the same wall?
+    if (cache->line >= 0 && P_SightBlocked (cache->line, cache->sub))
+    {
+	cache->seen = false;
+	return false;
+    }
+
+    sightcounts[1]++;
+
+    validcount++;
+	
+    sightzstart = z1;
+    topslope = top - sightzstart;
+    bottomslope = bottom - sightzstart;
+
+    blockline = -1;
+
     // the head node is the last node output
-    return P_CrossBSPNode (numnodes-1);	
+    cache->seen = P_CrossBSPNode (numnodes-1);
+    if (blockline >= 0)
+    {
+	cache->line = blockline;
+	cache->sub = blocksub;
+    }
+
+    return cache->seen;
+}
+
+boolean
+P_CheckSight
+( mobj_t*	t1,
+  mobj_t*	t2 )
+{
+    boolean	seen;
+
+    PROF_BEGIN (pz_sight);
+    seen = P_DoCheckSight (t1, t2);
+    PROF_END (pz_sight);
+
+    return seen;
 }
 
 
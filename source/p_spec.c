@@ -266,23 +266,20 @@ getNextSector
 // P_FindLowestFloorSurrounding()
 // FIND LOWEST FLOOR HEIGHT IN SURROUNDING SECTORS
 //
+// These go through the neighbour tables built by P_GroupLines.
+// The loops are kept to a plain select per sector, so they come
+// out without branches.
+//
 fixed_t	P_FindLowestFloorSurrounding(sector_t* sec)
 {
     int			i;
-    line_t*		check;
-    sector_t*		other;
+    fixed_t		h;
     fixed_t		floor = sec->floorheight;
 	
-    for (i=0 ;i < sec->linecount ; i++)
+    for (i=0 ;i < sec->neighbourcount ; i++)
     {
-	check = sec->lines[i];
-	other = getNextSector(check,sec);
-
-	if (!other)
-	    continue;
-	
-	if (other->floorheight < floor)
-	    floor = other->floorheight;
+	h = sec->neighbours[i]->floorheight;
+	floor = h < floor ? h : floor;
     }
     return floor;
 }
@@ -296,20 +293,13 @@ fixed_t	P_FindLowestFloorSurrounding(sector_t* sec)
 fixed_t	P_FindHighestFloorSurrounding(sector_t *sec)
 {
     int			i;
-    line_t*		check;
-    sector_t*		other;
+    fixed_t		h;
     fixed_t		floor = -500*FRACUNIT;
 	
-    for (i=0 ;i < sec->linecount ; i++)
+    for (i=0 ;i < sec->neighbourcount ; i++)
     {
-	check = sec->lines[i];
-	other = getNextSector(check,sec);
-	
-	if (!other)
-	    continue;
-	
-	if (other->floorheight > floor)
-	    floor = other->floorheight;
+	h = sec->neighbours[i]->floorheight;
+	floor = h > floor ? h : floor;
     }
     return floor;
 }
@@ -319,57 +309,27 @@ fixed_t	P_FindHighestFloorSurrounding(sector_t *sec)
 //
 // P_FindNextHighestFloor
 // FIND NEXT HIGHEST FLOOR IN SURROUNDING SECTORS
-// Note: this should be doable w/o a fixed array.
-
-// 20 adjoining sectors max!
-#define MAX_ADJOINING_SECTORS    	20
-
+//
 fixed_t
 P_FindNextHighestFloor
 ( sector_t*	sec,
   int		currentheight )
 {
     int			i;
-    int			h;
-    int			min;
-    line_t*		check;
-    sector_t*		other;
-    fixed_t		height = currentheight;
-
-    
-    fixed_t		heightlist[MAX_ADJOINING_SECTORS];		
+    fixed_t		h;
+    fixed_t		min = MAXINT;
+    boolean		found = false;
 
-    for (i=0, h=0 ;i < sec->linecount ; i++)
+    for (i=0 ;i < sec->neighbourcount ; i++)
     {
-	check = sec->lines[i];
-	other = getNextSector(check,sec);
-
-	if (!other)
-	    continue;
-	
-	if (other->floorheight > height)
-	    heightlist[h++] = other->floorheight;
-
-	// Check for overflow. Exit.
-	if ( h >= MAX_ADJOINING_SECTORS )
-	{
-	    fprintf( stderr,
-		     "Sector with more than 20 adjoining sectors\n" );
-	    break;
-	}
+	h = sec->neighbours[i]->floorheight;
+	found |= h > currentheight;
+	min = h > currentheight && h < min ? h : min;
     }
     
-    // Find lowest height in list
-    if (!h)
+    if (!found)
 	return currentheight;
 		
-    min = heightlist[0];
-    
-    // Range checking? 
-    for (i = 1;i < h;i++)
-	if (heightlist[i] < min)
-	    min = heightlist[i];
-			
     return min;
 }
 
@@ -381,20 +341,13 @@ fixed_t
 P_FindLowestCeilingSurrounding(sector_t* sec)
 {
     int			i;
-    line_t*		check;
-    sector_t*		other;
+    fixed_t		h;
     fixed_t		height = MAXINT;
 	
-    for (i=0 ;i < sec->linecount ; i++)
+    for (i=0 ;i < sec->neighbourcount ; i++)
     {
-	check = sec->lines[i];
-	other = getNextSector(check,sec);
-
-	if (!other)
-	    continue;
-
-	if (other->ceilingheight < height)
-	    height = other->ceilingheight;
+	h = sec->neighbours[i]->ceilingheight;
+	height = h < height ? h : height;
     }
     return height;
 }
@@ -406,20 +359,13 @@ P_FindLowestCeilingSurrounding(sector_t* sec)
 fixed_t	P_FindHighestCeilingSurrounding(sector_t* sec)
 {
     int		i;
-    line_t*	check;
-    sector_t*	other;
+    fixed_t	h;
     fixed_t	height = 0;
 	
-    for (i=0 ;i < sec->linecount ; i++)
+    for (i=0 ;i < sec->neighbourcount ; i++)
     {
-	check = sec->lines[i];
-	other = getNextSector(check,sec);
-
-	if (!other)
-	    continue;
-
-	if (other->ceilingheight > height)
-	    height = other->ceilingheight;
+	h = sec->neighbours[i]->ceilingheight;
+	height = h > height ? h : height;
     }
     return height;
 }
@@ -429,18 +375,106 @@ fixed_t	P_FindHighestCeilingSurrounding(sector_t* sec)
 //
 // RETURN NEXT SECTOR # THAT LINE TAG REFERS TO
 //
+// The sectors of a tag are chained in ascending order from
+// sectors[tag % numsectors].firsttag, along with any other tags
+// that share the chain, so they come out in the order a scan
+// of all the sectors would find them.
+//
 int
 P_FindSectorFromLineTag
 ( line_t*	line,
   int		start )
 {
-    int	i;
-	
-    for (i=start+1;i<numsectors;i++)
-	if (sectors[i].tag == line->tag)
-	    return i;
-    
-    return -1;
+    int		next;
+
+    if (start >= 0 && sectors[start].tag == line->tag)
+	next = sectors[start].nexttag;
+    else
+    {
+	// EV_BuildStairs goes on from the last step it raised,
+	// which need not have the tag, so find the first one
+	// after start on the tag's own chain
+	next = sectors[(unsigned)line->tag % (unsigned)numsectors].firsttag;
+	while (next >= 0 && next <= start)
+	    next = sectors[next].nexttag;
+    }
+
+    while (next >= 0 && sectors[next].tag != line->tag)
+	next = sectors[next].nexttag;
+
+    return next;
+}
+
+
+#ifdef RANGECHECK
+static int P_CompareTags (const void* a, const void* b)
+{
+    return *(const short *)a - *(const short *)b;
+}
+
+//
+// P_CheckTagLists
+// Checks P_FindSectorFromLineTag against a scan of all the
+// sectors, from every start, for each tag the sectors have.
+//
+static void P_CheckTagLists (void)
+{
+    short*	tags;
+    line_t	line;
+    int		i;
+    int		start;
+    int		next;
+
+    tags = Z_Malloc (numsectors*sizeof(*tags), PU_STATIC, NULL);
+    for (i=0 ; i<numsectors ; i++)
+	tags[i] = sectors[i].tag;
+    qsort (tags, numsectors, sizeof(*tags), P_CompareTags);
+
+    for (i=0 ; i<numsectors ; i++)
+    {
+	if (i && tags[i] == tags[i-1])
+	    continue;
+
+	line.tag = tags[i];
+	next = -1;
+	for (start=numsectors-1 ; start>=-1 ; start--)
+	{
+	    if (P_FindSectorFromLineTag (&line, start) != next)
+		I_Error ("P_CheckTagLists: tag %i from sector %i",
+			 line.tag, start);
+	    if (start >= 0 && sectors[start].tag == line.tag)
+		next = start;
+	}
+    }
+
+    Z_Free (tags);
+}
+#endif
+
+
+//
+// P_InitTagLists
+// Chains the sectors by tag for P_FindSectorFromLineTag.
+//
+void P_InitTagLists (void)
+{
+    int		i;
+    int		j;
+
+    for (i=0 ; i<numsectors ; i++)
+	sectors[i].firsttag = -1;
+
+    // add them backwards to keep each chain in ascending order
+    for (i=numsectors-1 ; i>=0 ; i--)
+    {
+	j = (unsigned)sectors[i].tag % (unsigned)numsectors;
+	sectors[i].nexttag = sectors[j].firsttag;
+	sectors[j].firsttag = i;
+    }
+
+#ifdef RANGECHECK
+    P_CheckTagLists ();
+#endif
 }
 
 
@@ -456,20 +490,13 @@ P_FindMinSurroundingLight
 {
     int		i;
     int		min;
-    line_t*	line;
-    sector_t*	check;
+    int		light;
 	
     min = max;
-    for (i=0 ; i < sector->linecount ; i++)
+    for (i=0 ; i < sector->neighbourcount ; i++)
     {
-	line = sector->lines[i];
-	check = getNextSector(line,sector);
-
-	if (!check)
-	    continue;
-
-	if (check->lightlevel < min)
-	    min = check->lightlevel;
+	light = sector->neighbours[i]->lightlevel;
+	min = light < min ? light : min;
     }
     return min;
 }
@@ -48,6 +48,9 @@ void    P_InitPicAnims (void);
 // at map load
 void    P_SpawnSpecials (void);
 
+// Called by P_SetupLevel once the sectors are loaded.
+void    P_InitTagLists (void);
+
 // every tic
 void    P_UpdateSpecials (void);
 
@@ -182,6 +185,7 @@ typedef struct
 #define FASTDARK			15
 #define SLOWDARK			35
 
+void    T_FireFlicker (fireflicker_t* flick);
 void    P_SpawnFireFlicker (sector_t* sector);
 void    T_LightFlash (lightflash_t* flash);
 void    P_SpawnLightFlash (sector_t* sector);
@@ -24,8 +24,13 @@
 //-----------------------------------------------------------------------------
 
 
+#include <string.h>
+
 #include "z_zone.h"
+#include "i_system.h"
+#include "m_prof.h"
 #include "p_local.h"
+#include "s_sound.h"
 
 #include "doomstat.h"
 
@@ -45,13 +50,71 @@ int	leveltime;
 // Both the head and tail of the thinker list.
 thinker_t	thinkercap;
 
+// Heads of the activity lists. Sleeping monsters are spread
+// over SLEEPTICS lists by the tic they went to sleep at.
+static thinker_t	activecap;
+static thinker_t	staticcap;
+static thinker_t	sleepcap[SLEEPTICS];
+
+// Thinkers on each activity list.
+static int		activitycount[ta_static+1];
+
+// leveltime when the active thinkers were last run
+static int		activerun = -1;
+
+boolean			nodormant;
+
+boolean			threadedspecials;
+boolean			serialspecials;
+
+
+static void
+P_LinkActivity
+( thinker_t*		thinker,
+  thinker_t*		cap,
+  thinkactivity_t	activity )
+{
+    cap->aprev->anext = thinker;
+    thinker->anext = cap;
+    thinker->aprev = cap->aprev;
+    cap->aprev = thinker;
+
+    thinker->activity = activity;
+    activitycount[activity]++;
+}
+
+
+static void P_UnlinkActivity (thinker_t* thinker)
+{
+    thinker->anext->aprev = thinker->aprev;
+    thinker->aprev->anext = thinker->anext;
+
+    activitycount[thinker->activity]--;
+}
+
+
+static void P_InitActivity (thinker_t* cap)
+{
+    cap->aprev = cap->anext = cap;
+}
+
 
 //
 // P_InitThinkers
 //
 void P_InitThinkers (void)
 {
+    int		i;
+
     thinkercap.prev = thinkercap.next  = &thinkercap;
+
+    P_InitActivity (&activecap);
+    P_InitActivity (&staticcap);
+    for (i=0 ; i<SLEEPTICS ; i++)
+	P_InitActivity (&sleepcap[i]);
+
+    memset (activitycount, 0, sizeof(activitycount));
+    activerun = -1;
 }
 
 
@@ -67,6 +130,8 @@ void P_AddThinker (thinker_t* thinker)
     thinker->next = &thinkercap;
     thinker->prev = thinkercap.prev;
     thinkercap.prev = thinker;
+
+    P_LinkActivity (thinker, &activecap, ta_active);
 }
 
 
@@ -79,6 +144,7 @@ void P_AddThinker (thinker_t* thinker)
 void P_RemoveThinker (thinker_t* thinker)
 {
   // FIXME: NOP.
+  P_WakeThinker (thinker);
   thinker->function.acv = (actionf_v)(-1);
 }
 
@@ -95,29 +161,516 @@ void P_AllocateThinker (thinker_t*	thinker)
 
 
 //
-// P_RunThinkers
+// P_WakeThinker
+// Puts a thinker back to being run every tic. Anything that
+// changes a thing from outside its own thinker wakes it.
 //
-void P_RunThinkers (void)
+void P_WakeThinker (thinker_t* thinker)
+{
+    if (thinker->activity == ta_active)
+	return;
+
+    // bring it up to the tic it will next be run for
+    if (thinker->activity == ta_sleeping)
+	P_CatchUpSleeper ((mobj_t *)thinker,
+			  activerun == leveltime ? leveltime : leveltime-1);
+
+    P_UnlinkActivity (thinker);
+    P_LinkActivity (thinker, &activecap, ta_active);
+}
+
+
+//
+// P_WakeSleepers
+// Wakes every sleeping monster, so none is left behind
+// on its states.
+//
+void P_WakeSleepers (void)
+{
+    int		i;
+
+    for (i=0 ; i<SLEEPTICS ; i++)
+	while (sleepcap[i].anext != &sleepcap[i])
+	    P_WakeThinker (sleepcap[i].anext);
+}
+
+
+//
+// P_FreeThinker
+//
+static void P_FreeThinker (thinker_t* thinker)
+{
+    thinker->next->prev = thinker->prev;
+    thinker->prev->next = thinker->next;
+    P_UnlinkActivity (thinker);
+    Z_Free (thinker);
+}
+
+
+
+//
+// P_RunAllThinkers
+// Runs the thinkers in the order they were added, as the
+// original game did, for demos and net games. Things that
+// P_MobjThinker would do nothing with are left out, which
+// changes nothing.
+//
+static void P_RunAllThinkers (void)
 {
     thinker_t*	currentthinker;
+    thinker_t*	next;
+    mobj_t*	mo;
 
     currentthinker = thinkercap.next;
     while (currentthinker != &thinkercap)
     {
+	next = currentthinker->next;
+
 	if ( currentthinker->function.acv == (actionf_v)(-1) )
 	{
 	    // time to remove it
-	    currentthinker->next->prev = currentthinker->prev;
-	    currentthinker->prev->next = currentthinker->next;
-	    Z_Free (currentthinker);
+	    P_FreeThinker (currentthinker);
 	}
-	else
+	else if (currentthinker->activity == ta_active)
 	{
 	    if (currentthinker->function.acp1)
+	    {
 		currentthinker->function.acp1 (currentthinker);
+		PROF_COUNT (pc_thinkers, 1);
+	    }
+	    next = currentthinker->next;
+
+	    mo = (mobj_t *)currentthinker;
+	    if (!nodormant
+		&& currentthinker->function.acp1 == (actionf_p1)P_MobjThinker
+		&& P_MobjActivity (mo) == ta_static)
+	    {
+		P_UnlinkActivity (currentthinker);
+		P_LinkActivity (currentthinker, &staticcap, ta_static);
+	    }
+	}
+	currentthinker = next;
+    }
+}
+
+
+//
+// SECTOR SPECIALS
+// Outside demos and net games, lights and movers that come
+// one after another on the active list are run together when
+// the list gets to them. Those that move sectors nothing
+// touches, and the lights that do not use P_Random, change
+// nothing but their own sector, so such a run of them is split
+// into batches of different sectors spread over the threads,
+// with what they do to the rest of the game held back until
+// their batch is done. As nothing else runs in between, the
+// list comes out as if run one at a time in its own order.
+//
+// -serialspecials runs each of them alone in its place, to
+// check the batches against.
+//
+#define MAXDEFERRED		4
+
+// handing jobs to the waiting threads costs more than
+// running fewer specials than this on one
+#define MINTHREADEDSPECIALS	16
+
+typedef struct
+{
+    actionf_p1	func;		// or NULL for a sound at the sector
+    void*	arg;
+    int		sfx;
+} deferred_t;
+
+typedef struct
+{
+    thinker_t*	thinker;
+    sector_t*	sector;
+    int		batch;
+    int		numdeferred;
+    deferred_t	deferred[MAXDEFERRED];
+} specialjob_t;
+
+// the run being done, in the order of the active list
+static specialjob_t*	specialjobs;
+static int		numspecialjobs;
+static int		maxspecialjobs;
+
+// indexes into specialjobs of the batch being run
+static int*		batchjobs;
+
+// for each sector, the batches it is already in, and
+// while a batch runs, its job for the sector
+static int*		sectorbatches;
+static int*		sectorjob;
+
+
+//
+// P_SpecialSector
+// The sector a light or mover changes, or NULL for other
+// thinkers. Movers of sectors something touches can't be
+// batched.
+//
+static sector_t*
+P_SpecialSector
+( thinker_t*	thinker,
+  boolean*	batched )
+{
+    actionf_p1	func;
+    sector_t*	sec;
+
+    func = thinker->function.acp1;
+    *batched = true;
+
+    if (func == (actionf_p1)T_Glow)
+	return ((glow_t *)thinker)->sector;
+    if (func == (actionf_p1)T_StrobeFlash)
+	return ((strobe_t *)thinker)->sector;
+
+    if (func == (actionf_p1)T_MoveFloor)
+	sec = ((floormove_t *)thinker)->sector;
+    else if (func == (actionf_p1)T_MoveCeiling)
+	sec = ((ceiling_t *)thinker)->sector;
+    else if (func == (actionf_p1)T_VerticalDoor)
+	sec = ((vldoor_t *)thinker)->sector;
+    else if (func == (actionf_p1)T_PlatRaise)
+	sec = ((plat_t *)thinker)->sector;
+    else
+	return NULL;
+
+    *batched = touchlists && !sec->touchlist;
+    return sec;
+}
+
+
+//
+// P_Defer
+// A held back call for the job of the sector's special,
+// which only that job's thread writes to.
+//
+static deferred_t* P_Defer (sector_t* sec)
+{
+    specialjob_t*	job;
+
+    job = &specialjobs[sectorjob[sec - sectors]];
+    if (job->numdeferred == MAXDEFERRED)
+	I_Error ("P_Defer: more than %i for a special", MAXDEFERRED);
+
+    return &job->deferred[job->numdeferred++];
+}
+
+
+//
+// P_DeferSpecial
+//
+void
+P_DeferSpecial
+( sector_t*	sec,
+  actionf_p1	func,
+  void*		arg )
+{
+    deferred_t*	deferred;
+
+    deferred = P_Defer (sec);
+    deferred->func = func;
+    deferred->arg = arg;
+}
+
+
+//
+// P_SectorSound
+//
+void P_SectorSound (sector_t* sec, int sfx)
+{
+    deferred_t*	deferred;
+
+    if (!threadedspecials)
+    {
+	S_StartSound ((mobj_t *)&sec->soundorg, sfx);
+	return;
+    }
+
+    deferred = P_Defer (sec);
+    deferred->func = NULL;
+    deferred->sfx = sfx;
+}
+
+
+static void P_RunSpecialJob (int index, int thread)
+{
+    thinker_t*	thinker;
+
+    thinker = specialjobs[batchjobs[index]].thinker;
+    thinker->function.acp1 (thinker);
+}
+
+
+//
+// P_GatherSpecials
+// Puts the run of lights and movers that can be batched from
+// first on in specialjobs, and returns the number of batches.
+//
+static int P_GatherSpecials (thinker_t* first)
+{
+    thinker_t*		thinker;
+    specialjob_t*	job;
+    specialjob_t*	old;
+    sector_t*		sec;
+    boolean		batched;
+    int			numbatches;
+    int			i;
+
+    if (!sectorbatches)
+    {
+	sectorbatches = Z_Malloc (numsectors*sizeof(*sectorbatches),
+				  PU_LEVEL, &sectorbatches);
+	memset (sectorbatches, 0, numsectors*sizeof(*sectorbatches));
+	sectorjob = Z_Malloc (numsectors*sizeof(*sectorjob),
+			      PU_LEVEL, &sectorjob);
+    }
+
+    numspecialjobs = 0;
+    numbatches = 0;
+
+    for (thinker = first ; thinker != &activecap ; thinker = thinker->anext)
+    {
+	if (thinker->function.acv == (actionf_v)(-1)
+	    || !(sec = P_SpecialSector (thinker, &batched))
+	    || !batched)
+	{
+	    break;
+	}
+
+	if (numspecialjobs == maxspecialjobs)
+	{
+	    old = specialjobs;
+	    maxspecialjobs = maxspecialjobs ? maxspecialjobs*2 : 128;
+	    specialjobs = Z_Malloc (maxspecialjobs*sizeof(*specialjobs),
+				    PU_STATIC, 0);
+	    if (old)
+	    {
+		memcpy (specialjobs, old, numspecialjobs*sizeof(*old));
+		Z_Free (old);
+		Z_Free (batchjobs);
+	    }
+	    batchjobs = Z_Malloc (maxspecialjobs*sizeof(*batchjobs),
+				  PU_STATIC, 0);
+	}
+
+	job = &specialjobs[numspecialjobs++];
+	job->thinker = thinker;
+	job->sector = sec;
+	job->numdeferred = 0;
+
+	// a sector's specials keep their order, a batch apart
+	job->batch = sectorbatches[sec - sectors]++;
+	if (job->batch == numbatches)
+	    numbatches++;
+    }
+
+    for (i=0 ; i<numspecialjobs ; i++)
+	sectorbatches[specialjobs[i].sector - sectors] = 0;
+
+    return numbatches;
+}
+
+
+//
+// P_RunSectorSpecials
+// Runs the run of lights and movers from first on, and
+// returns the thinker after it.
+//
+static thinker_t* P_RunSectorSpecials (thinker_t* first)
+{
+    specialjob_t*	job;
+    deferred_t*		deferred;
+    int			numbatches;
+    int			batch;
+    int			count;
+    int			i;
+    int			j;
+
+    numbatches = P_GatherSpecials (first);
+
+    for (batch=0 ; batch<numbatches ; batch++)
+    {
+	count = 0;
+	for (i=0 ; i<numspecialjobs ; i++)
+	{
+	    if (specialjobs[i].batch == batch)
+	    {
+		sectorjob[specialjobs[i].sector - sectors] = i;
+		batchjobs[count++] = i;
+	    }
+	}
+
+	threadedspecials = true;
+	if (count < MINTHREADEDSPECIALS)
+	{
+	    for (i=0 ; i<count ; i++)
+		P_RunSpecialJob (i, 0);
+	}
+	else
+	    I_RunParallel (P_RunSpecialJob, count);
+	threadedspecials = false;
+
+	// the sight checks have to see the new heights
+	heightchanges++;
+
+	for (i=0 ; i<count ; i++)
+	{
+	    job = &specialjobs[batchjobs[i]];
+	    for (j=0, deferred=job->deferred ; j<job->numdeferred ;
+		 j++, deferred++)
+	    {
+		if (deferred->func)
+		    deferred->func (deferred->arg);
+		else
+		    S_StartSound ((mobj_t *)&job->sector->soundorg,
+				  deferred->sfx);
+	    }
+	}
+	PROF_COUNT (pc_thinkers, count);
+    }
+
+    // the ones done are freed when the list comes to them again
+    return specialjobs[numspecialjobs-1].thinker->anext;
+}
+
+
+//
+// P_RunActiveThinkers
+// Runs the active list, and lets the things that can go
+// dormant off it.
+//
+static void P_RunActiveThinkers (void)
+{
+    thinker_t*		currentthinker;
+    thinker_t*		next;
+    thinkactivity_t	activity;
+    mobj_t*		mo;
+    boolean		batched;
+
+    currentthinker = activecap.anext;
+    while (currentthinker != &activecap)
+    {
+	if ( currentthinker->function.acv == (actionf_v)(-1) )
+	{
+	    next = currentthinker->anext;
+	    P_FreeThinker (currentthinker);
+	    currentthinker = next;
+	    continue;
+	}
+
+	if (!serialspecials
+	    && P_SpecialSector (currentthinker, &batched) && batched)
+	{
+	    currentthinker = P_RunSectorSpecials (currentthinker);
+	    continue;
 	}
-	currentthinker = currentthinker->next;
+
+	if (currentthinker->function.acp1)
+	{
+	    currentthinker->function.acp1 (currentthinker);
+	    PROF_COUNT (pc_thinkers, 1);
+	}
+	next = currentthinker->anext;
+
+	if (currentthinker->function.acp1 == (actionf_p1)P_MobjThinker)
+	{
+	    mo = (mobj_t *)currentthinker;
+	    activity = P_MobjActivity (mo);
+
+	    if (activity == ta_static)
+	    {
+		P_UnlinkActivity (currentthinker);
+		P_LinkActivity (currentthinker, &staticcap, ta_static);
+	    }
+	    else if (activity == ta_sleeping)
+	    {
+		mo->sleeptic = leveltime;
+		P_UnlinkActivity (currentthinker);
+		P_LinkActivity (currentthinker,
+				&sleepcap[leveltime & (SLEEPTICS-1)],
+				ta_sleeping);
+	    }
+	}
+	currentthinker = next;
     }
+
+    activerun = leveltime;
+}
+
+
+//
+// P_RunSleepers
+// Runs the monsters that went to sleep at a multiple of
+// SLEEPTICS tics ago, a tic's share of them.
+//
+static void P_RunSleepers (void)
+{
+    thinker_t*	cap;
+    thinker_t	pending;
+    thinker_t*	currentthinker;
+
+    cap = &sleepcap[leveltime & (SLEEPTICS-1)];
+    if (cap->anext == cap)
+	return;
+
+    // looking can wake any of them, so they are
+    // taken off one at a time from a list of their own
+    pending.anext = cap->anext;
+    pending.aprev = cap->aprev;
+    pending.anext->aprev = &pending;
+    pending.aprev->anext = &pending;
+    P_InitActivity (cap);
+
+    while (pending.anext != &pending)
+    {
+	currentthinker = pending.anext;
+	pending.anext = currentthinker->anext;
+	currentthinker->anext->aprev = &pending;
+
+	cap->aprev->anext = currentthinker;
+	currentthinker->anext = cap;
+	currentthinker->aprev = cap->aprev;
+	cap->aprev = currentthinker;
+
+	P_SleepThinker ((mobj_t *)currentthinker);
+	PROF_COUNT (pc_thinkers, 1);
+    }
+}
+
+
+
+//
+// P_RunThinkers
+// Demos and net games have to be played out as the original
+// game did. Otherwise only the active thinkers are run every
+// tic, with the sleeping monsters taking their turns.
+//
+void P_RunThinkers (void)
+{
+    PROF_BEGIN (pz_thinkers);
+
+    if (nodormant || demoplayback || demorecording || netgame)
+    {
+	if (activitycount[ta_sleeping])
+	    P_WakeSleepers ();
+	P_RunAllThinkers ();
+    }
+    else
+    {
+	if (!blocksweep)
+	    P_KeepSecNodes ();
+	P_RunSleepers ();
+	P_RunActiveThinkers ();
+    }
+
+    PROF_COUNT (pc_dormant,
+		activitycount[ta_sleeping] + activitycount[ta_static]);
+    PROF_COUNT (pc_tics, 1);
+    PROF_END (pz_thinkers);
 }
 
 
@@ -382,3 +382,143 @@ void P_PlayerThink (player_t* player)
 }
 
 
+
+
+
+//
+// PREDICTION
+// With -predict, a net game draws the console player moved on by
+// its own commands that have not been run yet, so movement does
+// not wait for the other nodes. Only the player's own movement is
+// run, nothing it touches or crosses is triggered, and the player
+// is put back exactly as it was before the game runs again.
+//
+boolean		predicting;
+
+static player_t	savedplayer;
+static mobj_t	savedmobj;
+static boolean	savedonground;
+static blockthings_t*	savedblock;
+static int		savedindex;
+static boolean		savedinplace;	// put back between the same neighbours
+
+
+void P_StartPrediction (player_t* player)
+{
+    mobj_t*	mo;
+    int		blockx;
+    int		blocky;
+
+    mo = player->mo;
+    savedplayer = *player;
+    savedmobj = *mo;
+    savedonground = onground;
+    savedblock = NULL;
+    savedinplace = true;
+
+    if ( ! (mo->flags & MF_NOBLOCKMAP) )
+    {
+	blockx = (mo->x - bmaporgx)>>MAPBLOCKSHIFT;
+	blocky = (mo->y - bmaporgy)>>MAPBLOCKSHIFT;
+
+	if (blockx>=0 && blockx < bmapwidth
+	    && blocky>=0 && blocky <bmapheight)
+	{
+	    savedblock = &blockthings[blocky*bmapwidth+blockx];
+	    for (savedindex = 0 ; savedindex < savedblock->count ; savedindex++)
+		if (savedblock->ids[savedindex] == mo->id)
+		    break;
+
+	    // not where it should be, so it is linked afresh afterwards
+	    if (savedindex == savedblock->count)
+	    {
+		savedblock = NULL;
+		savedinplace = false;
+	    }
+	}
+    }
+    predicting = true;
+}
+
+
+//
+// P_PredictPlayer
+// The movement part of a tic of P_PlayerThink and P_MobjThinker.
+//
+void P_PredictPlayer (player_t* player, ticcmd_t* cmd)
+{
+    mobj_t*	mo;
+
+    mo = player->mo;
+    player->cmd = *cmd;
+
+    if (player->cheats & CF_NOCLIP)
+	mo->flags |= MF_NOCLIP;
+    else
+	mo->flags &= ~MF_NOCLIP;
+
+    // chain saw run forward
+    if (mo->flags & MF_JUSTATTACKED)
+    {
+	player->cmd.angleturn = 0;
+	player->cmd.forwardmove = 0xc800/512;
+	player->cmd.sidemove = 0;
+	mo->flags &= ~MF_JUSTATTACKED;
+    }
+
+    if (mo->reactiontime)
+	mo->reactiontime--;
+    else
+	P_MovePlayer (player);
+
+    P_CalcHeight (player);
+
+    if (mo->momx || mo->momy)
+	P_XYMovement (mo);
+
+    if (mo->z != mo->floorz || mo->momz)
+	P_ZMovement (mo);
+}
+
+
+//
+// P_EndPrediction
+// Nothing else has moved since P_StartPrediction, so the player
+// goes back between the same neighbours in the sector and block
+// lists, keeping the order the game sees them in. One that was
+// missing from its block list is linked again the usual way.
+//
+void P_EndPrediction (player_t* player)
+{
+    mobj_t*	mo;
+
+    mo = player->mo;
+    P_UnsetThingPosition (mo);
+
+    *mo = savedmobj;
+    *player = savedplayer;
+    onground = savedonground;
+
+    if (!savedinplace)
+    {
+	P_SetThingPosition (mo);
+	predicting = false;
+	return;
+    }
+
+    if ( ! (mo->flags & MF_NOSECTOR) )
+    {
+	if (mo->snext)
+	    mo->snext->sprev = mo;
+
+	if (mo->sprev)
+	    mo->sprev->snext = mo;
+	else
+	    mo->subsector->sector->thinglist = mo;
+    }
+
+    if (savedblock)
+	P_LinkBlockThing (savedblock, savedindex, mo);
+
+    predicting = false;
+}
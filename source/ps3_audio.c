@@ -0,0 +1,198 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+// Copyright (C) 2010 Ville Vuorinen
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//       PS3 audio port output. A mixer thread keeps the port's
+//       ring of blocks filled.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <audio/audio.h>
+#include <psl1ght/lv2/timer.h>
+#include <sys/thread.h>
+#include <psl1ght/lv2/thread.h>
+
+#include "doomtype.h"
+#include "i_system.h"
+#include "i_sound.h"
+
+
+static sys_lwmutex_t chanmutex;
+static sys_lwmutex_attribute_t MutexAttrs;
+
+static sys_ppu_thread_t mixthread;
+static char *mixthread_name = "PS3DOOM Sound FX mixer";
+
+// Cleared by PS3_ShutdownSound to make the mixer thread return.
+static volatile boolean mixrunning;
+
+static AudioPortConfig ps3_audio_port_cfg;
+static uint32_t ps3_audio_port;
+
+
+static uint32_t playOneBlock(u64 *readIndex, float *audioDataStart)
+{
+    static uint64_t audio_block_index=1;
+    uint64_t current_block = *readIndex;
+    float *buf;
+
+    if (audio_block_index == current_block)
+        return 0;
+
+    buf = audioDataStart + 2 /*channelcount*/ * AUDIO_BLOCK_SAMPLES * audio_block_index;
+
+    I_UpdateSound();
+
+    for (int i = 0; i < SAMPLECOUNT*2; i++)
+        buf[i] = (float)mixbuffer[i]/32767.0f;
+
+    audio_block_index = (audio_block_index + 1) % AUDIO_BLOCK_8;
+
+    return 1;
+}
+
+static void mix_thread_func (uint64_t arg)
+{
+    while (mixrunning)
+    {
+        sys_ppu_thread_yield();
+        usleep (20);
+
+        sys_lwmutex_lock (&chanmutex, 0);
+
+        playOneBlock((u64*)(u64)ps3_audio_port_cfg.readIndex,
+                     (float*)(u64)ps3_audio_port_cfg.audioDataStart);
+
+        sys_lwmutex_unlock (&chanmutex);
+    }
+
+    sys_ppu_thread_exit(0);
+    return;
+}
+
+
+static void PS3_LockSound (void)
+{
+    sys_lwmutex_lock (&chanmutex, 0);
+}
+
+static void PS3_UnlockSound (void)
+{
+    sys_lwmutex_unlock (&chanmutex);
+}
+
+
+static boolean PS3_InitSound (void)
+{
+    u64 thread_arg = 0x666;
+    u64 priority = 1500;
+    size_t stack_size = 0x10000;
+
+    AudioPortParam params;
+    uint32_t portNum;
+    int ret;
+
+    // init PSL1GHT audio
+    ret = audioInit();
+    printf ("I_InitSound: audioInit returns %d.\n", ret);
+
+    params.numChannels = AUDIO_PORT_2CH;        // stereo
+    params.numBlocks = AUDIO_BLOCK_8;
+    params.attr = 0;
+    params.level = 1.0f;
+
+    ret = audioPortOpen (&params, &portNum);
+    printf ("I_InitSound: audioPortOpen returns %d.\n"\
+            "             Port number is %d.\n", ret, portNum);
+
+    ps3_audio_port = portNum;
+    ret = audioGetPortConfig (portNum, &ps3_audio_port_cfg);
+    printf ("I_InitSound: audioGetPortConfig returns %d.\n"\
+            "              readIndex     : 0x%08x\n"\
+            "              status        : %d\n"\
+            "              channelCount  : %d\n"\
+            "              numBlocks     : %d\n"\
+            "              portSize      : %d\n"\
+            "              audioDataStart: 0x%08x\n",
+        ret,
+        ps3_audio_port_cfg.readIndex,
+        ps3_audio_port_cfg.status,
+        ps3_audio_port_cfg.channelCount,
+        ps3_audio_port_cfg.numBlocks,
+        ps3_audio_port_cfg.portSize,
+        ps3_audio_port_cfg.audioDataStart);
+
+    ret = audioPortStart (portNum);
+    printf ("I_InitSound: audioPortStart returns %d.\n", ret);
+
+    memset (&MutexAttrs, 0, sizeof(sys_lwmutex_attribute_t));
+    MutexAttrs.attr_protocol = 2;          // PRIORITY
+    MutexAttrs.attr_recursive = 0x20;      // NOT RECURSIVE
+    if (sys_lwmutex_create (&chanmutex, &MutexAttrs) != 0)
+        I_Error ("I_InitSound: sys_lwmutex_create failed.\n");
+
+    mixrunning = true;
+    ret = sys_ppu_thread_create(&mixthread, mix_thread_func, thread_arg, priority,
+           stack_size, THREAD_JOINABLE, mixthread_name);
+
+    printf ("I_InitSound: sys_ppu_thread_create returned %d.\n", ret);
+
+    return true;
+}
+
+
+//
+// PS3_ShutdownSound
+// The mixer thread is stopped and joined first, so nothing is
+// left inside I_UpdateSound or writing the port when it closes.
+//
+static void PS3_ShutdownSound (void)
+{
+    u64 retval;
+
+    if (!mixrunning)
+        return;
+
+    mixrunning = false;
+    sys_ppu_thread_join (mixthread, &retval);
+
+    audioPortStop (ps3_audio_port);
+    audioPortClose (ps3_audio_port);
+    audioQuit ();
+
+    sys_lwmutex_destroy (&chanmutex);
+}
+
+
+sndsink_t ps3_sndsink =
+{
+    "PS3 audio port",
+    PS3_InitSound,
+    PS3_ShutdownSound,
+    NULL,
+    PS3_LockSound,
+    PS3_UnlockSound
+};
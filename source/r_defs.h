@@ -95,7 +95,7 @@ typedef struct
 // The SECTORS record, at runtime.
 // Stores things/mobjs.
 //
-typedef	struct
+typedef	struct sector_s
 {
     fixed_t	floorheight;
     fixed_t	ceilingheight;
@@ -123,16 +123,49 @@ typedef	struct
     // list of mobjs in sector
     mobj_t*	thinglist;
 
+    // list of mobjs touching the sector, see P_SetThingPosition
+    struct msecnode_s*	touchlist;
+
     // thinker_t for reversable actions
     void*	specialdata;
 
     int			linecount;
     struct line_s**	lines;	// [linecount] size
+
+    // sectors across the two sided lines, each once
+    int			neighbourcount;
+    struct sector_s**	neighbours;	// [neighbourcount] size
+
+    // chains of sectors by tag, see P_InitTagLists
+    int		firsttag;
+    int		nexttag;
     
 } sector_t;
 
 
 
+//
+// A thing touching a sector. Each node is on two lists,
+// the sectors a thing touches and the things touching
+// a sector, so a moving floor or ceiling only has to
+// look at the things that can be in its way.
+//
+typedef struct msecnode_s
+{
+    sector_t*		sector;
+    mobj_t*		thing;
+
+    // in the thing's list
+    struct msecnode_s*	tnext;
+
+    // in the sector's list
+    struct msecnode_s*	sprev;
+    struct msecnode_s*	snext;
+    
+} msecnode_t;
+
+
+
 
 //
 // The SideDef.
@@ -33,6 +33,8 @@
 #include "d_net.h"
 
 #include "m_bbox.h"
+#include "m_bench.h"
+#include "m_prof.h"
 
 #include "r_local.h"
 #include "r_sky.h"
@@ -885,17 +887,29 @@ void R_RenderPlayerView (player_t* player)
     NetUpdate ();
 
     // The head node is the last node output.
+    M_BenchBeginPhase (bp_bsp);
+    PROF_BEGIN (pz_bsp);
     R_RenderBSPNode (numnodes-1);
+    PROF_END (pz_bsp);
+    M_BenchEndPhase (bp_bsp);
     
     // Check for new console commands.
     NetUpdate ();
     
+    M_BenchBeginPhase (bp_planes);
+    PROF_BEGIN (pz_planes);
     R_DrawPlanes ();
+    PROF_END (pz_planes);
+    M_BenchEndPhase (bp_planes);
     
     // Check for new console commands.
     NetUpdate ();
     
+    M_BenchBeginPhase (bp_masked);
+    PROF_BEGIN (pz_masked);
     R_DrawMasked ();
+    PROF_END (pz_masked);
+    M_BenchEndPhase (bp_masked);
 
     // Check for new console commands.
     NetUpdate ();				
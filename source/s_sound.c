@@ -288,7 +288,7 @@ S_StartSoundAtVolume
   else
   {
     pitch = NORM_PITCH;
-    priority = NORM_PRIORITY;
+    priority = sfx->priority;
   }
 
 
@@ -496,6 +496,9 @@ void S_UpdateSounds(void* listener_p)
 	    }
 	}
     }
+
+    I_UpdateMusic();
+
     // kill music if it is a single-play && finished
     // if (	mus_playing
     //      && !I_QrySongPlaying(mus_playing->handle)